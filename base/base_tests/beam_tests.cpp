@@ -73,6 +73,21 @@ UNIT_TEST(Beam_Smoke)
   Smoke<base::HeapBeam>();
 }
 
+UNIT_TEST(Beam_IsAcceptable)
+{
+  base::Beam<uint32_t, double> beam(2 /* capacity */);
+  TEST(beam.IsAcceptable(0.0), ());
+  beam.Add(0, 1.0);
+  beam.Add(1, 2.0);
+  TEST(!beam.IsAcceptable(0.5), ());
+  TEST(beam.IsAcceptable(1.0), ());
+  TEST(beam.IsAcceptable(1.5), ());
+
+  beam.Reset(0 /* capacity */);
+  TEST(beam.GetEntries().empty(), ());
+  TEST(!beam.IsAcceptable(10.0), ());
+}
+
 UNIT_TEST(Beam_Benchmark)
 {
   size_t const kCapacity = 100;
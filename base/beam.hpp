@@ -71,6 +71,27 @@ public:
   // The order of returned entries is not specified.
   std::vector<Entry> const & GetEntries() const { return m_entries; }
 
+  // Removes all entries but keeps the allocated memory.
+  void Clear() { m_entries.clear(); }
+
+  // Removes all entries and changes the capacity of the beam.
+  void Reset(size_t capacity)
+  {
+    m_entries.clear();
+    m_capacity = capacity;
+    m_entries.reserve(m_capacity);
+  }
+
+  size_t GetCapacity() const { return m_capacity; }
+
+  // Returns whether a pair with |value| would be added to the beam by Add().
+  bool IsAcceptable(Value const & value) const
+  {
+    if (m_entries.size() < m_capacity)
+      return true;
+    return m_capacity != 0 && !(m_entries.back().m_value > value);
+  }
+
 private:
   size_t m_capacity;
   std::vector<Entry> m_entries;
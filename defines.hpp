@@ -61,6 +61,10 @@
 #define INDEX_GENERATOR_DATA_VERSION_FILE_TAG "index_data_version"
 #define BORDERS_FILE_TAG "borders"
 
+#define GEOCODER_HEADER_FILE_TAG "geocoder_header"
+#define GEOCODER_HIERARCHY_FILE_TAG "geocoder_hierarchy"
+#define GEOCODER_INDEX_FILE_TAG "geocoder_index"
+
 #define READY_FILE_EXTENSION ".ready"
 #define RESUME_FILE_EXTENSION ".resume"
 #define DOWNLOADING_FILE_EXTENSION ".downloading"
@@ -771,6 +771,37 @@ string DebugPrint(FeatureBuilder const & fb)
   return out.str();
 }
 
+vector<uint64_t> SplitDatRawFormat(uint8_t const * data, uint64_t size, size_t featuresInChunk)
+{
+  CHECK_GREATER(featuresInChunk, 0, ());
+
+  vector<uint64_t> chunks;
+  uint64_t pos = 0;
+  for (size_t i = 0; pos < size; ++i)
+  {
+    if (i % featuresInChunk == 0)
+      chunks.emplace_back(pos);
+
+    // A varint of the size takes at most 5 bytes. Near the end of the file it is read from
+    // a zero-padded copy, so the bytes of a damaged file beyond its end are never touched.
+    size_t const kMaxSizeBytes = 5;
+    uint8_t tail[kMaxSizeBytes] = {};
+    auto const * begin = data + pos;
+    if (size - pos < kMaxSizeBytes)
+      begin = static_cast<uint8_t const *>(memcpy(tail, data + pos, size - pos));
+
+    ArrayByteSource src(begin);
+    auto const featureSize = ReadVarUint<uint32_t>(src);
+    auto const offset = pos + static_cast<uint64_t>(src.PtrUC() - begin);
+    CHECK_LESS_OR_EQUAL(offset, size, ("Damaged .dat file, position:", pos));
+    CHECK_LESS_OR_EQUAL(featureSize, size - offset, ("Damaged .dat file, position:", pos));
+    pos = offset + featureSize;
+  }
+  CHECK_EQUAL(pos, size, ("Damaged .dat file."));
+  chunks.emplace_back(size);
+  return chunks;
+}
+
 namespace serialization_policy
 {
 // static
@@ -4,17 +4,24 @@
 
 #include "coding/file_reader.hpp"
 #include "coding/file_writer.hpp"
+#include "coding/internal/file_data.hpp"
+#include "coding/mmap_reader.hpp"
 #include "coding/read_write_utils.hpp"
 
 #include "base/geo_object_id.hpp"
 #include "base/stl_helpers.hpp"
+#include "base/thread_pool_computational.hpp"
 #include "base/thread_pool_delayed.hpp"
 
+#include <atomic>
 #include <functional>
+#include <future>
 #include <list>
 #include <mutex>
+#include <queue>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
 namespace serial
@@ -336,40 +343,51 @@ void ForEachFromDatRawFormat(std::string const & filename, ToDo && toDo)
   }
 }
 
-/// Parallel process features in .dat file.
+// Number of features in a chunk of a .dat file which is processed by one thread.
+size_t const kFeaturesInChunkOfDatRawFormat = 256;
+
+// Returns the offsets of the chunks of |featuresInChunk| features in the .dat |data| of |size|
+// bytes. The last offset is |size|. Only the sizes of the features are read, so it is fast.
+std::vector<uint64_t> SplitDatRawFormat(uint8_t const * data, uint64_t size,
+                                        size_t featuresInChunk);
+
+// Process features of the chunk [|begin|, |end|) of the .dat |data|.
+template <class SerializationPolicy, class ToDo>
+void ForEachInChunkOfDatRawFormat(uint8_t const * data, uint64_t begin, uint64_t end, ToDo && toDo)
+{
+  MemReader reader(data + begin, static_cast<size_t>(end - begin));
+  ReaderSource<MemReader> src(reader);
+  while (src.Size() != 0)
+  {
+    FeatureBuilder fb;
+    uint64_t const pos = begin + src.Pos();
+    ReadFromSourceRawFormat<SerializationPolicy>(src, fb);
+    toDo(fb, pos);
+  }
+}
+
+/// Parallel process features in .dat file. The file is mapped to memory and split into chunks,
+/// which are deserialized by |threadsCount| threads. The order of the calls of |toDo| is not defined.
 template <class SerializationPolicy = serialization_policy::MinSize, class ToDo>
 void ForEachParallelFromDatRawFormat(size_t threadsCount, std::string const & filename,
                                      ToDo && toDo)
 {
   CHECK_GREATER_OR_EQUAL(threadsCount, 1, ());
   if (threadsCount == 1)
-    return ForEachFromDatRawFormat(filename, std::forward<ToDo>(toDo));
-
-  FileReader reader(filename);
-  ReaderSource<FileReader> src(reader);
-  //  TryReadAndCheckVersion<SerializationPolicy>(src);
-  auto const fileSize = reader.Size();
-  auto currPos = src.Pos();
-  std::mutex readMutex;
-  auto concurrentProcessor = [&] {
-    for (;;)
-    {
-      FeatureBuilder fb;
-      uint64_t featurePos;
-
-      {
-        std::lock_guard<std::mutex> lock(readMutex);
+    return ForEachFromDatRawFormat<SerializationPolicy>(filename, std::forward<ToDo>(toDo));
 
-        if (fileSize <= currPos)
-          break;
+  uint64_t fileSize = 0;
+  // Empty files can't be mapped.
+  if (base::GetFileSize(filename, fileSize) && fileSize == 0)
+    return;
 
-        ReadFromSourceRawFormat<SerializationPolicy>(src, fb);
-        featurePos = currPos;
-        currPos = src.Pos();
-      }
-
-      toDo(fb, featurePos);
-    }
+  MmapReader reader(filename);
+  auto const data = reader.Data();
+  auto const chunks = SplitDatRawFormat(data, reader.Size(), kFeaturesInChunkOfDatRawFormat);
+  std::atomic<size_t> nextChunk(0);
+  auto concurrentProcessor = [&] {
+    for (size_t i = nextChunk++; i + 1 < chunks.size(); i = nextChunk++)
+      ForEachInChunkOfDatRawFormat<SerializationPolicy>(data, chunks[i], chunks[i + 1], toDo);
   };
 
   std::vector<std::thread> workers;
@@ -378,6 +396,57 @@ void ForEachParallelFromDatRawFormat(size_t threadsCount, std::string const & fi
   for (auto & thread : workers)
     thread.join();
 }
+
+/// Parallel process features in .dat file. Features are deserialized by |threadsCount| threads,
+/// but |toDo| is called by the calling thread in the order of the file.
+template <class SerializationPolicy = serialization_policy::MinSize, class ToDo>
+void ForEachParallelOrderedFromDatRawFormat(size_t threadsCount, std::string const & filename,
+                                            ToDo && toDo)
+{
+  CHECK_GREATER_OR_EQUAL(threadsCount, 1, ());
+  if (threadsCount == 1)
+    return ForEachFromDatRawFormat<SerializationPolicy>(filename, std::forward<ToDo>(toDo));
+
+  uint64_t fileSize = 0;
+  // Empty files can't be mapped.
+  if (base::GetFileSize(filename, fileSize) && fileSize == 0)
+    return;
+
+  MmapReader reader(filename);
+  auto const data = reader.Data();
+  auto const chunks = SplitDatRawFormat(data, reader.Size(), kFeaturesInChunkOfDatRawFormat);
+
+  using Chunk = std::vector<std::pair<FeatureBuilder, uint64_t>>;
+  base::thread_pool::computational::ThreadPool threadPool(threadsCount);
+  std::queue<std::future<Chunk>> readChunks;
+  size_t nextChunk = 0;
+  while (true)
+  {
+    // Bounds the memory of the features which are read ahead.
+    while (nextChunk + 1 < chunks.size() && readChunks.size() < 2 * threadsCount)
+    {
+      readChunks.emplace(threadPool.Submit([data, begin = chunks[nextChunk],
+                                            end = chunks[nextChunk + 1]]() {
+        Chunk chunk;
+        ForEachInChunkOfDatRawFormat<SerializationPolicy>(
+            data, begin, end, [&](FeatureBuilder & fb, uint64_t pos) {
+              chunk.emplace_back(std::move(fb), pos);
+            });
+        return chunk;
+      }));
+      ++nextChunk;
+    }
+
+    if (readChunks.empty())
+      break;
+
+    auto chunk = readChunks.front().get();
+    readChunks.pop();
+    for (auto & p : chunk)
+      toDo(p.first, p.second);
+  }
+}
+
 template <class SerializationPolicy = serialization_policy::MinSize>
 std::vector<FeatureBuilder> ReadAllDatRawFormat(std::string const & fileName)
 {
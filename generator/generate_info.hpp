@@ -17,13 +17,15 @@ struct GenerateInfo
   {
     Memory,
     Index,
-    File
+    File,
+    Block
   };
 
   enum class OsmSourceType
   {
     XML,
-    O5M
+    O5M,
+    PBF
   };
 
   // Directory for .mwm.tmp files.
@@ -76,6 +78,8 @@ struct GenerateInfo
       m_osmFileType = OsmSourceType::XML;
     else if (type == "o5m")
       m_osmFileType = OsmSourceType::O5M;
+    else if (type == "pbf")
+      m_osmFileType = OsmSourceType::PBF;
     else
       LOG(LCRITICAL, ("Unknown source type:", type));
   }
@@ -88,6 +92,8 @@ struct GenerateInfo
       m_nodeStorageType = NodeStorageType::Index;
     else if (type == "mem")
       m_nodeStorageType = NodeStorageType::Memory;
+    else if (type == "block")
+      m_nodeStorageType = NodeStorageType::Block;
     else
       LOG(LCRITICAL, ("Incorrect node_storage type:", type));
   }
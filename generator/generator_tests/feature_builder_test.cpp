@@ -12,9 +12,15 @@
 #include "indexer/feature_visibility.hpp"
 #include "indexer/locality_object.hpp"
 
+#include "platform/platform_tests_support/scoped_file.hpp"
+
 #include "base/geo_object_id.hpp"
 
+#include <algorithm>
 #include <limits>
+#include <mutex>
+#include <utility>
+#include <vector>
 
 using namespace feature;
 
@@ -309,3 +315,52 @@ UNIT_TEST(FeatureBuilder_SerializeAccuratelyForIntermediate)
   Check(fb2);
   TEST(fb1.IsExactEq(fb2), ());
 }
+
+UNIT_TEST(FeatureBuilder_ForEachParallelFromDatRawFormat)
+{
+  classificator::Load();
+  platform::tests_support::ScopedFile sf("test_parallel.mwm.tmp",
+                                         platform::tests_support::ScopedFile::Mode::DoNotCreate);
+
+  // Several chunks with a partial one at the end.
+  uint64_t const kFeaturesCount = 3 * kFeaturesInChunkOfDatRawFormat + 17;
+  {
+    FeatureBuilderWriter<> writer(sf.GetFullPath());
+    for (uint64_t i = 0; i < kFeaturesCount; ++i)
+    {
+      FeatureBuilder fb;
+      FeatureParams params;
+      char const * arr[][1] = {{"building"}};
+      AddTypes(params, arr);
+      params.FinishAddingTypes();
+      fb.SetParams(params);
+      fb.SetCenter(m2::PointD(i, i));
+      fb.AddOsmId(base::MakeOsmNode(i));
+      writer.Write(fb);
+    }
+  }
+
+  std::vector<std::pair<base::GeoObjectId, uint64_t>> expected;
+  ForEachFromDatRawFormat(sf.GetFullPath(), [&](FeatureBuilder const & fb, uint64_t pos) {
+    expected.emplace_back(fb.GetMostGenericOsmId(), pos);
+  });
+  TEST_EQUAL(expected.size(), kFeaturesCount, ());
+
+  std::mutex mutex;
+  std::vector<std::pair<base::GeoObjectId, uint64_t>> parallel;
+  ForEachParallelFromDatRawFormat(3 /* threadsCount */, sf.GetFullPath(),
+                                  [&](FeatureBuilder const & fb, uint64_t pos) {
+                                    std::lock_guard<std::mutex> lock(mutex);
+                                    parallel.emplace_back(fb.GetMostGenericOsmId(), pos);
+                                  });
+  std::sort(parallel.begin(), parallel.end(),
+            [](auto const & l, auto const & r) { return l.second < r.second; });
+  TEST_EQUAL(parallel, expected, ());
+
+  std::vector<std::pair<base::GeoObjectId, uint64_t>> ordered;
+  ForEachParallelOrderedFromDatRawFormat(3 /* threadsCount */, sf.GetFullPath(),
+                                         [&](FeatureBuilder const & fb, uint64_t pos) {
+                                           ordered.emplace_back(fb.GetMostGenericOsmId(), pos);
+                                         });
+  TEST_EQUAL(ordered, expected, ());
+}
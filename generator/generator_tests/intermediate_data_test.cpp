@@ -11,18 +11,33 @@
 #include "generator/generate_info.hpp"
 #include "generator/intermediate_data.hpp"
 #include "generator/intermediate_elements.hpp"
+#include "generator/osm_source.hpp"
+
+#include "platform/platform.hpp"
+
+#include "platform/platform_tests_support/scoped_file.hpp"
 
 #include "coding/reader.hpp"
 #include "coding/writer.hpp"
 
+#include "base/file_name_utils.hpp"
+#include "base/thread_pool_computational.hpp"
+
 #include "defines.hpp"
 
+#include <algorithm>
 #include <cstdint>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <limits>
+#include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
 
 using namespace generator;
+using namespace platform::tests_support;
 using namespace std;
 
 UNIT_TEST(Intermediate_Data_empty_way_element_save_load_test)
@@ -115,3 +130,230 @@ UNIT_TEST(Intermediate_Data_relation_element_save_load_test)
   TEST_NOT_EQUAL(e2.tags["key1old"], "value1old", ());
   TEST_NOT_EQUAL(e2.tags["key2old"], "value2old", ());
 }
+
+UNIT_TEST(Intermediate_Data_block_point_storage_test)
+{
+  string const kName = "test_block_nodes";
+  ScopedFile sf(kName + ".blocks", ScopedFile::Mode::DoNotCreate);
+  auto const name = sf.GetFullPath().substr(0, sf.GetFullPath().size() - string(".blocks").size());
+
+  vector<pair<uint64_t, pair<double, double>>> points;
+  for (uint64_t i = 0; i < 1000; ++i)
+  {
+    // Sparse ids with gaps of different sizes.
+    uint64_t const id = 1 + i * i * 7 + (i % 3);
+    points.emplace_back(id, make_pair(-89.0 + i * 0.17, -179.0 + i * 0.35));
+  }
+
+  {
+    auto writer = cache::CreatePointStorageWriter(
+        feature::GenerateInfo::NodeStorageType::Block, name);
+    for (auto const & p : points)
+      writer->AddPoint(p.first, p.second.first, p.second.second);
+    TEST_EQUAL(writer->GetNumProcessedPoints(), points.size(), ());
+  }
+
+  auto reader = cache::CreatePointStorageReader(
+      feature::GenerateInfo::NodeStorageType::Block, name);
+  double lat = 0.0;
+  double lon = 0.0;
+  for (auto const & p : points)
+  {
+    TEST(reader->GetPoint(p.first, lat, lon), (p.first));
+    TEST_NEAR(lat, p.second.first, 1e-7, (p.first));
+    TEST_NEAR(lon, p.second.second, 1e-7, (p.first));
+  }
+
+  TEST(!reader->GetPoint(0, lat, lon), ());
+  TEST(!reader->GetPoint(points[500].first + 1, lat, lon), ());
+  TEST(!reader->GetPoint(points.back().first + 1, lat, lon), ());
+}
+
+UNIT_TEST(Intermediate_Data_index_file_test)
+{
+  ScopedFile sf("test_index_file", ScopedFile::Mode::DoNotCreate);
+
+  // Keys are added out of order, with skewed gaps and with several values for some keys.
+  vector<pair<cache::Key, uint64_t>> elements;
+  for (uint64_t i = 0; i < 5000; ++i)
+  {
+    cache::Key const key = (i * 7919) % 5000 * (i % 10 == 0 ? 1000 : 3) + 1;
+    elements.emplace_back(key, i);
+    if (i % 7 == 0)
+      elements.emplace_back(key, i + 100000);
+  }
+
+  {
+    cache::IndexFileWriter writer(sf.GetFullPath());
+    for (auto const & e : elements)
+      writer.Add(e.first, e.second);
+    writer.WriteAll();
+  }
+
+  cache::IndexFileReader reader(sf.GetFullPath());
+  sort(elements.begin(), elements.end());
+  for (auto const & e : elements)
+  {
+    uint64_t value = 0;
+    TEST(reader.GetValueByKey(e.first, value), (e.first));
+    auto const range = equal_range(elements.begin(), elements.end(), e,
+                                   [](auto const & l, auto const & r) { return l.first < r.first; });
+    TEST_EQUAL(value, range.first->second, (e.first));
+
+    vector<uint64_t> values;
+    reader.ForEachByKey(e.first, [&](uint64_t v) {
+      values.push_back(v);
+      return base::ControlFlow::Continue;
+    });
+    TEST_EQUAL(values.size(), distance(range.first, range.second), (e.first));
+    for (size_t i = 0; i < values.size(); ++i)
+      TEST_EQUAL(values[i], (range.first + i)->second, (e.first));
+  }
+
+  uint64_t value = 0;
+  TEST(!reader.GetValueByKey(0, value), ());
+  TEST(!reader.GetValueByKey(2, value), ());
+  TEST(!reader.GetValueByKey(elements.back().first + 1, value), ());
+}
+
+UNIT_TEST(Intermediate_Data_index_file_outlier_key_test)
+{
+  ScopedFile sf("test_index_file_outlier", ScopedFile::Mode::DoNotCreate);
+
+  // The outlier key makes the interpolation guess close to the beginning of the range every time.
+  uint64_t const kCount = 20000;
+  cache::Key const kOutlier = numeric_limits<cache::Key>::max() / 2;
+  {
+    cache::IndexFileWriter writer(sf.GetFullPath());
+    for (uint64_t i = 1; i <= kCount; ++i)
+      writer.Add(2 * i, i);
+    writer.Add(kOutlier, 0);
+    writer.WriteAll();
+  }
+
+  cache::IndexFileReader reader(sf.GetFullPath());
+  uint64_t value = 0;
+  for (uint64_t i = 1; i <= kCount; ++i)
+  {
+    TEST(reader.GetValueByKey(2 * i, value), (i));
+    TEST_EQUAL(value, i, ());
+    TEST(!reader.GetValueByKey(2 * i + 1, value), (i));
+  }
+
+  TEST(reader.GetValueByKey(kOutlier, value), ());
+  TEST_EQUAL(value, 0, ());
+  TEST(!reader.GetValueByKey(kOutlier - 1, value), ());
+  TEST(!reader.GetValueByKey(kOutlier + 1, value), ());
+}
+
+UNIT_TEST(Intermediate_Data_element_cache_shared_reader_test)
+{
+  ScopedFile sf("test_ways_cache", ScopedFile::Mode::DoNotCreate);
+  ScopedFile sfOffsets("test_ways_cache" OFFSET_EXT, ScopedFile::Mode::DoNotCreate);
+
+  uint64_t const kWaysCount = 1000;
+  {
+    cache::OSMElementCacheWriter writer(sf.GetFullPath());
+    for (uint64_t id = 1; id <= kWaysCount; ++id)
+    {
+      WayElement way(id);
+      way.nodes.assign(id % 10 + 1, id);
+      writer.Write(id, way);
+    }
+    writer.SaveOffsets();
+  }
+
+  cache::OSMElementCacheReader const reader(sf.GetFullPath(), false /* preload */,
+                                            true /* forceReload */);
+  base::thread_pool::computational::ThreadPool threadPool(4);
+  vector<future<bool>> results;
+  for (uint64_t thread = 0; thread < 4; ++thread)
+  {
+    results.emplace_back(threadPool.Submit([&reader, thread]() {
+      for (uint64_t id = thread + 1; id <= kWaysCount; id += 2)
+      {
+        WayElement way(id);
+        if (!reader.Read(id, way) || way.nodes != vector<uint64_t>(id % 10 + 1, id))
+          return false;
+      }
+      return true;
+    }));
+  }
+  for (auto & result : results)
+    TEST(result.get(), ());
+
+  WayElement way(kWaysCount + 1);
+  TEST(!reader.Read(kWaysCount + 1, way), ());
+}
+
+UNIT_TEST(Intermediate_Data_parallel_generation_test)
+{
+  size_t const kWaysCount = 5000;
+  size_t const kRelationsCount = 3000;
+
+  ostringstream xml;
+  xml << "<?xml version='1.0' encoding='UTF-8'?>\n<osm version='0.6'>\n";
+  for (size_t i = 1; i <= kWaysCount + 1; ++i)
+    xml << "<node id='" << i << "' lat='55." << i << "' lon='37." << i << "' />\n";
+  for (size_t i = 1; i <= kWaysCount; ++i)
+    xml << "<way id='" << i << "'><nd ref='" << i << "' /><nd ref='" << i + 1 << "' /></way>\n";
+  for (size_t i = 1; i <= kRelationsCount; ++i)
+  {
+    xml << "<relation id='" << i << "'><member type='way' ref='" << i << "' role='outer' />"
+        << "<member type='node' ref='" << i << "' role='' />"
+        << "<tag k='type' v='multipolygon' /><tag k='name' v='" << i << "' /></relation>\n";
+  }
+  xml << "</osm>\n";
+
+  auto const root = base::JoinPath(GetPlatform().WritableDir(), "intermediate_data_parallel");
+  auto const osmFile = base::JoinPath(root, "source.osm");
+  TEST(Platform::MkDirChecked(root), ());
+  {
+    ofstream out(osmFile);
+    out << xml.str();
+  }
+
+  auto const generate = [&](size_t threadsCount) {
+    feature::GenerateInfo info;
+    info.m_intermediateDir = base::JoinPath(root, to_string(threadsCount));
+    TEST(Platform::MkDirChecked(info.m_intermediateDir), ());
+    info.m_osmFileName = osmFile;
+    info.SetOsmFileType("xml");
+    info.SetNodeStorageType("map");
+    TEST(GenerateIntermediateData(info, threadsCount), ());
+    return info;
+  };
+
+  auto const sequentialInfo = generate(1);
+  // Two writers of ways and relations, so the shards are merged.
+  auto const parallelInfo = generate(5);
+  cache::IntermediateData sequential(sequentialInfo, true /* forceReload */);
+  cache::IntermediateData parallel(parallelInfo, true /* forceReload */);
+
+  for (uint64_t id = 1; id <= kWaysCount; ++id)
+  {
+    WayElement expected(id);
+    WayElement actual(id);
+    TEST(sequential.GetCache()->GetWay(id, expected), (id));
+    TEST(parallel.GetCache()->GetWay(id, actual), (id));
+    TEST_EQUAL(actual.nodes, expected.nodes, (id));
+  }
+
+  auto const collectRelations = [](cache::IntermediateDataReader & reader, uint64_t wayId) {
+    vector<pair<uint64_t, string>> relations;
+    auto const collect = [&](uint64_t id, RelationElement const & relation) {
+      relations.emplace_back(id, relation.GetTagValue("name"));
+      return base::ControlFlow::Continue;
+    };
+    reader.ForEachRelationByWay(wayId, collect);
+    return relations;
+  };
+  for (uint64_t id = 1; id <= kWaysCount; ++id)
+  {
+    auto const relations = collectRelations(*parallel.GetCache(), id);
+    TEST_EQUAL(relations, collectRelations(*sequential.GetCache(), id), (id));
+    TEST_EQUAL(relations.size(), id <= kRelationsCount ? 1 : 0, (id));
+  }
+
+  TEST(Platform::RmDirRecursively(root), ());
+}
@@ -0,0 +1,123 @@
+#include "testing/testing.hpp"
+
+#include "generator/key_value_concurrent_writer.hpp"
+#include "generator/key_value_storage.hpp"
+
+#include "platform/platform_tests_support/scoped_file.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace generator;
+using platform::tests_support::ScopedFile;
+
+namespace
+{
+int GetRankFromJson(JsonValue const & json)
+{
+  auto && properties = base::GetJSONObligatoryField(json, "properties");
+  return FromJSONObject<int>(properties, "rank");
+}
+}  // namespace
+
+UNIT_TEST(BinaryKeyValueStorage_Build)
+{
+  std::string const kv =
+      "0000000000000003 {\"properties\":{\"rank\":4,\"dref\":\"0000000000000001\"}}\n"
+      "0000000000000001 {\"properties\":{\"rank\":2,\"dref\":null}}\n"
+      "broken line\n"
+      "0000000000000002 {\"properties\":{}}\n"
+      "0000000000000003 {\"properties\":{\"rank\":8}}\n"
+      "0000000000000005 {\"properties\":{\"rank\":1,\"dref\":\"not hex\"}}\n";
+  ScopedFile const kvFile("test_kv.jsonl", kv);
+  ScopedFile const binFile("test_kv.jsonl" + std::string(BinaryKeyValueStorage::kExtension),
+                           ScopedFile::Mode::DoNotCreate);
+
+  TEST(!BinaryKeyValueStorage::IsBuiltFrom(kvFile.GetFullPath(), binFile.GetFullPath()), ());
+  BinaryKeyValueStorage::Build(kvFile.GetFullPath(), binFile.GetFullPath());
+  TEST(BinaryKeyValueStorage::IsBuiltFrom(kvFile.GetFullPath(), binFile.GetFullPath()), ());
+  BinaryKeyValueStorage const storage(binFile.GetFullPath());
+
+  // Lines with malformed dref are skipped.
+  TEST_EQUAL(storage.Size(), 3, ());
+  TEST(!storage.Contains(5), ());
+  TEST(!storage.Contains(0), ());
+  TEST(!storage.Contains(4), ());
+  TEST(!storage.Find(4), ());
+
+  TEST_EQUAL(storage.GetRank(1).value_or(0), 2, ());
+  TEST(!storage.GetDref(1), ());
+
+  TEST(storage.Contains(2), ());
+  TEST(!storage.GetRank(2), ());
+  TEST(!storage.GetDref(2), ());
+
+  // The first value of a duplicated key is kept.
+  TEST_EQUAL(storage.GetRank(3).value_or(0), 4, ());
+  TEST_EQUAL(storage.GetDref(3).value_or(0), 1, ());
+  auto const value = storage.Find(3);
+  TEST(value, ());
+  TEST_EQUAL(GetRankFromJson(*value), 4, ());
+  // Parsed values are cached.
+  TEST(storage.Find(3) == value, ());
+
+  // The storage is outdated when the source is rewritten with the same size right after the build.
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  {
+    std::ofstream out(kvFile.GetFullPath());
+    out << kv;
+  }
+  TEST(!BinaryKeyValueStorage::IsBuiltFrom(kvFile.GetFullPath(), binFile.GetFullPath()), ());
+  BinaryKeyValueStorage::Build(kvFile.GetFullPath(), binFile.GetFullPath());
+  TEST(BinaryKeyValueStorage::IsBuiltFrom(kvFile.GetFullPath(), binFile.GetFullPath()), ());
+
+  // The storage is outdated when the source is changed.
+  {
+    std::ofstream out(kvFile.GetFullPath(), std::ios::app);
+    out << "0000000000000004 {\"properties\":{}}\n";
+  }
+  TEST(!BinaryKeyValueStorage::IsBuiltFrom(kvFile.GetFullPath(), binFile.GetFullPath()), ());
+}
+
+UNIT_TEST(KeyValueConcurrentWriter_Write)
+{
+  size_t const kThreadsCount = 4;
+  uint64_t const kValuesPerThread = 1000;
+
+  std::string const kv = "0000000000000000 {\"properties\":{\"rank\":0}}\n";
+  ScopedFile const kvFile("test_kv_writer.jsonl", kv);
+  ScopedFile const binFile("test_kv_writer.jsonl" + std::string(BinaryKeyValueStorage::kExtension),
+                           ScopedFile::Mode::DoNotCreate);
+  {
+    // Small buffers make threads flush their segments many times.
+    KeyValueConcurrentWriter writer{kvFile.GetFullPath(), FileWriter::OP_APPEND, 256};
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < kThreadsCount; ++i)
+    {
+      threads.emplace_back([&writer, i]() {
+        for (uint64_t j = 0; j < kValuesPerThread; ++j)
+        {
+          auto const key = 1 + i * kValuesPerThread + j;
+          auto properties = base::NewJSONObject();
+          ToJSONObject(*properties, "rank", static_cast<int>(key % 30));
+          auto value = base::NewJSONObject();
+          ToJSONObject(*value, "properties", std::move(properties));
+          writer.Write(key, JsonValue{std::move(value)});
+        }
+      });
+    }
+    for (auto & thread : threads)
+      thread.join();
+    writer.Finish();
+  }
+
+  BinaryKeyValueStorage::Build(kvFile.GetFullPath(), binFile.GetFullPath());
+  BinaryKeyValueStorage const storage(binFile.GetFullPath());
+  TEST_EQUAL(storage.Size(), kThreadsCount * kValuesPerThread + 1, ());
+  for (uint64_t key = 0; key <= kThreadsCount * kValuesPerThread; ++key)
+    TEST_EQUAL(storage.GetRank(key).value_or(-1), static_cast<int>(key % 30), (key));
+}
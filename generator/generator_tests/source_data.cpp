@@ -138,3 +138,34 @@ unsigned char const relation_o5m_data[] = /* 224 */
   0x61, 0x63, 0x65, 0x00, 0x74, 0x6F, 0x77, 0x6E, 0x00, 0x00, 0x74, 0x79, 0x70, 0x65, 0x00,
   0x6D, 0x75, 0x6C, 0x74, 0x69, 0x70, 0x6F, 0x6C, 0x79, 0x67, 0x6F, 0x6E, 0x00, 0xFE};
 static_assert(sizeof(relation_o5m_data) == 224, "Size check failed");
+
+// binary data: relation.osm.pbf, the header blob and the second data blob are not compressed
+unsigned char const relation_pbf_data[] = /* 392 */
+{0x00, 0x00, 0x00, 0x0D, 0x0A, 0x09, 0x4F, 0x53, 0x4D, 0x48, 0x65, 0x61, 0x64, 0x65, 0x72,
+  0x18, 0x2C, 0x0A, 0x28, 0x22, 0x0E, 0x4F, 0x73, 0x6D, 0x53, 0x63, 0x68, 0x65, 0x6D, 0x61,
+  0x2D, 0x56, 0x30, 0x2E, 0x36, 0x22, 0x0A, 0x44, 0x65, 0x6E, 0x73, 0x65, 0x4E, 0x6F, 0x64,
+  0x65, 0x73, 0x82, 0x01, 0x09, 0x68, 0x61, 0x6E, 0x64, 0x2D, 0x6D, 0x61, 0x64, 0x65, 0x10,
+  0x28, 0x00, 0x00, 0x00, 0x0C, 0x0A, 0x07, 0x4F, 0x53, 0x4D, 0x44, 0x61, 0x74, 0x61, 0x18,
+  0xA1, 0x01, 0x10, 0x9A, 0x01, 0x1A, 0x9B, 0x01, 0x78, 0x9C, 0xE3, 0xB2, 0xE1, 0x62, 0xE0,
+  0x62, 0xC9, 0x4B, 0xCC, 0x4D, 0xE5, 0xE2, 0x0A, 0xCF, 0xC8, 0x2C, 0x49, 0xCD, 0xC8, 0x2F,
+  0x2A, 0x4E, 0xE5, 0x62, 0x2D, 0xC8, 0x49, 0x4C, 0x4E, 0xE5, 0x62, 0x29, 0xC9, 0x2F, 0xCF,
+  0xE3, 0x62, 0xCD, 0x2F, 0x2D, 0x49, 0x2D, 0x02, 0x72, 0x2A, 0x0B, 0x52, 0xB9, 0x78, 0x72,
+  0x4B, 0x73, 0x4A, 0x32, 0x0B, 0xF2, 0x73, 0x2A, 0xD3, 0xF3, 0xF3, 0x84, 0xA2, 0x84, 0x22,
+  0xB8, 0xB8, 0xAF, 0xAF, 0x51, 0xD4, 0x61, 0x01, 0x03, 0x26, 0x27, 0xE9, 0x65, 0xE7, 0x3A,
+  0x0E, 0xB3, 0xDC, 0xCC, 0xF8, 0xFE, 0x4D, 0xF4, 0xF7, 0x19, 0xC1, 0x7F, 0xB3, 0x98, 0x0E,
+  0x2D, 0xE7, 0xBF, 0x70, 0x58, 0xF2, 0xC1, 0x5D, 0xB1, 0xB9, 0x9E, 0x5E, 0xB2, 0xEB, 0xCF,
+  0xFF, 0x69, 0xE7, 0x9A, 0x33, 0x41, 0xE5, 0xCE, 0x59, 0xB9, 0xFE, 0xCB, 0x5A, 0xCF, 0xA7,
+  0x26, 0x4C, 0xBF, 0x27, 0xBC, 0x65, 0x9E, 0xC8, 0x8A, 0x7E, 0xA5, 0x65, 0xDF, 0x24, 0x83,
+  0x78, 0x19, 0x99, 0x98, 0x59, 0x18, 0x60, 0x00, 0x00, 0xCE, 0x38, 0x36, 0x54, 0x00, 0x00,
+  0x00, 0x0C, 0x0A, 0x07, 0x4F, 0x53, 0x4D, 0x44, 0x61, 0x74, 0x61, 0x18, 0x8A, 0x01, 0x0A,
+  0x84, 0x01, 0x0A, 0x3C, 0x0A, 0x00, 0x0A, 0x04, 0x6E, 0x61, 0x6D, 0x65, 0x0A, 0x0A, 0x57,
+  0x68, 0x69, 0x74, 0x65, 0x68, 0x6F, 0x72, 0x73, 0x65, 0x0A, 0x05, 0x70, 0x6C, 0x61, 0x63,
+  0x65, 0x0A, 0x04, 0x74, 0x6F, 0x77, 0x6E, 0x0A, 0x05, 0x6F, 0x75, 0x74, 0x65, 0x72, 0x0A,
+  0x04, 0x74, 0x79, 0x70, 0x65, 0x0A, 0x0C, 0x6D, 0x75, 0x6C, 0x74, 0x69, 0x70, 0x6F, 0x6C,
+  0x79, 0x67, 0x6F, 0x6E, 0x12, 0x1A, 0x1A, 0x18, 0x08, 0xF5, 0xA9, 0xEF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0x01, 0x42, 0x0B, 0x91, 0xAC, 0x21, 0x01, 0x03, 0x03, 0x03, 0x03, 0x03,
+  0x03, 0x1A, 0x12, 0x25, 0x22, 0x23, 0x08, 0xE7, 0xA9, 0xEF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0x01, 0x12, 0x03, 0x01, 0x03, 0x06, 0x1A, 0x03, 0x02, 0x04, 0x07, 0x42, 0x02, 0x05,
+  0x00, 0x4A, 0x04, 0x95, 0xAC, 0x21, 0x41, 0x52, 0x02, 0x01, 0x00, 0x88, 0x01, 0x64, 0x10,
+  0x84, 0x01};
+static_assert(sizeof(relation_pbf_data) == 392, "Size check failed");
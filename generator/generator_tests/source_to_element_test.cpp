@@ -73,3 +73,88 @@ UNIT_TEST(Source_To_Element_check_equivalence)
     TEST_EQUAL(elementsXML[i], elementsO5M[i], ());
   }
 }
+
+UNIT_TEST(Source_To_Element_check_pbf_equivalence)
+{
+  std::istringstream ss1(relation_xml_data);
+  SourceReader readerXML(ss1);
+
+  std::vector<OsmElement> elementsXML;
+  ProcessOsmElementsFromXML(readerXML, [&elementsXML](OsmElement * e)
+  {
+    elementsXML.push_back(*e);
+  });
+
+  for (size_t threadsCount : {1, 3})
+  {
+    std::string src(std::begin(relation_pbf_data), std::end(relation_pbf_data));
+    std::istringstream ss2(src);
+    SourceReader readerPbf(ss2);
+
+    std::vector<OsmElement> elementsPbf;
+    ProcessOsmElementsFromPbf(readerPbf, [&elementsPbf](OsmElement * e)
+    {
+      elementsPbf.push_back(*e);
+    }, threadsCount);
+
+    TEST_EQUAL(elementsXML, elementsPbf, (threadsCount));
+  }
+}
+
+namespace
+{
+std::vector<OsmElement> ReadAllElements(std::string const & src,
+                                        feature::GenerateInfo::OsmSourceType type,
+                                        size_t threadsCount, size_t chunkSize)
+{
+  std::istringstream ss(src);
+  SourceReader reader(ss);
+  auto processor = CreateProcessorOsmElements(reader, type, threadsCount, chunkSize);
+
+  std::vector<OsmElement> elements;
+  OsmElement element;
+  while (processor->TryRead(element))
+    elements.push_back(element);
+  return elements;
+}
+}  // namespace
+
+UNIT_TEST(Source_To_Element_check_chunks_equivalence)
+{
+  using Type = feature::GenerateInfo::OsmSourceType;
+
+  std::string const xml(relation_xml_data);
+  std::string const o5m(std::begin(relation_o5m_data), std::end(relation_o5m_data));
+  auto const expected = ReadAllElements(xml, Type::XML, 1 /* threadsCount */, 1 /* chunkSize */);
+  TEST_EQUAL(expected.size(), 11, ());
+
+  // Chunks of one byte are split at every possible point.
+  for (size_t chunkSize : {1, 100, 1 << 20})
+  {
+    TEST_EQUAL(ReadAllElements(xml, Type::XML, 3 /* threadsCount */, chunkSize), expected,
+               (chunkSize));
+    TEST_EQUAL(ReadAllElements(o5m, Type::O5M, 3 /* threadsCount */, chunkSize), expected,
+               (chunkSize));
+  }
+}
+
+UNIT_TEST(Source_To_Element_check_o5m_single_section_chunks)
+{
+  using Type = feature::GenerateInfo::OsmSourceType;
+
+  // Nodes of the file without Reset datasets between them, as osmconvert writes the node section.
+  std::string const data(std::begin(relation_o5m_data), std::end(relation_o5m_data));
+  auto const waysStart = data.find("\xff\x11");
+  TEST_NOT_EQUAL(waysStart, std::string::npos, ());
+  auto const o5m = data.substr(0, waysStart) + '\xfe';
+
+  auto const expected = ReadAllElements(o5m, Type::O5M, 1 /* threadsCount */, 1 /* chunkSize */);
+  TEST_EQUAL(expected.size(), 9, ());
+
+  // Small chunk sizes make the section longer than the maximal chunk, so it is streamed.
+  for (size_t chunkSize : {1, 8, 100, 1 << 20})
+  {
+    TEST_EQUAL(ReadAllElements(o5m, Type::O5M, 3 /* threadsCount */, chunkSize), expected,
+               (chunkSize));
+  }
+}
@@ -62,3 +62,27 @@ UNIT_TEST(StreetRegionTracingTest_StreetWithTransitRegion)
   TEST_EQUAL(segments[1].m_region.first, 2, ());
   TEST_EQUAL(segments[2].m_region.first, 1, ());
 }
+
+UNIT_TEST(StreetRegionTracingTest_SameRegionChecker)
+{
+  size_t regionGetterCalls = 0;
+  auto regionGetter = [&regionGetterCalls] (auto && point) {
+    ++regionGetterCalls;
+    if (0.5 <= point.x && point.x <= 0.501)
+      return KeyValue{2, {}};
+    return KeyValue{1, {}};
+  };
+  auto sameRegionChecker = [] (auto && segmentBegin, auto && segmentEnd) {
+    return segmentEnd.x < 0.49 || 0.51 < segmentBegin.x;
+  };
+  auto && tracing =
+      StreetRegionsTracing{{{0.0, 0.0}, {1.0, 0.0}}, regionGetter, sameRegionChecker};
+  auto && segments = tracing.StealPathSegments();
+
+  TEST_EQUAL(segments.size(), 3, ());
+  TEST_EQUAL(segments[0].m_region.first, 1, ());
+  TEST_EQUAL(segments[1].m_region.first, 2, ());
+  TEST_EQUAL(segments[2].m_region.first, 1, ());
+  // Regions are looked up near the transit region only.
+  TEST_LESS(regionGetterCalls, 100, ());
+}
@@ -103,7 +103,7 @@ CliCommandOptions DefineOptions(int argc, char * argv[])
          "Input osm area file.")
      ("osm_file_type",
          po::value(&o.m_osm_file_type)->default_value("xml"),
-         "Input osm area file type [xml, o5m].")
+         "Input osm area file type [xml, o5m, pbf].")
      ("data_path",
          po::value(&o.m_data_path)->default_value(""),
          GetDataPathHelp())
@@ -118,7 +118,8 @@ CliCommandOptions DefineOptions(int argc, char * argv[])
          "File name for process (without 'mwm' ext).")
      ("node_storage",
          po::value(&o.m_node_storage)->default_value("map"),
-         "Type of storage for intermediate points representation. Available: raw, map, mem.")
+         "Type of storage for intermediate points representation. Available: raw, map, mem, block. "
+         "The block storage requires nodes sorted by ids.")
      ("preprocess",
          po::value(&o.m_preprocess)->default_value(false),
          "1st pass - create nodes/ways/relations data.")
@@ -256,7 +257,7 @@ int GeneratorToolMain(int argc, char ** argv)
     DataVersion{options.m_osm_file_name}.DumpToPath(genInfo.m_intermediateDir);
 
     LOG(LINFO, ("Generating intermediate data ...."));
-    if (!GenerateIntermediateData(genInfo))
+    if (!GenerateIntermediateData(genInfo, threadsCount))
       return EXIT_FAILURE;
   }
 
@@ -78,6 +78,7 @@ bool GeoObjectsGenerator::GenerateGeoObjectsPrivate()
   LOG(LINFO, ("Addressless buildings with geometry we used for inner points were filtered"));
 
   LOG(LINFO, ("Geo objects without addresses were built."));
+  m_geoObjectMaintainer.FlushStorage();
   LOG(LINFO, ("Geo objects key-value storage saved to", m_pathOutGeoObjectsKv));
   LOG(LINFO, ("Ids of POIs without addresses saved to", m_pathOutPoiIdsToAddToLocalityIndex));
   return true;
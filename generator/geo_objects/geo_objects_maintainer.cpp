@@ -13,23 +13,12 @@ namespace geo_objects
 GeoObjectMaintainer::GeoObjectMaintainer(std::string const & pathOutGeoObjectsKv,
                                          RegionInfoGetter && regionInfoGetter,
                                          RegionIdGetter && regionIdGetter)
-  : m_geoObjectsKvStorage{InitGeoObjectsKv(pathOutGeoObjectsKv)}
+  : m_geoObjectsKvWriter{pathOutGeoObjectsKv}
   , m_regionInfoGetter{std::move(regionInfoGetter)}
   , m_regionIdGetter(std::move(regionIdGetter))
 {
 }
 
-// static
-std::fstream GeoObjectMaintainer::InitGeoObjectsKv(std::string const & pathOutGeoObjectsKv)
-{
-  std::fstream result{pathOutGeoObjectsKv,
-                      std::ios_base::in | std::ios_base::out | std::ios_base::app};
-  if (!result)
-    MYTHROW(Reader::OpenException, ("Failed to open file", pathOutGeoObjectsKv));
-
-  return result;
-}
-
 void UpdateCoordinates(m2::PointD const & point, base::JSONPtr & json)
 {
   auto geometry = json_object_get(json.get(), "geometry");
@@ -98,8 +87,7 @@ void GeoObjectMaintainer::StoreAndEnrich(feature::FeatureBuilder & fb)
 
 void GeoObjectMaintainer::WriteToStorage(base::GeoObjectId id, JsonValue && value)
 {
-  std::lock_guard<std::mutex> lock(m_storageMutex);
-  m_geoObjectsKvStorage << KeyValueStorage::SerializeFullLine(id.GetEncodedId(), std::move(value));
+  m_geoObjectsKvWriter.Write(id.GetEncodedId(), std::move(value));
 }
 
 // GeoObjectMaintainer::GeoObjectsView
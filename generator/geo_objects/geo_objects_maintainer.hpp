@@ -1,5 +1,6 @@
 #pragma once
 
+#include "generator/key_value_concurrent_writer.hpp"
 #include "generator/key_value_storage.hpp"
 
 #include "generator/regions/region_info_getter.hpp"
@@ -90,6 +91,8 @@ public:
 
   void StoreAndEnrich(feature::FeatureBuilder & fb);
   void WriteToStorage(base::GeoObjectId id, JsonValue && value);
+  // Appends everything written to the storage to the key-value file.
+  void FlushStorage() { m_geoObjectsKvWriter.Finish(); }
 
   size_t Size() const { return m_geoId2GeoData.size(); }
 
@@ -99,11 +102,8 @@ public:
   }
 
 private:
-  static std::fstream InitGeoObjectsKv(std::string const & pathOutGeoObjectsKv);
-
-  std::fstream m_geoObjectsKvStorage;
+  KeyValueConcurrentWriter m_geoObjectsKvWriter;
   std::mutex m_updateMutex;
-  std::mutex m_storageMutex;
 
   GeoIndex m_index;
   RegionInfoGetter m_regionInfoGetter;
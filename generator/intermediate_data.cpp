@@ -1,8 +1,18 @@
 #include "generator/intermediate_data.hpp"
 
+#include <cstring>
+#include <limits>
 #include <new>
+#include <queue>
 #include <set>
 #include <string>
+#include <utility>
+
+#include "coding/byte_stream.hpp"
+#include "coding/file_sort.hpp"
+#include "coding/internal/file_data.hpp"
+#include "coding/varint.hpp"
+#include "coding/write_to_sink.hpp"
 
 #include "base/assert.hpp"
 #include "base/checked_cast.hpp"
@@ -19,8 +29,18 @@ namespace cache
 namespace
 {
 size_t const kFlushCount = 1024;
+// Size of the memory buffer to sort index files.
+uint64_t const kIndexSortBufferBytes = 64 * 1024 * 1024;
+// Step to touch the pages of mapped files.
+uint64_t const kPageSize = 4096;
+// Search in index files switches to binary search on ranges of this size.
+size_t const kMinInterpolationRange = 64;
 double const kValueOrder = 1e7;
 string const kShortExtension = ".short";
+string const kBlocksExtension = ".blocks";
+
+// Number of nodes in a block of the block storage.
+size_t const kNodesInBlock = 64;
 
 // An estimation.
 // OSM had around 4.1 billion nodes on 2017-11-08,
@@ -67,8 +87,8 @@ public:
   // PointStorageWriterInterface overrides:
   uint64_t GetNumProcessedPoints() const override { return m_numProcessedPoints; }
 
-private:
-  uint64_t m_numProcessedPoints;
+protected:
+  uint64_t m_numProcessedPoints = 0;
 };
 
 // RawFilePointStorageMmapReader -------------------------------------------------------------------
@@ -117,7 +137,6 @@ public:
 
 private:
   FileWriter m_fileWriter;
-  uint64_t m_numProcessedPoints = 0;
 };
 
 // RawMemPointStorageReader ------------------------------------------------------------------------
@@ -177,7 +196,6 @@ public:
 private:
   FileWriter m_fileWriter;
   vector<LatLon> m_data;
-  uint64_t m_numProcessedPoints = 0;
 };
 
 // MapFilePointStorageReader -----------------------------------------------------------------------
@@ -254,9 +272,300 @@ public:
 
 private:
   FileWriter m_fileWriter;
-  uint64_t m_numProcessedPoints = 0;
 };
 
+// The block storage keeps nodes sorted by ids in blocks of |kNodesInBlock| nodes.
+// The first node of a block stores its coordinates as varints, the next ones store
+// the deltas of ids (minus one) and coordinates from the previous node.
+// The file layout is:
+//   blocks, padding to 8 bytes, directory of |BlockInfo|s, number of blocks (uint64_t).
+// The last |BlockInfo| of the directory only marks the end of the blocks.
+struct BlockInfo
+{
+  uint64_t m_firstId = 0;
+  uint64_t m_offset = 0;
+};
+static_assert(sizeof(BlockInfo) == 16, "Invalid structure size");
+static_assert(std::is_trivially_copyable<BlockInfo>::value, "");
+
+// BlockFilePointStorageReader ---------------------------------------------------------------------
+class BlockFilePointStorageReader : public PointStorageReaderInterface
+{
+public:
+  explicit BlockFilePointStorageReader(string const & name) :
+    m_mmapReader(name + kBlocksExtension)
+  {
+    auto const * data = m_mmapReader.Data();
+    auto const size = m_mmapReader.Size();
+    CHECK_GREATER_OR_EQUAL(size, sizeof(uint64_t), ("Damaged file."));
+
+    uint64_t blocksCount = 0;
+    memcpy(&blocksCount, data + size - sizeof(blocksCount), sizeof(blocksCount));
+    CHECK_LESS(blocksCount, (size - sizeof(blocksCount)) / sizeof(BlockInfo), ("Damaged file."));
+
+    m_blocks = reinterpret_cast<BlockInfo const *>(data + size - sizeof(blocksCount) -
+                                                   (blocksCount + 1) * sizeof(BlockInfo));
+    m_blocksCount = static_cast<size_t>(blocksCount);
+  }
+
+  // PointStorageReaderInterface overrides:
+  bool GetPoint(uint64_t id, double & lat, double & lon) const override
+  {
+    auto const blocksEnd = m_blocks + m_blocksCount;
+    auto const next = upper_bound(m_blocks, blocksEnd, id, [](uint64_t id, BlockInfo const & b) {
+      return id < b.m_firstId;
+    });
+    if (next == m_blocks)
+      return false;
+
+    auto const & block = *(next - 1);
+    auto const * end = m_mmapReader.Data() + next->m_offset;
+    ArrayByteSource src(m_mmapReader.Data() + block.m_offset);
+
+    uint64_t nodeId = block.m_firstId;
+    auto nodeLat = ReadVarInt<int64_t>(src);
+    auto nodeLon = ReadVarInt<int64_t>(src);
+    while (nodeId < id)
+    {
+      if (src.PtrUC() >= end)
+        return false;
+      nodeId += ReadVarUint<uint64_t>(src) + 1;
+      nodeLat += ReadVarInt<int64_t>(src);
+      nodeLon += ReadVarInt<int64_t>(src);
+    }
+    if (nodeId != id)
+      return false;
+
+    LatLon ll;
+    ll.m_lat = static_cast<int32_t>(nodeLat);
+    ll.m_lon = static_cast<int32_t>(nodeLon);
+    bool ret = FromLatLon(ll, lat, lon);
+    if (!ret)
+    {
+      LOG(LERROR, ("Inconsistent BlockFilePointStorageReader. Node with id =", id,
+                   "must exist but was not found"));
+    }
+    return ret;
+  }
+
+private:
+  MmapReader m_mmapReader;
+  BlockInfo const * m_blocks = nullptr;
+  size_t m_blocksCount = 0;
+};
+
+// BlockFilePointStorageWriter ---------------------------------------------------------------------
+class BlockFilePointStorageWriter : public PointStorageWriterBase
+{
+public:
+  explicit BlockFilePointStorageWriter(string const & name) :
+    m_fileWriter(name + kBlocksExtension)
+  {
+  }
+
+  ~BlockFilePointStorageWriter()
+  {
+    FlushBlock();
+
+    uint64_t const blocksCount = m_blocks.size();
+    BlockInfo end;
+    end.m_firstId = numeric_limits<uint64_t>::max();
+    end.m_offset = m_fileWriter.Pos();
+    m_blocks.push_back(end);
+
+    uint64_t const padding = 0;
+    auto const paddingSize = (sizeof(padding) - m_fileWriter.Pos() % sizeof(padding)) % sizeof(padding);
+    m_fileWriter.Write(&padding, static_cast<size_t>(paddingSize));
+
+    m_fileWriter.Write(m_blocks.data(), m_blocks.size() * sizeof(BlockInfo));
+    m_fileWriter.Write(&blocksCount, sizeof(blocksCount));
+  }
+
+  // PointStorageWriterInterface overrides:
+  void AddPoint(uint64_t id, double lat, double lon) override
+  {
+    CHECK(m_numProcessedPoints == 0 || id > m_lastId,
+          ("Nodes must be sorted by ids for the block storage. Node", id, "is after", m_lastId));
+
+    LatLon ll;
+    ToLatLon(lat, lon, ll);
+
+    if (m_nodesInBlock == kNodesInBlock)
+      FlushBlock();
+
+    PushBackByteSink<vector<uint8_t>> sink(m_block);
+    if (m_nodesInBlock == 0)
+    {
+      BlockInfo block;
+      block.m_firstId = id;
+      block.m_offset = m_fileWriter.Pos();
+      m_blocks.push_back(block);
+
+      WriteVarInt(sink, static_cast<int64_t>(ll.m_lat));
+      WriteVarInt(sink, static_cast<int64_t>(ll.m_lon));
+    }
+    else
+    {
+      WriteVarUint(sink, id - m_lastId - 1);
+      WriteVarInt(sink, static_cast<int64_t>(ll.m_lat) - m_last.m_lat);
+      WriteVarInt(sink, static_cast<int64_t>(ll.m_lon) - m_last.m_lon);
+    }
+
+    m_lastId = id;
+    m_last = ll;
+    ++m_nodesInBlock;
+    ++m_numProcessedPoints;
+  }
+
+private:
+  void FlushBlock()
+  {
+    if (m_block.empty())
+      return;
+
+    m_fileWriter.Write(m_block.data(), m_block.size());
+    m_block.clear();
+    m_nodesInBlock = 0;
+  }
+
+  FileWriter m_fileWriter;
+  vector<BlockInfo> m_blocks;
+  vector<uint8_t> m_block;
+  size_t m_nodesInBlock = 0;
+  uint64_t m_lastId = 0;
+  LatLon m_last;
+};
+
+// Element of the offsets files of OSMElementCacheWriter.
+using OffsetElement = pair<Key, uint64_t>;
+
+void AppendFile(string const & name, FileWriter & writer)
+{
+  FileReader reader(name);
+  uint64_t const size = reader.Size();
+  vector<uint8_t> buffer(static_cast<size_t>(min<uint64_t>(size, 1 << 20)));
+  for (uint64_t pos = 0; pos < size; pos += buffer.size())
+  {
+    auto const chunkSize = static_cast<size_t>(min<uint64_t>(buffer.size(), size - pos));
+    reader.Read(pos, buffer.data(), chunkSize);
+    writer.Write(buffer.data(), chunkSize);
+  }
+}
+
+// Sorts the index file |name| by keys and values in place.
+void SortIndexFile(string const & name)
+{
+  using Element = OffsetElement;
+
+  string const sortedName = name + ".sorted";
+  {
+    FileReader reader(name);
+    uint64_t const size = reader.Size();
+    CHECK_EQUAL(size % sizeof(Element), 0, ("Damaged file", name));
+
+    FileWriter writer(sortedName);
+    WriterFunctor<FileWriter> out(writer);
+    auto const bufferBytes = static_cast<size_t>(min<uint64_t>(size, kIndexSortBufferBytes));
+    FileSorter<Element, WriterFunctor<FileWriter>> sorter(bufferBytes, name + ".sorting", out);
+
+    vector<Element> elements;
+    for (uint64_t pos = 0; pos < size; pos += elements.size() * sizeof(Element))
+    {
+      elements.resize(static_cast<size_t>(
+          min<uint64_t>(kFlushCount, (size - pos) / sizeof(Element))));
+      reader.Read(pos, elements.data(), elements.size() * sizeof(Element));
+      for (auto const & e : elements)
+        sorter.Add(e);
+    }
+    sorter.SortAndFinish();
+  }
+
+  CHECK(base::RenameFileX(sortedName, name), ("Can't rename", sortedName, "to", name));
+}
+
+// Reads elements of a sorted index file one by one, |shift| is added to their values.
+class SortedIndexFileSource
+{
+public:
+  using Element = OffsetElement;
+
+  SortedIndexFileSource(string const & name, uint64_t shift)
+    : m_reader(make_unique<FileReader>(name)), m_size(m_reader->Size()), m_shift(shift)
+  {
+    CHECK_EQUAL(m_size % sizeof(Element), 0, ("Damaged file", name));
+  }
+
+  bool Next(Element & element)
+  {
+    if (m_index == m_elements.size())
+    {
+      if (m_pos == m_size)
+        return false;
+
+      m_elements.resize(static_cast<size_t>(
+          min<uint64_t>(kFlushCount, (m_size - m_pos) / sizeof(Element))));
+      m_reader->Read(m_pos, m_elements.data(), m_elements.size() * sizeof(Element));
+      m_pos += m_elements.size() * sizeof(Element);
+      m_index = 0;
+    }
+
+    element = m_elements[m_index++];
+    element.second += m_shift;
+    return true;
+  }
+
+private:
+  unique_ptr<FileReader> m_reader;
+  uint64_t m_size = 0;
+  uint64_t m_shift = 0;
+  uint64_t m_pos = 0;
+  vector<Element> m_elements;
+  size_t m_index = 0;
+};
+
+// Merges the sorted index files |files| into the index file |name|, which may be one of them.
+// Values of each file are increased by the paired shift, it keeps the files sorted.
+void MergeSortedIndexFiles(vector<pair<string, uint64_t>> const & files, string const & name)
+{
+  using Element = SortedIndexFileSource::Element;
+  using Head = pair<Element, size_t>;
+
+  string const mergedName = name + ".merged";
+  {
+    vector<SortedIndexFileSource> sources;
+    sources.reserve(files.size());
+    priority_queue<Head, vector<Head>, greater<Head>> heads;
+    for (auto const & file : files)
+    {
+      sources.emplace_back(file.first, file.second);
+      Element element;
+      if (sources.back().Next(element))
+        heads.emplace(element, sources.size() - 1);
+    }
+
+    FileWriter writer(mergedName);
+    vector<Element> elements;
+    while (!heads.empty())
+    {
+      auto const head = heads.top();
+      heads.pop();
+      elements.push_back(head.first);
+      if (elements.size() == kFlushCount)
+      {
+        writer.Write(elements.data(), elements.size() * sizeof(Element));
+        elements.clear();
+      }
+
+      Element element;
+      if (sources[head.second].Next(element))
+        heads.emplace(element, head.second);
+    }
+    writer.Write(elements.data(), elements.size() * sizeof(Element));
+  }
+
+  CHECK(base::RenameFileX(mergedName, name), ("Can't rename", mergedName, "to", name));
+}
+
 IndexFileReader const & GetOrCreateIndexReader(string const & name, bool forceReload)
 {
   static mutex m;
@@ -288,35 +597,54 @@ GetOrCreatePointStorageReader(feature::GenerateInfo::NodeStorageType type, strin
 // IndexFileReader ---------------------------------------------------------------------------------
 IndexFileReader::IndexFileReader(string const & name)
 {
-  FileReader fileReader(name);
-  m_elements.clear();
-  size_t const fileSize = fileReader.Size();
+  uint64_t fileSize = 0;
+  CHECK(base::GetFileSize(name, fileSize), ("Can't open file", name));
   if (fileSize == 0)
     return;
 
-  LOG_SHORT(LINFO, ("Offsets reading is started for file", fileReader.GetName()));
   CHECK_EQUAL(0, fileSize % sizeof(Element), ("Damaged file."));
+  m_fileReader = make_unique<MmapReader>(name);
+  m_elements = reinterpret_cast<Element const *>(m_fileReader->Data());
+  m_count = base::checked_cast<size_t>(fileSize / sizeof(Element));
+  ASSERT(is_sorted(m_elements, m_elements + m_count), ("Index file is not sorted", name));
+}
 
-  try
-  {
-    m_elements.resize(base::checked_cast<size_t>(fileSize / sizeof(Element)));
-  }
-  catch (bad_alloc const &)
+IndexFileReader::Element const * IndexFileReader::LowerBound(Key key) const
+{
+  // The lower bound is always in [lo, hi].
+  size_t lo = 0;
+  size_t hi = m_count;
+  // Interpolation takes O(n) steps on skewed keys, so it gives up after the number of steps of
+  // binary search and binary search finishes the rest of the range.
+  size_t steps = 0;
+  for (auto count = m_count; count > 1; count /= 2)
+    ++steps;
+
+  for (; steps > 0 && hi - lo > kMinInterpolationRange; --steps)
   {
-    LOG(LCRITICAL, ("Insufficient memory for required offset map"));
+    Key const first = m_elements[lo].first;
+    Key const last = m_elements[hi - 1].first;
+    if (key <= first)
+      return m_elements + lo;
+    if (key > last)
+      return m_elements + hi;
+
+    auto const ratio = static_cast<double>(key - first) / static_cast<double>(last - first);
+    auto const pos = min(hi - 1, lo + static_cast<size_t>(ratio * (hi - 1 - lo)));
+    if (m_elements[pos].first < key)
+      lo = pos + 1;
+    else
+      hi = pos;
   }
 
-  fileReader.Read(0, &m_elements[0], base::checked_cast<size_t>(fileSize));
-
-  sort(m_elements.begin(), m_elements.end(), ElementComparator());
-
-  LOG_SHORT(LINFO, ("Offsets reading is finished"));
+  return lower_bound(m_elements + lo, m_elements + hi, key,
+                     [](Element const & e, Key k) { return e.first < k; });
 }
 
 bool IndexFileReader::GetValueByKey(Key key, Value & value) const
 {
-  auto it = lower_bound(m_elements.begin(), m_elements.end(), key, ElementComparator());
-  if (it != m_elements.end() && it->first == key)
+  auto const it = LowerBound(key);
+  if (it != m_elements + m_count && it->first == key)
   {
     value = it->second;
     return true;
@@ -325,40 +653,58 @@ bool IndexFileReader::GetValueByKey(Key key, Value & value) const
 }
 
 // IndexFileWriter ---------------------------------------------------------------------------------
-IndexFileWriter::IndexFileWriter(string const & name) :
-  m_fileWriter(name.c_str())
+IndexFileWriter::IndexFileWriter(string const & name)
+  : m_name(name), m_fileWriter(make_unique<FileWriter>(name))
 {
 }
 
-void IndexFileWriter::WriteAll()
+void IndexFileWriter::Flush()
 {
   if (m_elements.empty())
     return;
 
-  m_fileWriter.Write(&m_elements[0], m_elements.size() * sizeof(Element));
+  m_fileWriter->Write(&m_elements[0], m_elements.size() * sizeof(Element));
   m_elements.clear();
 }
 
+void IndexFileWriter::WriteAll()
+{
+  CHECK(m_fileWriter, ("Index is already written", m_name));
+  Flush();
+  m_fileWriter.reset();
+  if (!m_isSorted)
+    SortIndexFile(m_name);
+}
+
 void IndexFileWriter::Add(Key k, Value const & v)
 {
   if (m_elements.size() > kFlushCount)
-    WriteAll();
+    Flush();
 
-  m_elements.emplace_back(k, v);
+  Element const element(k, v);
+  if (element < m_last)
+    m_isSorted = false;
+  m_last = element;
+  m_elements.push_back(element);
 }
 
 // OSMElementCacheReader ---------------------------------------------------------------------------
 OSMElementCacheReader::OSMElementCacheReader(string const & name, bool preload, bool forceReload)
-  : m_fileReader(name)
-  , m_offsetsReader(GetOrCreateIndexReader(name + OFFSET_EXT, forceReload))
-  , m_name(name)
-  , m_preload(preload)
+  : m_offsetsReader(GetOrCreateIndexReader(name + OFFSET_EXT, forceReload)), m_name(name)
 {
-  if (!m_preload)
+  CHECK(base::GetFileSize(name, m_size), ("Can't open file", name));
+  if (m_size == 0)
+    return;
+
+  m_fileReader = make_unique<MmapReader>(name);
+  m_data = m_fileReader->Data();
+  if (!preload)
     return;
-  size_t sz = m_fileReader.Size();
-  m_data.resize(sz);
-  m_fileReader.Read(0, m_data.data(), sz);
+
+  // Touches all the pages of the mapping to read the file ahead of the first requests.
+  uint8_t volatile sum = 0;
+  for (uint64_t pos = 0; pos < m_size; pos += kPageSize)
+    sum += m_data[pos];
 }
 
 // OSMElementCacheWriter ---------------------------------------------------------------------------
@@ -381,12 +727,13 @@ IntermediateDataReader::IntermediateDataReader(PointStorageReaderInterface const
 
 // IntermediateDataWriter
 IntermediateDataWriter::IntermediateDataWriter(PointStorageWriterInterface & nodes,
-                                               feature::GenerateInfo const & info)
+                                               feature::GenerateInfo const & info,
+                                               string const & shardSuffix)
   : m_nodes(nodes)
-  , m_ways(info.GetIntermediateFileName(WAYS_FILE), info.m_preloadCache)
-  , m_relations(info.GetIntermediateFileName(RELATIONS_FILE), info.m_preloadCache)
-  , m_nodeToRelations(info.GetIntermediateFileName(NODES_FILE, ID2REL_EXT))
-  , m_wayToRelations(info.GetIntermediateFileName(WAYS_FILE, ID2REL_EXT))
+  , m_ways(info.GetIntermediateFileName(WAYS_FILE) + shardSuffix, info.m_preloadCache)
+  , m_relations(info.GetIntermediateFileName(RELATIONS_FILE) + shardSuffix, info.m_preloadCache)
+  , m_nodeToRelations(info.GetIntermediateFileName(NODES_FILE, ID2REL_EXT) + shardSuffix)
+  , m_wayToRelations(info.GetIntermediateFileName(WAYS_FILE, ID2REL_EXT) + shardSuffix)
 {}
 
 void IntermediateDataWriter::AddRelation(Key id, RelationElement const & e)
@@ -412,6 +759,46 @@ void IntermediateDataWriter::SaveIndex()
 }
 
 // Functions
+void MergeIntermediateDataShards(feature::GenerateInfo const & info,
+                                 vector<string> const & shardSuffixes)
+{
+  if (shardSuffixes.empty())
+    return;
+
+  // Indexes of the shards are sorted on their own, so they are merged, not sorted again.
+  for (auto const & name : {info.GetIntermediateFileName(WAYS_FILE),
+                            info.GetIntermediateFileName(RELATIONS_FILE)})
+  {
+    // Offsets of a shard are relative to the beginning of the shard.
+    vector<pair<string, uint64_t>> offsets = {{name + OFFSET_EXT, 0}};
+    {
+      FileWriter data(name, FileWriter::OP_APPEND);
+      for (auto const & suffix : shardSuffixes)
+      {
+        offsets.emplace_back(name + suffix + OFFSET_EXT, data.Pos());
+        AppendFile(name + suffix, data);
+        FileWriter::DeleteFileX(name + suffix);
+      }
+    }
+
+    MergeSortedIndexFiles(offsets, name + OFFSET_EXT);
+    for (auto const & suffix : shardSuffixes)
+      FileWriter::DeleteFileX(name + suffix + OFFSET_EXT);
+  }
+
+  for (auto const & name : {info.GetIntermediateFileName(NODES_FILE, ID2REL_EXT),
+                            info.GetIntermediateFileName(WAYS_FILE, ID2REL_EXT)})
+  {
+    vector<pair<string, uint64_t>> indexes = {{name, 0}};
+    for (auto const & suffix : shardSuffixes)
+      indexes.emplace_back(name + suffix, 0);
+
+    MergeSortedIndexFiles(indexes, name);
+    for (auto const & suffix : shardSuffixes)
+      FileWriter::DeleteFileX(name + suffix);
+  }
+}
+
 unique_ptr<PointStorageReaderInterface>
 CreatePointStorageReader(feature::GenerateInfo::NodeStorageType type, string const & name)
 {
@@ -423,6 +810,8 @@ CreatePointStorageReader(feature::GenerateInfo::NodeStorageType type, string con
     return make_unique<MapFilePointStorageReader>(name);
   case feature::GenerateInfo::NodeStorageType::Memory:
     return make_unique<RawMemPointStorageReader>(name);
+  case feature::GenerateInfo::NodeStorageType::Block:
+    return make_unique<BlockFilePointStorageReader>(name);
   }
   UNREACHABLE();
 }
@@ -438,6 +827,8 @@ CreatePointStorageWriter(feature::GenerateInfo::NodeStorageType type, string con
     return make_unique<MapFilePointStorageWriter>(name);
   case feature::GenerateInfo::NodeStorageType::Memory:
     return make_unique<RawMemPointStorageWriter>(name);
+  case feature::GenerateInfo::NodeStorageType::Block:
+    return make_unique<BlockFilePointStorageWriter>(name);
   }
   UNREACHABLE();
 }
@@ -451,6 +842,12 @@ IntermediateData::IntermediateData(feature::GenerateInfo const & info, bool forc
   m_reader = make_shared<IntermediateDataReader>(pointReader, info, forceReload);
 }
 
+IntermediateData::IntermediateData(feature::GenerateInfo const & info,
+                                   shared_ptr<IntermediateDataReader> const & reader)
+  : m_info(info), m_reader(reader)
+{
+}
+
 shared_ptr<IntermediateDataReader> const & IntermediateData::GetCache() const
 {
   return m_reader;
@@ -458,7 +855,7 @@ shared_ptr<IntermediateDataReader> const & IntermediateData::GetCache() const
 
 shared_ptr<IntermediateData> IntermediateData::Clone() const
 {
-  return make_shared<IntermediateData>(m_info);
+  return make_shared<IntermediateData>(m_info, m_reader);
 }
 }  // namespace cache
 }  // namespace generator
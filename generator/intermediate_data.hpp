@@ -15,6 +15,7 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <limits>
 #include <memory>
 #include <mutex>
@@ -70,6 +71,8 @@ public:
   virtual bool GetPoint(uint64_t id, double & lat, double & lon) const = 0;
 };
 
+// Reads an index file written by IndexFileWriter. The file is sorted by keys on writing,
+// so it is mapped to memory as is and searched without copying.
 class IndexFileReader
 {
 public:
@@ -83,10 +86,10 @@ public:
   template <typename ToDo>
   void ForEachByKey(Key k, ToDo && toDo) const
   {
-    auto range = std::equal_range(m_elements.begin(), m_elements.end(), k, ElementComparator());
-    for (; range.first != range.second; ++range.first)
+    auto const end = m_elements + m_count;
+    for (auto it = LowerBound(k); it != end && it->first == k; ++it)
     {
-      if (toDo((*range.first).second) == base::ControlFlow::Break)
+      if (toDo(it->second) == base::ControlFlow::Break)
         break;
     }
   }
@@ -94,20 +97,16 @@ public:
 private:
   using Element = std::pair<Key, Value>;
 
-  struct ElementComparator
-  {
-    bool operator()(Element const & r1, Element const & r2) const
-    {
-      return ((r1.first == r2.first) ? r1.second < r2.second : r1.first < r2.first);
-    }
-    bool operator()(Element const & r1, Key r2) const { return (r1.first < r2); }
-    bool operator()(Key r1, Element const & r2) const { return (r1 < r2.first); }
-  };
+  // Returns the first element with a key not less than |key|. Ids are spread evenly enough
+  // to guess the position by interpolation, binary search finishes the small ranges and
+  // the ranges of skewed keys.
+  Element const * LowerBound(Key key) const;
 
-  std::vector<Element> m_elements;
+  std::unique_ptr<MmapReader> m_fileReader;
+  Element const * m_elements = nullptr;
+  size_t m_count = 0;
 };
 
-
 class IndexFileWriter
 {
 public:
@@ -115,16 +114,25 @@ public:
 
   explicit IndexFileWriter(std::string const & name);
 
+  // Writes the rest of the elements and sorts the file if the elements were added out of order.
+  // Must be called once after all the elements are added.
   void WriteAll();
   void Add(Key k, Value const & v);
 
 private:
   using Element = std::pair<Key, Value>;
 
+  void Flush();
+
+  std::string m_name;
   std::vector<Element> m_elements;
-  FileWriter m_fileWriter;
+  std::unique_ptr<FileWriter> m_fileWriter;
+  Element m_last;
+  bool m_isSorted = true;
 };
 
+// Reads elements written by OSMElementCacheWriter. The file is mapped to memory and elements
+// are decoded right from the mapping, so the reader may be shared between threads.
 class OSMElementCacheReader
 {
 public:
@@ -132,7 +140,7 @@ public:
                                  bool forceReload = false);
 
   template <class Value>
-  bool Read(Key id, Value & value)
+  bool Read(Key id, Value & value) const
   {
     uint64_t pos = 0;
     if (!m_offsetsReader.GetValueByKey(id, pos))
@@ -141,29 +149,23 @@ public:
       return false;
     }
 
-    uint32_t valueSize = m_preload ? *(reinterpret_cast<uint32_t *>(m_data.data() + pos)) : 0;
-    size_t offset = pos + sizeof(uint32_t);
+    uint32_t valueSize = 0;
+    CHECK_LESS_OR_EQUAL(pos + sizeof(valueSize), m_size, ("Damaged file", m_name));
+    std::memcpy(&valueSize, m_data + pos, sizeof(valueSize));
+    CHECK_LESS_OR_EQUAL(pos + sizeof(valueSize) + valueSize, m_size, ("Damaged file", m_name));
 
-    if (!m_preload)
-    {
-      // in case not-in-memory work we read buffer
-      m_fileReader.Read(pos, &valueSize, sizeof(valueSize));
-      m_data.resize(valueSize);
-      m_fileReader.Read(pos + sizeof(valueSize), m_data.data(), valueSize);
-      offset = 0;
-    }
-
-    MemReader reader(m_data.data() + offset, valueSize);
+    MemReader reader(m_data + pos + sizeof(valueSize), valueSize);
     value.Read(reader);
     return true;
   }
 
 protected:
-  FileReader m_fileReader;
+  // Empty files can't be mapped, there is no mapping for them.
+  std::unique_ptr<MmapReader> m_fileReader;
+  uint8_t const * m_data = nullptr;
+  uint64_t m_size = 0;
   IndexFileReader const & m_offsetsReader;
   std::string m_name;
-  std::vector<uint8_t> m_data;
-  bool m_preload = false;
 };
 
 class OSMElementCacheWriter
@@ -204,24 +206,24 @@ public:
 
   // TODO |GetNode()|, |lat|, |lon| are used as y, x in real.
   bool GetNode(Key id, double & lat, double & lon) const { return m_nodes.GetPoint(id, lat, lon); }
-  bool GetWay(Key id, WayElement & e) { return m_ways.Read(id, e); }
+  bool GetWay(Key id, WayElement & e) const { return m_ways.Read(id, e); }
 
   template <typename ToDo>
-  void ForEachRelationByWay(Key id, ToDo && toDo)
+  void ForEachRelationByWay(Key id, ToDo && toDo) const
   {
     RelationProcessor<ToDo> processor(m_relations, std::forward<ToDo>(toDo));
     m_wayToRelations.ForEachByKey(id, processor);
   }
 
   template <typename ToDo>
-  void ForEachRelationByWayCached(Key id, ToDo && toDo)
+  void ForEachRelationByWayCached(Key id, ToDo && toDo) const
   {
     CachedRelationProcessor<ToDo> processor(m_relations, std::forward<ToDo>(toDo));
     m_wayToRelations.ForEachByKey(id, processor);
   }
 
   template <typename ToDo>
-  void ForEachRelationByNodeCached(Key id, ToDo && toDo)
+  void ForEachRelationByNodeCached(Key id, ToDo && toDo) const
   {
     CachedRelationProcessor<ToDo> processor(m_relations, std::forward<ToDo>(toDo));
     m_nodeToRelations.ForEachByKey(id, processor);
@@ -234,7 +236,10 @@ private:
   class ElementProcessorBase
   {
   public:
-    ElementProcessorBase(CacheReader & reader, ToDo & toDo) : m_reader(reader), m_toDo(toDo) {}
+    ElementProcessorBase(CacheReader const & reader, ToDo & toDo)
+      : m_reader(reader), m_toDo(toDo)
+    {
+    }
 
     base::ControlFlow operator()(uint64_t id)
     {
@@ -243,7 +248,7 @@ private:
     }
 
   protected:
-    CacheReader & m_reader;
+    CacheReader const & m_reader;
     ToDo & m_toDo;
   };
 
@@ -252,7 +257,7 @@ private:
   {
     using Base = ElementProcessorBase<RelationElement, ToDo>;
 
-    RelationProcessor(CacheReader & reader, ToDo & toDo) : Base(reader, toDo) {}
+    RelationProcessor(CacheReader const & reader, ToDo & toDo) : Base(reader, toDo) {}
   };
 
   template <typename ToDo>
@@ -260,7 +265,7 @@ private:
   {
     using Base = RelationProcessor<ToDo>;
 
-    CachedRelationProcessor(CacheReader & reader, ToDo & toDo) : Base(reader, toDo) {}
+    CachedRelationProcessor(CacheReader const & reader, ToDo & toDo) : Base(reader, toDo) {}
     base::ControlFlow operator()(uint64_t id) { return this->m_toDo(id, this->m_reader); }
   };
 
@@ -274,7 +279,10 @@ private:
 class IntermediateDataWriter
 {
 public:
-  IntermediateDataWriter(PointStorageWriterInterface & nodes, feature::GenerateInfo const & info);
+  // Ways, relations and their indexes are written to the cache files with |shardSuffix|
+  // appended to the names. Shards must be merged by MergeIntermediateDataShards().
+  IntermediateDataWriter(PointStorageWriterInterface & nodes, feature::GenerateInfo const & info,
+                         std::string const & shardSuffix = {});
 
   void AddNode(Key id, double lat, double lon) { m_nodes.AddPoint(id, lat, lon); }
   void AddWay(Key id, WayElement const & e) { m_ways.Write(id, e); }
@@ -303,6 +311,11 @@ private:
   cache::IndexFileWriter m_wayToRelations;
 };
 
+// Appends ways, relations and their indexes written by IntermediateDataWriters
+// with |shardSuffixes| to the cache files and removes the shards.
+void MergeIntermediateDataShards(feature::GenerateInfo const & info,
+                                 std::vector<std::string> const & shardSuffixes);
+
 std::unique_ptr<PointStorageReaderInterface>
 CreatePointStorageReader(feature::GenerateInfo::NodeStorageType type, std::string const & name);
 
@@ -313,7 +326,10 @@ class IntermediateData
 {
 public:
   explicit IntermediateData(feature::GenerateInfo const & info, bool forceReload = false);
+  IntermediateData(feature::GenerateInfo const & info,
+                   std::shared_ptr<IntermediateDataReader> const & reader);
   std::shared_ptr<IntermediateDataReader> const & GetCache() const;
+  // The reader is safe to use from several threads, so clones share it.
   std::shared_ptr<IntermediateData> Clone() const;
 
 private:
@@ -0,0 +1,114 @@
+#include "generator/intermediate_data_writers_pool.hpp"
+
+#include "generator/osm_source.hpp"
+
+#include "geometry/mercator.hpp"
+
+#include "base/assert.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace generator
+{
+namespace
+{
+size_t const kNodesChunksInFlight = 4;
+}  // namespace
+
+IntermediateDataWritersPool::IntermediateDataWritersPool(
+    cache::PointStorageWriterInterface & nodes, feature::GenerateInfo const & info,
+    TownsDumper & towns, size_t threadsCount)
+  : m_nodes(nodes)
+  , m_info(info)
+  , m_towns(towns)
+  , m_nodesThread(1 /* threadCount */)
+  , m_writersThreads(threadsCount)
+{
+  CHECK_GREATER_OR_EQUAL(threadsCount, 1, ());
+
+  // The first writer writes directly to the cache files, the others are appended to it.
+  for (size_t i = 0; i < threadsCount; ++i)
+  {
+    auto const suffix = i == 0 ? std::string() : ".shard" + std::to_string(i);
+    if (i != 0)
+      m_shardSuffixes.push_back(suffix);
+    m_writers.push_back(std::make_unique<cache::IntermediateDataWriter>(nodes, info, suffix));
+    m_freeWriters.Push(m_writers.back().get());
+  }
+
+  for (size_t i = 0; i < kNodesChunksInFlight; ++i)
+    m_freeNodesChunks.Push(i);
+}
+
+void IntermediateDataWritersPool::Emit(std::vector<OsmElement> && elements)
+{
+  auto const it = std::stable_partition(elements.begin(), elements.end(), [](auto const & e) {
+    return e.IsNode();
+  });
+  auto const nodesCount = static_cast<size_t>(std::distance(elements.begin(), it));
+  // Ways and relations are swapped into a recycled chunk, so the elements of both chunks keep
+  // their memory.
+  auto others = GetChunk(elements.size() - nodesCount);
+  std::swap_ranges(it, elements.end(), others.begin());
+
+  if (nodesCount != 0)
+  {
+    size_t chunk = 0;
+    m_freeNodesChunks.WaitAndPop(chunk);
+    m_nodesThread.SubmitWork([&, chunk, nodesCount, nodes{std::move(elements)}]() mutable {
+      for (size_t i = 0; i < nodesCount; ++i)
+      {
+        auto const & node = nodes[i];
+        m_towns.CheckElement(node);
+        auto const pt = MercatorBounds::FromLatLon(node.m_lat, node.m_lon);
+        m_nodes.AddPoint(node.m_id, pt.y, pt.x);
+      }
+      m_freeNodesChunks.Push(chunk);
+      m_freeChunks.Push(std::move(nodes));
+    });
+  }
+  else
+  {
+    m_freeChunks.Push(std::move(elements));
+  }
+
+  if (!others.empty())
+  {
+    cache::IntermediateDataWriter * writer = nullptr;
+    m_freeWriters.WaitAndPop(writer);
+    m_writersThreads.SubmitWork([&, writer, elements{std::move(others)}]() mutable {
+      for (auto & element : elements)
+        AddElementToCache(*writer, element);
+      m_freeWriters.Push(writer);
+      m_freeChunks.Push(std::move(elements));
+    });
+  }
+  else
+  {
+    m_freeChunks.Push(std::move(others));
+  }
+}
+
+std::vector<OsmElement> IntermediateDataWritersPool::GetChunk(size_t size)
+{
+  std::vector<OsmElement> elements;
+  m_freeChunks.TryPop(elements);
+  elements.resize(size);
+  return elements;
+}
+
+void IntermediateDataWritersPool::Finish()
+{
+  m_nodesThread.WaitingStop();
+  m_writersThreads.WaitingStop();
+
+  for (auto & writer : m_writers)
+    writer->SaveIndex();
+  // Closes the files of the shards.
+  m_writers.clear();
+
+  cache::MergeIntermediateDataShards(m_info, m_shardSuffixes);
+}
+}  // namespace generator
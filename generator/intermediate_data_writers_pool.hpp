@@ -0,0 +1,50 @@
+#pragma once
+
+#include "generator/generate_info.hpp"
+#include "generator/intermediate_data.hpp"
+#include "generator/osm_element.hpp"
+#include "generator/towns_dumper.hpp"
+
+#include "base/thread_pool_computational.hpp"
+#include "base/thread_safe_queue.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace generator
+{
+// Writes the intermediate data in parallel with reading of the source.
+// Nodes are written by a single thread in the order they are emitted because point storages
+// depend on it. Ways and relations are written in chunks by |threadsCount| writers, each
+// one into its own shard of the cache files. Elements of a chunk come from a continuous
+// range of ids since the source is sorted by ids.
+class IntermediateDataWritersPool
+{
+public:
+  IntermediateDataWritersPool(cache::PointStorageWriterInterface & nodes,
+                              feature::GenerateInfo const & info, TownsDumper & towns,
+                              size_t threadsCount);
+
+  void Emit(std::vector<OsmElement> && elements);
+  // Returns a chunk of |size| elements to be filled and emitted. Emitted chunks are reused
+  // after they are written, so their elements keep the memory they allocated.
+  std::vector<OsmElement> GetChunk(size_t size);
+  // Waits for all the emitted elements, saves the indexes and merges the shards.
+  void Finish();
+
+private:
+  cache::PointStorageWriterInterface & m_nodes;
+  feature::GenerateInfo const & m_info;
+  TownsDumper & m_towns;
+  std::vector<std::string> m_shardSuffixes;
+  std::vector<std::unique_ptr<cache::IntermediateDataWriter>> m_writers;
+  base::threads::ThreadSafeQueue<cache::IntermediateDataWriter *> m_freeWriters;
+  // Bounds the number of chunks of nodes that are waiting for the nodes thread.
+  base::threads::ThreadSafeQueue<size_t> m_freeNodesChunks;
+  base::threads::ThreadSafeQueue<std::vector<OsmElement>> m_freeChunks;
+  base::thread_pool::computational::ThreadPool m_nodesThread;
+  base::thread_pool::computational::ThreadPool m_writersThreads;
+};
+}  // namespace generator
@@ -0,0 +1,126 @@
+#include "generator/key_value_concurrent_writer.hpp"
+
+#include "coding/internal/file_data.hpp"
+
+#include "base/assert.hpp"
+#include "base/string_utils.hpp"
+
+#include <atomic>
+#include <utility>
+
+namespace generator
+{
+namespace
+{
+uint64_t NextWriterId()
+{
+  static std::atomic<uint64_t> counter{0};
+  return ++counter;
+}
+}  // namespace
+
+KeyValueConcurrentWriter::KeyValueConcurrentWriter(std::string const & path, FileWriter::Op op,
+                                                   size_t bufferSize)
+  : m_path{path}, m_bufferSize{bufferSize}, m_id{NextWriterId()}
+{
+  // Fails early if the output cannot be opened.
+  FileWriter writer(m_path, op);
+}
+
+KeyValueConcurrentWriter::~KeyValueConcurrentWriter()
+{
+  // Only the segment files are removed here, lines which are not appended by Finish() are lost.
+  for (auto & segment : m_segments)
+  {
+    if (!segment->m_writer)
+      continue;
+
+    auto const segmentPath = segment->m_writer->GetName();
+    segment->m_writer.reset();
+    base::DeleteFileX(segmentPath);
+  }
+}
+
+void KeyValueConcurrentWriter::Write(uint64_t key, JsonValue && value)
+{
+  WriteLine(key, KeyValueStorage::Serialize(value));
+}
+
+void KeyValueConcurrentWriter::Write(uint64_t key, base::JSONPtr const & value)
+{
+  WriteLine(key, KeyValueStorage::Serialize(value));
+}
+
+void KeyValueConcurrentWriter::WriteLine(uint64_t key, std::string const & json)
+{
+  CHECK(!json.empty(), ());
+
+  auto & segment = GetSegment();
+  segment.m_buffer += KeyValueStorage::SerializeDref(key);
+  segment.m_buffer += ' ';
+  segment.m_buffer += json;
+  segment.m_buffer += '\n';
+  if (segment.m_buffer.size() >= m_bufferSize)
+    FlushSegment(segment);
+}
+
+KeyValueConcurrentWriter::Segment & KeyValueConcurrentWriter::GetSegment()
+{
+  // The last used writer and its segment of this thread.
+  thread_local uint64_t cachedWriterId = 0;
+  thread_local Segment * cachedSegment = nullptr;
+  if (cachedWriterId == m_id)
+    return *cachedSegment;
+
+  std::lock_guard<std::mutex> lock(m_segmentsMutex);
+  auto const it = m_threadSegments.emplace(std::this_thread::get_id(), m_segments.size());
+  if (it.second)
+  {
+    auto segment = std::make_unique<Segment>();
+    segment->m_index = m_segments.size();
+    segment->m_buffer.reserve(m_bufferSize);
+    m_segments.emplace_back(std::move(segment));
+  }
+
+  cachedWriterId = m_id;
+  cachedSegment = m_segments[it.first->second].get();
+  return *cachedSegment;
+}
+
+void KeyValueConcurrentWriter::FlushSegment(Segment & segment)
+{
+  if (segment.m_buffer.empty())
+    return;
+
+  if (!segment.m_writer)
+  {
+    segment.m_writer = std::make_unique<FileWriter>(
+        m_path + ".segment" + strings::to_string(m_id) + "." + strings::to_string(segment.m_index));
+  }
+
+  segment.m_writer->Write(segment.m_buffer.data(), segment.m_buffer.size());
+  segment.m_buffer.clear();
+}
+
+void KeyValueConcurrentWriter::Finish()
+{
+  std::lock_guard<std::mutex> lock(m_segmentsMutex);
+  for (auto & segment : m_segments)
+  {
+    if (!segment->m_writer)
+      continue;
+
+    auto const segmentPath = segment->m_writer->GetName();
+    segment->m_writer.reset();
+    base::AppendFileToFile(segmentPath, m_path);
+    CHECK(base::DeleteFileX(segmentPath), (segmentPath));
+  }
+
+  FileWriter output(m_path, FileWriter::OP_APPEND);
+  for (auto & segment : m_segments)
+  {
+    output.Write(segment->m_buffer.data(), segment->m_buffer.size());
+    segment->m_buffer.clear();
+  }
+}
+}  // namespace generator
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "generator/key_value_storage.hpp"
+
+#include "coding/file_writer.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace generator
+{
+// Writes key-value lines in the JSONL format of KeyValueStorage from many threads. Every thread
+// gets its own segment: lines are serialized and buffered without locks and full buffers are
+// written to the segment file of the thread. Finish() appends all the segments to the output,
+// it must be called explicitly: the destructor only removes the segment files.
+// Order of lines from different threads is not defined, as it was with a common stream.
+class KeyValueConcurrentWriter
+{
+public:
+  static size_t constexpr kDefaultBufferSize = 4 * 1024 * 1024;
+
+  // Lines are appended to |path| which is created or truncated according to |op|.
+  explicit KeyValueConcurrentWriter(std::string const & path,
+                                    FileWriter::Op op = FileWriter::OP_APPEND,
+                                    size_t bufferSize = kDefaultBufferSize);
+  ~KeyValueConcurrentWriter();
+
+  KeyValueConcurrentWriter(KeyValueConcurrentWriter const &) = delete;
+  KeyValueConcurrentWriter & operator=(KeyValueConcurrentWriter const &) = delete;
+
+  void Write(uint64_t key, JsonValue && value);
+  void Write(uint64_t key, base::JSONPtr const & value);
+  // Must not be called concurrently with Write(). Segments stay with their threads, so lines
+  // written after Finish() are buffered by the same segments, their files are created again
+  // and appended by the next call.
+  void Finish();
+
+private:
+  struct Segment
+  {
+    size_t m_index = 0;
+    std::string m_buffer;
+    std::unique_ptr<FileWriter> m_writer;
+  };
+
+  void WriteLine(uint64_t key, std::string const & json);
+  Segment & GetSegment();
+  void FlushSegment(Segment & segment);
+
+  std::string m_path;
+  size_t m_bufferSize;
+  // Identifies the writer in the thread local cache of segments, unlike an address it is not
+  // reused.
+  uint64_t m_id;
+  std::mutex m_segmentsMutex;
+  std::unordered_map<std::thread::id, size_t> m_threadSegments;
+  std::vector<std::unique_ptr<Segment>> m_segments;
+};
+}  // namespace generator
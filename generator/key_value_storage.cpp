@@ -1,14 +1,28 @@
 #include "generator/key_value_storage.hpp"
 
+#include "platform/platform.hpp"
+#include "platform/target_os.hpp"
+
+#include "coding/file_reader.hpp"
+#include "coding/file_sort.hpp"
+#include "coding/file_writer.hpp"
+#include "coding/internal/file_data.hpp"
+#include "coding/mmap_reader.hpp"
 #include "coding/reader.hpp"
 
+#include "base/assert.hpp"
+#include "base/cache.hpp"
 #include "base/exception.hpp"
 #include "base/logging.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <iomanip>
+#include <tuple>
+#include <vector>
 
+#include <sys/stat.h>
 
 namespace generator
 {
@@ -130,4 +144,316 @@ std::string KeyValueStorage::SerializeDref(uint64_t number)
 }
 
 size_t KeyValueStorage::Size() const { return m_values.size(); }
+
+// BinaryKeyValueStorage ---------------------------------------------------------------------------
+char constexpr BinaryKeyValueStorage::kExtension[];
+uint64_t constexpr BinaryKeyValueStorage::kVersion;
+
+namespace
+{
+char const kMagic[] = "KVSTBIN";
+// Size of the memory buffer to sort entries of the storage.
+size_t const kSortBufferBytes = 64 * 1024 * 1024;
+// Number of entries which are read at once from the sorted entries file.
+size_t const kReadEntriesCount = 1024;
+// Number of parsed values cached by each thread, log2.
+uint32_t const kLogValuesCacheSize = 10;
+
+uint64_t NextStorageId()
+{
+  static std::atomic<uint64_t> counter{0};
+  return ++counter;
+}
+
+// Calls |fn| for each element of file |path| of elements of type T.
+template <typename T, typename Fn>
+void ForEachInFile(std::string const & path, Fn && fn)
+{
+  FileReader reader(path);
+  auto const size = reader.Size();
+  CHECK_EQUAL(size % sizeof(T), 0, ("Damaged file", path));
+
+  std::vector<T> elements;
+  for (uint64_t pos = 0; pos < size; pos += elements.size() * sizeof(T))
+  {
+    elements.resize(static_cast<size_t>(
+        std::min<uint64_t>(kReadEntriesCount, (size - pos) / sizeof(T))));
+    reader.Read(pos, elements.data(), elements.size() * sizeof(T));
+    for (auto const & element : elements)
+      fn(element);
+  }
+}
+}  // namespace
+
+// static
+void BinaryKeyValueStorage::Build(std::string const & kvPath, std::string const & binPath)
+{
+  std::ifstream input{kvPath};
+  if (!input)
+    MYTHROW(Reader::OpenException, ("Failed to open file", kvPath));
+
+  Header header;
+  std::memcpy(header.m_magic, kMagic, sizeof(header.m_magic));
+  header.m_version = kVersion;
+  if (!ReadSourceInfo(kvPath, header))
+    MYTHROW(Reader::OpenException, ("Failed to get info of file", kvPath));
+
+  // Entries are sorted on disk, values are copied from the JSONL storage when the binary
+  // storage is written.
+  struct Entry
+  {
+    bool operator<(Entry const & rhs) const
+    {
+      return std::tie(m_key, m_valueOffset) < std::tie(rhs.m_key, rhs.m_valueOffset);
+    }
+
+    uint64_t m_key = 0;
+    uint64_t m_valueOffset = 0;
+    uint64_t m_valueSize = 0;
+    Fields m_fields;
+  };
+
+  // Keeps the first entry of a key, it has the least offset.
+  struct UniqueEntriesWriter
+  {
+    void operator()(Entry const & entry)
+    {
+      if (m_count != 0 && m_lastKey == entry.m_key)
+        return;
+
+      m_writer.Write(&entry, sizeof(entry));
+      m_lastKey = entry.m_key;
+      ++m_count;
+    }
+
+    FileWriter & m_writer;
+    uint64_t m_lastKey = 0;
+    uint64_t m_count = 0;
+  };
+
+  auto const entriesPath = binPath + ".entries";
+  {
+    FileWriter entriesWriter(entriesPath);
+    UniqueEntriesWriter uniqueEntries{entriesWriter};
+    FileSorter<Entry, UniqueEntriesWriter> sorter(kSortBufferBytes, binPath + ".sorting",
+                                                  uniqueEntries);
+    std::string line;
+    std::string value;
+    std::streamoff lineNumber = 0;
+    uint64_t lineOffset = 0;
+    while (std::getline(input, line))
+    {
+      ++lineNumber;
+      auto const valueEnd = lineOffset + line.size();
+      lineOffset = valueEnd + 1;
+
+      Entry entry;
+      if (!KeyValueStorage::ParseKeyValueLine(line, lineNumber, entry.m_key, value))
+        continue;
+
+      try
+      {
+        auto const json = base::LoadFromString(value);
+        if (!ReadFields(json.get(), entry.m_fields))
+        {
+          LOG(LWARNING, ("Cannot parse properties of line", lineNumber));
+          continue;
+        }
+      }
+      catch (base::Json::Exception const & e)
+      {
+        LOG(LWARNING, ("Cannot create base::Json in line", lineNumber, ":", e.Msg()));
+        continue;
+      }
+
+      entry.m_valueOffset = valueEnd - value.size();
+      entry.m_valueSize = value.size();
+      sorter.Add(entry);
+    }
+    sorter.SortAndFinish();
+    header.m_count = uniqueEntries.m_count;
+  }
+
+  // Build to a temporary file, so that readers never see a partially written storage.
+  auto const tmpPath = binPath + ".tmp";
+  {
+    FileWriter writer(tmpPath);
+    writer.Write(&header, sizeof(header));
+    ForEachInFile<Entry>(entriesPath, [&](Entry const & entry) {
+      writer.Write(&entry.m_key, sizeof(entry.m_key));
+    });
+
+    ForEachInFile<Entry>(entriesPath, [&](Entry const & entry) {
+      writer.Write(&entry.m_fields, sizeof(entry.m_fields));
+    });
+
+    uint64_t offset = 0;
+    ForEachInFile<Entry>(entriesPath, [&](Entry const & entry) {
+      writer.Write(&offset, sizeof(offset));
+      offset += entry.m_valueSize;
+    });
+    writer.Write(&offset, sizeof(offset));
+
+    FileReader kvReader(kvPath);
+    std::string value;
+    ForEachInFile<Entry>(entriesPath, [&](Entry const & entry) {
+      value.resize(static_cast<size_t>(entry.m_valueSize));
+      kvReader.Read(entry.m_valueOffset, &value[0], value.size());
+      writer.Write(value.data(), value.size());
+    });
+  }
+
+  CHECK(base::DeleteFileX(entriesPath), (entriesPath));
+  CHECK(base::RenameFileX(tmpPath, binPath), (tmpPath, binPath));
+}
+
+// static
+bool BinaryKeyValueStorage::IsBuiltFrom(std::string const & kvPath, std::string const & binPath)
+{
+  Header source;
+  if (!Platform::IsFileExistsByFullPath(binPath) || !ReadSourceInfo(kvPath, source))
+    return false;
+
+  FileReader reader(binPath);
+  Header header;
+  if (reader.Size() < sizeof(header))
+    return false;
+
+  reader.Read(0 /* pos */, &header, sizeof(header));
+  return std::memcmp(header.m_magic, kMagic, sizeof(header.m_magic)) == 0 &&
+         header.m_version == kVersion && header.m_sourceSize == source.m_sourceSize &&
+         header.m_sourceModificationTime == source.m_sourceModificationTime;
+}
+
+// static
+bool BinaryKeyValueStorage::ReadSourceInfo(std::string const & kvPath, Header & header)
+{
+  struct stat kvStat{};
+  if (::stat(kvPath.c_str(), &kvStat) != 0)
+    return false;
+
+  header.m_sourceSize = static_cast<uint64_t>(kvStat.st_size);
+  // Nanoseconds distinguish changes of the source made within the same second.
+#if defined(GEOCORE_OS_MAC)
+  auto const & mtime = kvStat.st_mtimespec;
+#else
+  auto const & mtime = kvStat.st_mtim;
+#endif
+  header.m_sourceModificationTime =
+      static_cast<int64_t>(mtime.tv_sec) * 1000000000 + static_cast<int64_t>(mtime.tv_nsec);
+  return true;
+}
+
+// static
+bool BinaryKeyValueStorage::ReadFields(json_t const * value, Fields & fields)
+{
+  fields = {};
+  auto const * properties = base::GetJSONOptionalField(value, "properties");
+  if (!properties)
+    return true;
+
+  auto const * rank = base::GetJSONOptionalField(properties, "rank");
+  if (rank && json_is_integer(rank))
+  {
+    fields.m_rank = static_cast<int32_t>(json_integer_value(rank));
+    fields.m_flags |= HasRank;
+  }
+
+  auto const * dref = base::GetJSONOptionalField(properties, "dref");
+  if (dref && !base::JSONIsNull(dref))
+  {
+    auto const drefStr = FromJSON<std::string>(dref);
+    if (!strings::to_uint64(drefStr, fields.m_dref, 16))
+      return false;
+
+    fields.m_flags |= HasDref;
+  }
+
+  return true;
+}
+
+BinaryKeyValueStorage::BinaryKeyValueStorage(std::string const & binPath)
+  : m_fileReader{std::make_unique<MmapReader>(binPath)}, m_id{NextStorageId()}
+{
+  auto const * data = m_fileReader->Data();
+  auto const size = m_fileReader->Size();
+
+  Header header;
+  CHECK_GREATER_OR_EQUAL(size, sizeof(header), (binPath));
+  std::memcpy(&header, data, sizeof(header));
+  CHECK_EQUAL(std::memcmp(header.m_magic, kMagic, sizeof(header.m_magic)), 0,
+              ("Not a binary key-value storage", binPath));
+  CHECK_EQUAL(header.m_version, kVersion, ("Unsupported version of storage", binPath));
+
+  auto const count = header.m_count;
+  auto const headerSize =
+      sizeof(header) + count * (sizeof(*m_keys) + sizeof(*m_fields) + sizeof(*m_offsets)) +
+      sizeof(*m_offsets);
+  CHECK_LESS_OR_EQUAL(headerSize, size, (binPath));
+
+  m_count = static_cast<size_t>(count);
+  m_keys = reinterpret_cast<uint64_t const *>(data + sizeof(header));
+  m_fields = reinterpret_cast<Fields const *>(m_keys + m_count);
+  m_offsets = reinterpret_cast<uint64_t const *>(m_fields + m_count);
+  m_values = reinterpret_cast<char const *>(m_offsets + m_count + 1);
+  CHECK_EQUAL(headerSize + m_offsets[m_count], size, (binPath));
+}
+
+BinaryKeyValueStorage::~BinaryKeyValueStorage() = default;
+
+boost::optional<size_t> BinaryKeyValueStorage::FindIndex(uint64_t key) const
+{
+  auto const end = m_keys + m_count;
+  auto const it = std::lower_bound(m_keys, end, key);
+  if (it == end || *it != key)
+    return {};
+
+  return static_cast<size_t>(it - m_keys);
+}
+
+std::shared_ptr<JsonValue> BinaryKeyValueStorage::Find(uint64_t key) const
+{
+  auto const index = FindIndex(key);
+  if (!index)
+    return {};
+
+  // Values are cached by threads, so JSON values are not shared between threads.
+  struct CachedValue
+  {
+    uint64_t m_storageId = 0;
+    std::shared_ptr<JsonValue> m_value;
+  };
+  thread_local base::Cache<uint64_t, CachedValue> cache(kLogValuesCacheSize);
+
+  bool found = false;
+  auto & cached = cache.Find(key, found);
+  if (found && cached.m_storageId == m_id)
+    return cached.m_value;
+
+  auto const begin = m_offsets[*index];
+  std::string const value(m_values + begin, m_offsets[*index + 1] - begin);
+  auto json = std::make_shared<JsonValue>(base::LoadFromString(value));
+  CHECK(json, ());
+  cached.m_storageId = m_id;
+  cached.m_value = json;
+  return json;
+}
+
+boost::optional<int> BinaryKeyValueStorage::GetRank(uint64_t key) const
+{
+  auto const index = FindIndex(key);
+  if (!index || !(m_fields[*index].m_flags & HasRank))
+    return {};
+
+  return m_fields[*index].m_rank;
+}
+
+boost::optional<uint64_t> BinaryKeyValueStorage::GetDref(uint64_t key) const
+{
+  auto const index = FindIndex(key);
+  if (!index || !(m_fields[*index].m_flags & HasDref))
+    return {};
+
+  return m_fields[*index].m_dref;
+}
 }  // namespace generator
@@ -13,6 +13,8 @@
 
 #include "3party/jansson/myjansson.hpp"
 
+class MmapReader;
+
 namespace generator
 {
 class JsonValue
@@ -67,14 +69,89 @@ public:
 
   static std::string SerializeDref(uint64_t number);
 
+  static bool ParseKeyValueLine(std::string const & line, std::streamoff lineNumber, uint64_t & key,
+                                std::string & value);
+
 private:
   using Value = boost::variant<std::shared_ptr<JsonValue>, std::string>;
 
   static bool DefaultPred(KeyValue const &) { return true; }
-  static bool ParseKeyValueLine(std::string const & line, std::streamoff lineNumber, uint64_t & key,
-                                std::string & value);
   std::fstream m_storage;
   std::unordered_map<uint64_t, Value> m_values;
   size_t m_cacheValuesCountLimit;
 };
+
+// Read-only key-value storage in binary format which is built from a JSONL key-value file.
+// The file is mapped to memory and values are parsed only when they are requested. Rank and
+// parent id (properties.rank and properties.dref) are stored apart from JSON values, so they are
+// read without JSON parsing.
+// Layout: header, sorted keys[count], fields[count], offsets[count + 1], JSON values.
+class BinaryKeyValueStorage
+{
+public:
+  static char constexpr kExtension[] = ".bin";
+
+  // Builds binary storage |binPath| from JSONL storage |kvPath|. Only the first value of
+  // a duplicated key is kept, as KeyValueStorage does. Lines which cannot be parsed are skipped.
+  // The size and the modification time of |kvPath| are recorded in the storage.
+  static void Build(std::string const & kvPath, std::string const & binPath);
+  // Returns true if |binPath| is a storage of the current version which is built from |kvPath|
+  // in its current state.
+  static bool IsBuiltFrom(std::string const & kvPath, std::string const & binPath);
+
+  explicit BinaryKeyValueStorage(std::string const & binPath);
+  ~BinaryKeyValueStorage();
+
+  BinaryKeyValueStorage(BinaryKeyValueStorage &&) = default;
+  BinaryKeyValueStorage & operator=(BinaryKeyValueStorage &&) = default;
+
+  bool Contains(uint64_t key) const { return static_cast<bool>(FindIndex(key)); }
+  // Parsed values are cached by each thread, so the same value is parsed once for many
+  // requests. Values must not be modified.
+  std::shared_ptr<JsonValue> Find(uint64_t key) const;
+  boost::optional<int> GetRank(uint64_t key) const;
+  boost::optional<uint64_t> GetDref(uint64_t key) const;
+  size_t Size() const { return m_count; }
+
+private:
+  static uint64_t constexpr kVersion = 2;
+
+  enum Flags : uint32_t
+  {
+    HasRank = 1 << 0,
+    HasDref = 1 << 1,
+  };
+
+  struct Header
+  {
+    char m_magic[8] = {};
+    uint64_t m_version = 0;
+    // Size and modification time in nanoseconds of the JSONL storage the storage is built from.
+    uint64_t m_sourceSize = 0;
+    int64_t m_sourceModificationTime = 0;
+    uint64_t m_count = 0;
+  };
+
+  struct Fields
+  {
+    uint64_t m_dref = 0;
+    int32_t m_rank = 0;
+    uint32_t m_flags = 0;
+  };
+
+  static bool ReadSourceInfo(std::string const & kvPath, Header & header);
+  // Returns false if the fields of |value| are malformed.
+  static bool ReadFields(json_t const * value, Fields & fields);
+  boost::optional<size_t> FindIndex(uint64_t key) const;
+
+  std::unique_ptr<MmapReader> m_fileReader;
+  // Identifies the storage in the thread local caches of values, unlike an address it is not
+  // reused.
+  uint64_t m_id = 0;
+  size_t m_count = 0;
+  uint64_t const * m_keys = nullptr;
+  Fields const * m_fields = nullptr;
+  uint64_t const * m_offsets = nullptr;
+  char const * m_values = nullptr;
+};
 }  // namespace generator
@@ -115,9 +115,6 @@ std::string OsmElement::ToString(std::string const & shift) const
     ss << "Node: " << m_id << " (" << std::fixed << std::setw(7) << m_lat << ", " << m_lon << ")"
        << " tags: " << m_tags.size();
     break;
-  case EntityType::Nd:
-    ss << "Nd ref: " << m_ref;
-    break;
   case EntityType::Way:
     ss << "Way: " << m_id << " nds: " << m_nodes.size() << " tags: " << m_tags.size();
     if (!m_nodes.empty())
@@ -138,12 +135,9 @@ std::string OsmElement::ToString(std::string const & shift) const
         ss << shift2 << e.m_ref << " " << DebugPrint(e.m_type) << " " << e.m_role;
     }
     break;
+  case EntityType::Nd:
   case EntityType::Tag:
-    ss << "Tag: " << m_k << " = " << m_v;
-    break;
   case EntityType::Member:
-    ss << "Member: " << m_ref << " type: " << DebugPrint(m_memberType) << " role: " << m_role;
-    break;
   case EntityType::Unknown:
   case EntityType::Osm:
     UNREACHABLE();
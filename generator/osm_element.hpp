@@ -5,6 +5,7 @@
 #include "base/math.hpp"
 #include "base/string_utils.hpp"
 
+#include <cstddef>
 #include <exception>
 #include <functional>
 #include <iomanip>
@@ -80,11 +81,6 @@ struct OsmElement
     m_id = 0;
     m_lon = 0.0;
     m_lat = 0.0;
-    m_ref = 0;
-    m_k.clear();
-    m_v.clear();
-    m_memberType = EntityType::Unknown;
-    m_role.clear();
 
     m_nodes.clear();
     m_members.clear();
@@ -107,11 +103,6 @@ struct OsmElement
         && m_id == other.m_id
         && base::AlmostEqualAbs(m_lon, other.m_lon, 1e-7)
         && base::AlmostEqualAbs(m_lat, other.m_lat, 1e-7)
-        && m_ref == other.m_ref
-        && m_k == other.m_k
-        && m_v == other.m_v
-        && m_memberType == other.m_memberType
-        && m_role == other.m_role
         && m_nodes == other.m_nodes
         && m_members == other.m_members
         && m_tags == other.m_tags;
@@ -153,17 +144,36 @@ struct OsmElement
   uint64_t m_id = 0;
   double m_lon = 0;
   double m_lat = 0;
-  uint64_t m_ref = 0;
-  std::string m_k;
-  std::string m_v;
-  EntityType m_memberType = EntityType::Unknown;
-  std::string m_role;
 
   std::vector<uint64_t> m_nodes;
   std::vector<Member> m_members;
   std::vector<Tag> m_tags;
 };
 
+// Fills a vector of elements in place. Elements the vector already has are cleared and reused,
+// so their containers keep the memory they allocated. Unused elements are removed at the end.
+class OsmElementsFiller
+{
+public:
+  explicit OsmElementsFiller(std::vector<OsmElement> & elements) : m_elements(elements) {}
+  ~OsmElementsFiller() { m_elements.resize(m_count); }
+
+  // Returns the next element of the vector, it is empty.
+  OsmElement & Next()
+  {
+    if (m_count == m_elements.size())
+      m_elements.emplace_back();
+
+    auto & element = m_elements[m_count++];
+    element.Clear();
+    return element;
+  }
+
+private:
+  std::vector<OsmElement> & m_elements;
+  size_t m_count = 0;
+};
+
 base::GeoObjectId GetGeoObjectId(OsmElement const & element);
 
 std::string DebugPrint(OsmElement const & element);
@@ -12,6 +12,7 @@
 #include <iostream>
 #include <iterator>
 #include <sstream>
+#include <string>
 #include <type_traits>
 #include <vector>
 
@@ -623,4 +624,159 @@ public:
   }
 };
 
+// Splits an o5m file into chunks which can be decoded independently. Chunks are cut at Reset
+// datasets: the delta coding and the string table start from scratch after them. Every chunk
+// is a complete o5m file with its own header. A chunk is at least |minChunkSize| bytes long
+// unless the file ends. Files with rare Reset datasets would give huge chunks, so a chunk which
+// reaches |maxChunkSize| bytes is incomplete: its rest up to the next Reset dataset is streamed
+// by ReadChunkRest().
+class O5MChunkReader
+{
+public:
+  O5MChunkReader(TReadFunc reader, size_t minChunkSize, size_t maxChunkSize)
+  : m_reader(reader)
+  , m_minChunkSize(minChunkSize)
+  , m_maxChunkSize(maxChunkSize)
+  , m_buffer(kReadBufferSize)
+  {
+    CHECK_LESS_OR_EQUAL(m_minChunkSize, m_maxChunkSize, ());
+  }
+
+  // Reads the next chunk to |chunk|. Returns false at the end of the file. The rest of
+  // an incomplete chunk must be read by ReadChunkRest() before the next chunk.
+  bool ReadChunk(std::string & chunk, bool & isComplete)
+  {
+    CHECK(m_isChunkComplete, ("The rest of the previous chunk is not read."));
+
+    static char const kChunkHeader[] = {'\xff', '\xe0', '\x04', 'o', '5', 'm', '2'};
+    chunk.assign(std::begin(kChunkHeader), std::end(kChunkHeader));
+    size_t const headerSize = chunk.size();
+
+    // A Reset dataset right at the start of a chunk does not end it.
+    m_isChunkComplete =
+        AppendDatasets(chunk, std::max<size_t>(m_minChunkSize, 1), m_maxChunkSize);
+    bool const hasDatasets = chunk.size() != headerSize;
+    if (m_isChunkComplete)
+      chunk.push_back(static_cast<char>(O5MSource::EntityType::End));
+
+    isComplete = m_isChunkComplete;
+    return hasDatasets;
+  }
+
+  // Reads at most |size| bytes of the rest of the incomplete chunk, which ends with the End
+  // dataset. Returns 0 when the rest is read.
+  size_t ReadChunkRest(uint8_t * buffer, size_t size)
+  {
+    if (m_restPos == m_rest.size())
+    {
+      if (m_isChunkComplete)
+        return 0;
+
+      m_rest.clear();
+      m_restPos = 0;
+      m_isChunkComplete = AppendDatasets(m_rest, 0 /* minSize */, kReadBufferSize /* maxSize */);
+      if (m_isChunkComplete)
+        m_rest.push_back(static_cast<char>(O5MSource::EntityType::End));
+    }
+
+    auto const bytes = std::min(size, m_rest.size() - m_restPos);
+    std::copy_n(m_rest.data() + m_restPos, bytes, buffer);
+    m_restPos += bytes;
+    return bytes;
+  }
+
+private:
+  // Datasets of these types consist of the type byte only.
+  static uint8_t constexpr kFirstSingleByteType = 0xf0;
+  static size_t constexpr kReadBufferSize = 1 << 16;
+
+  bool Refill()
+  {
+    m_size = m_reader(m_buffer.data(), m_buffer.size());
+    m_pos = 0;
+    return m_size != 0;
+  }
+
+  bool GetByte(uint8_t & byte)
+  {
+    if (m_pos == m_size && !Refill())
+      return false;
+    byte = m_buffer[m_pos++];
+    return true;
+  }
+
+  // Appends |size| bytes to |dest| or skips them when |dest| is nullptr.
+  void CopyBytes(uint64_t size, std::string * dest)
+  {
+    while (size != 0)
+    {
+      if (m_pos == m_size)
+        CHECK(Refill(), ("Unexpected end of o5m file."));
+
+      auto const bytes = static_cast<size_t>(std::min<uint64_t>(size, m_size - m_pos));
+      if (dest)
+        dest->append(reinterpret_cast<char const *>(m_buffer.data() + m_pos), bytes);
+      m_pos += bytes;
+      size -= bytes;
+    }
+  }
+
+  // Appends datasets to |dest| until a Reset dataset after at least |minSize| bytes or the end of
+  // the file, then returns true. Returns false when |maxSize| bytes are appended before that.
+  bool AppendDatasets(std::string & dest, size_t minSize, size_t maxSize)
+  {
+    using EntityType = O5MSource::EntityType;
+
+    size_t const startSize = dest.size();
+    uint8_t type = 0;
+    while (!m_isEnd)
+    {
+      if (!GetByte(type) || EntityType(type) == EntityType::End)
+      {
+        m_isEnd = true;
+        break;
+      }
+
+      if (EntityType(type) == EntityType::Reset && dest.size() - startSize >= minSize)
+        return true;
+
+      // The header of the chunk replaces the header of the file.
+      bool const skip = EntityType(type) == EntityType::Header;
+      if (!skip)
+        dest.push_back(static_cast<char>(type));
+
+      if (type < kFirstSingleByteType)
+      {
+        uint64_t size = 0;
+        uint8_t byte = 0;
+        for (uint8_t shift = 0; ; shift += 7)
+        {
+          CHECK(GetByte(byte), ("Unexpected end of o5m file."));
+          if (!skip)
+            dest.push_back(static_cast<char>(byte));
+          size |= static_cast<uint64_t>(byte & 0x7f) << shift;
+          if (!(byte & 0x80))
+            break;
+        }
+        CopyBytes(size, skip ? nullptr : &dest);
+      }
+
+      if (dest.size() - startSize >= maxSize)
+        return false;
+    }
+
+    return true;
+  }
+
+  TReadFunc m_reader;
+  size_t const m_minChunkSize;
+  size_t const m_maxChunkSize;
+  std::vector<uint8_t> m_buffer;
+  size_t m_pos = 0;
+  size_t m_size = 0;
+  bool m_isEnd = false;
+  bool m_isChunkComplete = true;
+  std::string m_rest;
+  size_t m_restPos = 0;
+};
 }  // namespace osm
@@ -0,0 +1,498 @@
+#include "generator/osm_pbf_source.hpp"
+
+#include "base/assert.hpp"
+
+#include <istream>
+#include <string>
+#include <utility>
+
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_streambuf.hpp>
+
+using namespace std;
+
+namespace osm
+{
+namespace
+{
+// Limits of the format.
+size_t const kMaxBlobHeaderSize = 64 * 1024;
+size_t const kMaxBlobSize = 32 * 1024 * 1024;
+
+uint32_t const kVarint = 0;
+uint32_t const kFixed64 = 1;
+uint32_t const kLengthDelimited = 2;
+uint32_t const kFixed32 = 5;
+
+struct Data
+{
+  uint8_t const * m_begin = nullptr;
+  uint8_t const * m_end = nullptr;
+};
+
+// Reader of the protobuf wire format. The messages of the format are simple enough
+// to be read field by field without the generated code.
+class PbfMessage
+{
+public:
+  explicit PbfMessage(Data const & data) : m_pos(data.m_begin), m_end(data.m_end) {}
+
+  // Reads the key of the next field. Returns false at the end of the message.
+  bool Next()
+  {
+    if (m_pos == m_end)
+      return false;
+
+    auto const key = ReadVarint();
+    m_field = static_cast<uint32_t>(key >> 3);
+    m_wireType = static_cast<uint32_t>(key & 7);
+    return true;
+  }
+
+  uint32_t GetField() const { return m_field; }
+
+  uint64_t ReadUInt()
+  {
+    CHECK_EQUAL(m_wireType, kVarint, ("Malformed pbf field", m_field));
+    return ReadVarint();
+  }
+
+  int64_t ReadInt() { return static_cast<int64_t>(ReadUInt()); }
+  int64_t ReadSInt() { return DecodeZigZag(ReadUInt()); }
+
+  Data ReadData()
+  {
+    CHECK_EQUAL(m_wireType, kLengthDelimited, ("Malformed pbf field", m_field));
+    auto const size = ReadVarint();
+    CHECK_LESS_OR_EQUAL(size, static_cast<uint64_t>(m_end - m_pos), ("Malformed pbf field", m_field));
+
+    Data data;
+    data.m_begin = m_pos;
+    data.m_end = m_pos + size;
+    m_pos = data.m_end;
+    return data;
+  }
+
+  string ReadString()
+  {
+    auto const data = ReadData();
+    return string(data.m_begin, data.m_end);
+  }
+
+  // Calls |fn| for the values of a repeated varint field which may be either packed or not.
+  template <typename Fn>
+  void ForEachUInt(Fn && fn)
+  {
+    if (m_wireType != kLengthDelimited)
+    {
+      fn(ReadUInt());
+      return;
+    }
+
+    PbfMessage packed(ReadData());
+    while (packed.m_pos != packed.m_end)
+      fn(packed.ReadVarint());
+  }
+
+  template <typename Fn>
+  void ForEachSInt(Fn && fn)
+  {
+    ForEachUInt([&fn](uint64_t value) { fn(DecodeZigZag(value)); });
+  }
+
+  void Skip()
+  {
+    switch (m_wireType)
+    {
+    case kVarint: ReadVarint(); return;
+    case kFixed64: Advance(8); return;
+    case kLengthDelimited: ReadData(); return;
+    case kFixed32: Advance(4); return;
+    }
+    CHECK(false, ("Unsupported pbf wire type", m_wireType, "of field", m_field));
+  }
+
+private:
+  static int64_t DecodeZigZag(uint64_t value)
+  {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+  }
+
+  uint64_t ReadVarint()
+  {
+    uint64_t value = 0;
+    for (uint32_t shift = 0;; shift += 7)
+    {
+      CHECK(m_pos != m_end && shift < 64, ("Malformed pbf varint."));
+      auto const byte = *m_pos++;
+      value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0)
+        return value;
+    }
+  }
+
+  void Advance(size_t size)
+  {
+    CHECK_LESS_OR_EQUAL(size, static_cast<size_t>(m_end - m_pos), ("Malformed pbf field", m_field));
+    m_pos += size;
+  }
+
+  uint8_t const * m_pos;
+  uint8_t const * m_end;
+  uint32_t m_field = 0;
+  uint32_t m_wireType = kVarint;
+};
+
+// Returns the contents of |blob|, which are decompressed to |buffer| when needed.
+Data UnpackBlob(vector<uint8_t> const & blob, vector<uint8_t> & buffer)
+{
+  Data raw;
+  Data zlibData;
+  uint64_t rawSize = 0;
+
+  PbfMessage message({blob.data(), blob.data() + blob.size()});
+  while (message.Next())
+  {
+    switch (message.GetField())
+    {
+    case 1: raw = message.ReadData(); break;
+    case 2: rawSize = message.ReadUInt(); break;
+    case 3: zlibData = message.ReadData(); break;
+    case 4:
+    case 5:
+    case 6:
+    case 7: CHECK(false, ("Unsupported pbf blob compression", message.GetField())); break;
+    default: message.Skip(); break;
+    }
+  }
+
+  if (raw.m_begin)
+    return raw;
+
+  CHECK(zlibData.m_begin, ("Empty pbf blob."));
+  CHECK_LESS_OR_EQUAL(rawSize, kMaxBlobSize, ("Malformed pbf blob."));
+
+  namespace io = boost::iostreams;
+  io::filtering_istreambuf streamBuf;
+  streamBuf.push(io::zlib_decompressor());
+  streamBuf.push(io::array_source(reinterpret_cast<char const *>(zlibData.m_begin),
+                                  static_cast<size_t>(zlibData.m_end - zlibData.m_begin)));
+  istream stream(&streamBuf);
+
+  buffer.resize(static_cast<size_t>(rawSize));
+  stream.read(reinterpret_cast<char *>(buffer.data()), static_cast<streamsize>(buffer.size()));
+  CHECK_EQUAL(static_cast<uint64_t>(stream.gcount()), rawSize, ("Malformed pbf zlib data."));
+  return {buffer.data(), buffer.data() + buffer.size()};
+}
+
+void CheckHeaderBlock(Data const & block)
+{
+  PbfMessage message(block);
+  while (message.Next())
+  {
+    if (message.GetField() != 4 /* required_features */)
+    {
+      message.Skip();
+      continue;
+    }
+
+    auto const feature = message.ReadString();
+    CHECK(feature == "OsmSchema-V0.6" || feature == "DenseNodes",
+          ("Unsupported pbf feature:", feature));
+  }
+}
+
+class PrimitiveBlockDecoder
+{
+public:
+  explicit PrimitiveBlockDecoder(vector<OsmElement> & elements) : m_elements(elements) {}
+
+  void Decode(Data const & block)
+  {
+    vector<Data> groups;
+    PbfMessage message(block);
+    while (message.Next())
+    {
+      switch (message.GetField())
+      {
+      case 1: ReadStringTable(message.ReadData()); break;
+      case 2: groups.push_back(message.ReadData()); break;
+      case 17: m_granularity = message.ReadInt(); break;
+      case 19: m_latOffset = message.ReadInt(); break;
+      case 20: m_lonOffset = message.ReadInt(); break;
+      default: message.Skip(); break;
+      }
+    }
+
+    for (auto const & group : groups)
+    {
+      PbfMessage groupMessage(group);
+      while (groupMessage.Next())
+      {
+        switch (groupMessage.GetField())
+        {
+        case 1: DecodeNode(groupMessage.ReadData()); break;
+        case 2: DecodeDenseNodes(groupMessage.ReadData()); break;
+        case 3: DecodeWay(groupMessage.ReadData()); break;
+        case 4: DecodeRelation(groupMessage.ReadData()); break;
+        default: groupMessage.Skip(); break;
+        }
+      }
+    }
+  }
+
+private:
+  void ReadStringTable(Data const & table)
+  {
+    PbfMessage message(table);
+    while (message.Next())
+    {
+      if (message.GetField() == 1)
+        m_strings.push_back(message.ReadString());
+      else
+        message.Skip();
+    }
+  }
+
+  char const * GetString(uint64_t id) const
+  {
+    CHECK_LESS(id, m_strings.size(), ("Malformed pbf string id."));
+    return m_strings[static_cast<size_t>(id)].c_str();
+  }
+
+  double ToDegrees(int64_t value, int64_t offset) const
+  {
+    return 1e-9 * static_cast<double>(offset + m_granularity * value);
+  }
+
+  void AddTags(OsmElement & element)
+  {
+    CHECK_EQUAL(m_keys.size(), m_values.size(), ("Malformed pbf tags of", element.m_id));
+    for (size_t i = 0; i < m_keys.size(); ++i)
+      element.AddTag(GetString(m_keys[i]), GetString(m_values[i]));
+    m_keys.clear();
+    m_values.clear();
+  }
+
+  void DecodeNode(Data const & data)
+  {
+    auto & element = m_elements.Next();
+    element.m_type = OsmElement::EntityType::Node;
+    int64_t lat = 0;
+    int64_t lon = 0;
+
+    PbfMessage message(data);
+    while (message.Next())
+    {
+      switch (message.GetField())
+      {
+      case 1: element.m_id = static_cast<uint64_t>(message.ReadSInt()); break;
+      case 2: message.ForEachUInt([&](uint64_t key) { m_keys.push_back(key); }); break;
+      case 3: message.ForEachUInt([&](uint64_t value) { m_values.push_back(value); }); break;
+      case 8: lat = message.ReadSInt(); break;
+      case 9: lon = message.ReadSInt(); break;
+      default: message.Skip(); break;
+      }
+    }
+
+    element.m_lat = ToDegrees(lat, m_latOffset);
+    element.m_lon = ToDegrees(lon, m_lonOffset);
+    AddTags(element);
+  }
+
+  void DecodeDenseNodes(Data const & data)
+  {
+    vector<int64_t> ids;
+    vector<int64_t> lats;
+    vector<int64_t> lons;
+    vector<uint64_t> keysValues;
+
+    // Ids and coordinates are delta coded.
+    int64_t id = 0;
+    int64_t lat = 0;
+    int64_t lon = 0;
+    PbfMessage message(data);
+    while (message.Next())
+    {
+      switch (message.GetField())
+      {
+      case 1: message.ForEachSInt([&](int64_t delta) { ids.push_back(id += delta); }); break;
+      case 8: message.ForEachSInt([&](int64_t delta) { lats.push_back(lat += delta); }); break;
+      case 9: message.ForEachSInt([&](int64_t delta) { lons.push_back(lon += delta); }); break;
+      case 10: message.ForEachUInt([&](uint64_t kv) { keysValues.push_back(kv); }); break;
+      default: message.Skip(); break;
+      }
+    }
+
+    CHECK(ids.size() == lats.size() && ids.size() == lons.size(), ("Malformed pbf dense nodes."));
+
+    // Tags of the nodes are pairs of keys and values, the tags of a node end with zero.
+    size_t kv = 0;
+    for (size_t i = 0; i < ids.size(); ++i)
+    {
+      auto & element = m_elements.Next();
+      element.m_type = OsmElement::EntityType::Node;
+      element.m_id = static_cast<uint64_t>(ids[i]);
+      element.m_lat = ToDegrees(lats[i], m_latOffset);
+      element.m_lon = ToDegrees(lons[i], m_lonOffset);
+
+      while (kv < keysValues.size() && keysValues[kv] != 0)
+      {
+        CHECK_LESS(kv + 1, keysValues.size(), ("Malformed pbf dense nodes."));
+        element.AddTag(GetString(keysValues[kv]), GetString(keysValues[kv + 1]));
+        kv += 2;
+      }
+      ++kv;
+    }
+  }
+
+  void DecodeWay(Data const & data)
+  {
+    auto & element = m_elements.Next();
+    element.m_type = OsmElement::EntityType::Way;
+
+    int64_t ref = 0;
+    PbfMessage message(data);
+    while (message.Next())
+    {
+      switch (message.GetField())
+      {
+      case 1: element.m_id = static_cast<uint64_t>(message.ReadInt()); break;
+      case 2: message.ForEachUInt([&](uint64_t key) { m_keys.push_back(key); }); break;
+      case 3: message.ForEachUInt([&](uint64_t value) { m_values.push_back(value); }); break;
+      case 8:
+        message.ForEachSInt([&](int64_t delta) {
+          element.AddNd(static_cast<uint64_t>(ref += delta));
+        });
+        break;
+      default: message.Skip(); break;
+      }
+    }
+
+    AddTags(element);
+  }
+
+  void DecodeRelation(Data const & data)
+  {
+    auto & element = m_elements.Next();
+    element.m_type = OsmElement::EntityType::Relation;
+
+    vector<uint64_t> roles;
+    vector<int64_t> ids;
+    vector<OsmElement::EntityType> types;
+    int64_t id = 0;
+    PbfMessage message(data);
+    while (message.Next())
+    {
+      switch (message.GetField())
+      {
+      case 1: element.m_id = static_cast<uint64_t>(message.ReadInt()); break;
+      case 2: message.ForEachUInt([&](uint64_t key) { m_keys.push_back(key); }); break;
+      case 3: message.ForEachUInt([&](uint64_t value) { m_values.push_back(value); }); break;
+      case 8: message.ForEachUInt([&](uint64_t role) { roles.push_back(role); }); break;
+      case 9: message.ForEachSInt([&](int64_t delta) { ids.push_back(id += delta); }); break;
+      case 10: message.ForEachUInt([&](uint64_t type) { types.push_back(ToEntityType(type)); }); break;
+      default: message.Skip(); break;
+      }
+    }
+
+    CHECK(roles.size() == ids.size() && roles.size() == types.size(),
+          ("Malformed pbf members of", element.m_id));
+    for (size_t i = 0; i < ids.size(); ++i)
+      element.AddMember(static_cast<uint64_t>(ids[i]), types[i], GetString(roles[i]));
+
+    AddTags(element);
+  }
+
+  static OsmElement::EntityType ToEntityType(uint64_t type)
+  {
+    switch (type)
+    {
+    case 0: return OsmElement::EntityType::Node;
+    case 1: return OsmElement::EntityType::Way;
+    case 2: return OsmElement::EntityType::Relation;
+    }
+    return OsmElement::EntityType::Unknown;
+  }
+
+  OsmElementsFiller m_elements;
+  vector<string> m_strings;
+  int64_t m_granularity = 100;
+  int64_t m_latOffset = 0;
+  int64_t m_lonOffset = 0;
+  vector<uint64_t> m_keys;
+  vector<uint64_t> m_values;
+};
+}  // namespace
+
+// PbfBlobReader -----------------------------------------------------------------------------------
+PbfBlobReader::PbfBlobReader(ReadFunc reader) : m_reader(move(reader)) {}
+
+bool PbfBlobReader::ReadDataBlob(vector<uint8_t> & blob)
+{
+  while (true)
+  {
+    if (!ReadBytes(m_header, sizeof(uint32_t), true /* allowEnd */))
+      return false;
+
+    // The size of the header is in the network byte order.
+    uint32_t const headerSize = (uint32_t{m_header[0]} << 24) | (uint32_t{m_header[1]} << 16) |
+                                (uint32_t{m_header[2]} << 8) | uint32_t{m_header[3]};
+    CHECK_LESS_OR_EQUAL(headerSize, kMaxBlobHeaderSize, ("Malformed pbf blob header."));
+    ReadBytes(m_header, headerSize, false /* allowEnd */);
+
+    string type;
+    uint64_t blobSize = 0;
+    PbfMessage header({m_header.data(), m_header.data() + m_header.size()});
+    while (header.Next())
+    {
+      switch (header.GetField())
+      {
+      case 1: type = header.ReadString(); break;
+      case 3: blobSize = header.ReadUInt(); break;
+      default: header.Skip(); break;
+      }
+    }
+
+    CHECK_LESS_OR_EQUAL(blobSize, kMaxBlobSize, ("Malformed pbf blob header."));
+    ReadBytes(blob, static_cast<size_t>(blobSize), false /* allowEnd */);
+
+    if (type == "OSMData")
+      return true;
+
+    if (type == "OSMHeader")
+    {
+      vector<uint8_t> buffer;
+      CheckHeaderBlock(UnpackBlob(blob, buffer));
+    }
+
+    // Blobs of unknown types must be skipped.
+  }
+}
+
+bool PbfBlobReader::ReadBytes(vector<uint8_t> & buffer, size_t size, bool allowEnd)
+{
+  buffer.resize(size);
+  size_t readBytes = 0;
+  while (readBytes < size)
+  {
+    auto const bytes = m_reader(buffer.data() + readBytes, size - readBytes);
+    if (bytes == 0)
+      break;
+    readBytes += bytes;
+  }
+
+  if (readBytes == 0 && allowEnd)
+    return false;
+
+  CHECK_EQUAL(readBytes, size, ("Unexpected end of pbf file."));
+  return true;
+}
+
+void DecodePbfDataBlob(vector<uint8_t> const & blob, vector<OsmElement> & elements)
+{
+  vector<uint8_t> buffer;
+  PrimitiveBlockDecoder(elements).Decode(UnpackBlob(blob, buffer));
+}
+}  // namespace osm
@@ -0,0 +1,36 @@
+// See PBF Format definition at https://wiki.openstreetmap.org/wiki/PBF_Format
+#pragma once
+
+#include "generator/osm_element.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace osm
+{
+// Reads blobs of a pbf file. Only the framing of the file is parsed here, so the blobs
+// are independent and may be decoded by DecodePbfDataBlob() on different threads.
+class PbfBlobReader
+{
+public:
+  using ReadFunc = std::function<size_t(uint8_t *, size_t)>;
+
+  explicit PbfBlobReader(ReadFunc reader);
+
+  // Reads the next blob with OSMData to |blob|. Blobs with OSMHeader are checked for
+  // the required features and skipped. Returns false at the end of the file.
+  bool ReadDataBlob(std::vector<uint8_t> & blob);
+
+private:
+  bool ReadBytes(std::vector<uint8_t> & buffer, size_t size, bool allowEnd);
+
+  ReadFunc m_reader;
+  std::vector<uint8_t> m_header;
+};
+
+// Decodes all the entities of the OSMData |blob| to |elements| in the order of the blob.
+// Elements |elements| already has are reused, see OsmElementsFiller.
+void DecodePbfDataBlob(std::vector<uint8_t> const & blob, std::vector<OsmElement> & elements);
+}  // namespace osm
@@ -1,6 +1,7 @@
 #include "generator/osm_source.hpp"
 
 #include "generator/intermediate_data.hpp"
+#include "generator/intermediate_data_writers_pool.hpp"
 #include "generator/intermediate_elements.hpp"
 #include "generator/osm_element.hpp"
 #include "generator/towns_dumper.hpp"
@@ -15,9 +16,11 @@
 #include "base/stl_helpers.hpp"
 #include "base/file_name_utils.hpp"
 
+#include <algorithm>
 #include <fstream>
 #include <memory>
 #include <set>
+#include <utility>
 
 #include "defines.hpp"
 
@@ -25,6 +28,28 @@ using namespace std;
 
 namespace generator
 {
+namespace
+{
+// Reads a chunk of a source straight from memory.
+class ChunkSource
+{
+public:
+  explicit ChunkSource(string const & chunk) : m_chunk(chunk) {}
+
+  uint64_t Read(char * buffer, uint64_t bufferSize)
+  {
+    auto const bytes = static_cast<size_t>(min<uint64_t>(bufferSize, m_chunk.size() - m_pos));
+    copy_n(m_chunk.data() + m_pos, bytes, buffer);
+    m_pos += bytes;
+    return bytes;
+  }
+
+private:
+  string const & m_chunk;
+  size_t m_pos = 0;
+};
+}  // namespace
+
 // SourceReader ------------------------------------------------------------------------------------
 SourceReader::SourceReader() : m_file(unique_ptr<istream, Deleter>(&cin, Deleter(false)))
 {
@@ -148,11 +173,14 @@ void ProcessOsmElementsFromO5M(SourceReader & stream, function<void(OsmElement *
 }
 
 ProcessorOsmElementsFromO5M::ProcessorOsmElementsFromO5M(SourceReader & stream)
-  : m_stream(stream)
-  , m_dataset([&](uint8_t * buffer, size_t size) {
-      return m_stream.Read(reinterpret_cast<char *>(buffer), size);
+  : ProcessorOsmElementsFromO5M([&stream](uint8_t * buffer, size_t size) {
+      return stream.Read(reinterpret_cast<char *>(buffer), size);
   })
-  , m_pos(m_dataset.begin())
+{
+}
+
+ProcessorOsmElementsFromO5M::ProcessorOsmElementsFromO5M(osm::TReadFunc reader)
+  : m_dataset(move(reader)), m_pos(m_dataset.begin())
 {
 }
 
@@ -172,7 +200,8 @@ bool ProcessorOsmElementsFromO5M::TryRead(OsmElement & element)
     }
   };
 
-  element = {};
+  // Keeps the capacity of the containers of the element, elements of chunks are reused.
+  element.Clear();
 
   // Be careful, we could call Nodes(), Members(), Tags() from O5MSource::Entity
   // only once (!). Because these functions read data from file simultaneously with
@@ -214,8 +243,34 @@ bool ProcessorOsmElementsFromO5M::TryRead(OsmElement & element)
   return true;
 }
 
+void ProcessOsmElementsFromPbf(SourceReader & stream, function<void(OsmElement *)> processor,
+                               size_t threadsCount)
+{
+  ProcessorOsmElementsFromPbf processorOsmElementsFromPbf(stream, threadsCount);
+  OsmElement element;
+  while (processorOsmElementsFromPbf.TryRead(element))
+    processor(&element);
+}
+
+ProcessorOsmElementsFromPbf::ProcessorOsmElementsFromPbf(SourceReader & stream,
+                                                         size_t threadsCount)
+  : m_blobReader([&stream](uint8_t * buffer, size_t size) {
+      return stream.Read(reinterpret_cast<char *>(buffer), size);
+  })
+  , m_blobs([this](vector<uint8_t> & blob, bool & /* isComplete */) {
+               return m_blobReader.ReadDataBlob(blob);
+             },
+             osm::DecodePbfDataBlob, threadsCount)
+{
+}
+
+bool ProcessorOsmElementsFromPbf::TryRead(OsmElement & element)
+{
+  return m_blobs.TryRead(element);
+}
+
 ProcessorOsmElementsFromXml::ProcessorOsmElementsFromXml(SourceReader & stream)
-  : m_xmlSource([&, this](auto * element) { m_queue.emplace(*element); })
+  : m_xmlSource([&, this](auto * element) { m_queue.emplace(move(*element)); })
   , m_parser(stream, m_xmlSource)
 {
 }
@@ -225,7 +280,7 @@ bool ProcessorOsmElementsFromXml::TryReadFromQueue(OsmElement & element)
   if (m_queue.empty())
     return false;
 
-  element = m_queue.front();
+  element = move(m_queue.front());
   m_queue.pop();
   return true;
 }
@@ -244,29 +299,151 @@ bool ProcessorOsmElementsFromXml::TryRead(OsmElement & element)
 // Generate functions implementations.
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
-bool GenerateIntermediateData(feature::GenerateInfo & info)
+void BuildIntermediateDataFromPbf(SourceReader & stream, cache::IntermediateDataWriter & cache,
+                                  TownsDumper & towns)
+{
+  ProcessorOsmElementsFromPbf processorOsmElementsFromPbf(stream);
+  OsmElement element;
+  while (processorOsmElementsFromPbf.TryRead(element))
+  {
+    towns.CheckElement(element);
+    AddElementToCache(cache, element);
+  }
+}
+
+void BuildIntermediateDataInParallel(SourceReader & stream, IntermediateDataWritersPool & writers,
+                                     feature::GenerateInfo const & info, size_t threadsCount)
 {
+  auto sourceProcessor = CreateProcessorOsmElements(stream, info.m_osmFileType, threadsCount);
+
+  size_t const kChunkSize = 1024;
+  size_t elementPos = 0;
+  auto elements = writers.GetChunk(kChunkSize);
+  while (sourceProcessor->TryRead(elements[elementPos]))
+  {
+    if (++elementPos != kChunkSize)
+      continue;
+
+    writers.Emit(move(elements));
+    elements = writers.GetChunk(kChunkSize);
+    elementPos = 0;
+  }
+  elements.resize(elementPos);
+  writers.Emit(move(elements));
+  writers.Finish();
+}
+
+bool GenerateIntermediateData(feature::GenerateInfo & info, size_t threadsCount)
+{
+  CHECK_GREATER_OR_EQUAL(threadsCount, 1, ());
+
   auto nodes = cache::CreatePointStorageWriter(info.m_nodeStorageType,
                                                info.GetIntermediateFileName(NODES_FILE));
-  cache::IntermediateDataWriter cache(*nodes, info);
   TownsDumper towns;
   SourceReader reader = info.m_osmFileName.empty() ? SourceReader() : SourceReader(info.m_osmFileName);
 
   LOG(LINFO, ("Data source:", info.m_osmFileName));
 
-  switch (info.m_osmFileType)
+  if (threadsCount == 1)
   {
-  case feature::GenerateInfo::OsmSourceType::XML:
-    BuildIntermediateDataFromXML(reader, cache, towns);
-    break;
-  case feature::GenerateInfo::OsmSourceType::O5M:
-    BuildIntermediateDataFromO5M(reader, cache, towns);
-    break;
+    cache::IntermediateDataWriter cache(*nodes, info);
+    switch (info.m_osmFileType)
+    {
+    case feature::GenerateInfo::OsmSourceType::XML:
+      BuildIntermediateDataFromXML(reader, cache, towns);
+      break;
+    case feature::GenerateInfo::OsmSourceType::O5M:
+      BuildIntermediateDataFromO5M(reader, cache, towns);
+      break;
+    case feature::GenerateInfo::OsmSourceType::PBF:
+      BuildIntermediateDataFromPbf(reader, cache, towns);
+      break;
+    }
+
+    cache.SaveIndex();
+  }
+  else
+  {
+    // One thread of the budget writes nodes, the rest is split between decoders of the source
+    // and writers of ways and relations.
+    auto const writersCount = max<size_t>((threadsCount - 1) / 2, 1);
+    auto const decodersCount = max<size_t>(threadsCount - 1 - writersCount, 1);
+    IntermediateDataWritersPool writers(*nodes, info, towns, writersCount);
+    BuildIntermediateDataInParallel(reader, writers, info, decodersCount);
   }
 
-  cache.SaveIndex();
   towns.Dump(info.GetIntermediateFileName(TOWNS_FILE));
   LOG(LINFO, ("Added points count =", nodes->GetNumProcessedPoints()));
   return true;
 }
+
+unique_ptr<ProcessorOsmElementsInterface> CreateProcessorOsmElements(
+    SourceReader & stream, feature::GenerateInfo::OsmSourceType type, size_t threadsCount,
+    size_t chunkSize)
+{
+  CHECK_GREATER_OR_EQUAL(threadsCount, 1, ());
+
+  using Processor = ProcessorOsmElementsFromChunks<string>;
+
+  switch (type)
+  {
+  case feature::GenerateInfo::OsmSourceType::O5M:
+  {
+    if (threadsCount == 1)
+      return make_unique<ProcessorOsmElementsFromO5M>(stream);
+
+    auto chunks = make_shared<osm::O5MChunkReader>(
+        [&stream](uint8_t * buffer, size_t size) {
+          return stream.Read(reinterpret_cast<char *>(buffer), size);
+        },
+        chunkSize, kMaxO5MChunkSizeFactor * chunkSize);
+    return make_unique<Processor>(
+        [chunks](string & chunk, bool & isComplete) {
+          return chunks->ReadChunk(chunk, isComplete);
+        },
+        [](string const & chunk, vector<OsmElement> & elements) {
+          ChunkSource source(chunk);
+          ProcessorOsmElementsFromO5M processor([&source](uint8_t * buffer, size_t size) {
+            return source.Read(reinterpret_cast<char *>(buffer), size);
+          });
+          // Swapping gives the buffers of the reused elements to the processor.
+          OsmElementsFiller filler(elements);
+          OsmElement element;
+          while (processor.TryRead(element))
+            swap(filler.Next(), element);
+        },
+        threadsCount,
+        [chunks](string && chunk) -> unique_ptr<ProcessorOsmElementsInterface> {
+          auto head = make_shared<string>(move(chunk));
+          auto source = make_shared<ChunkSource>(*head);
+          return make_unique<ProcessorOsmElementsFromO5M>(
+              [head, source, chunks](uint8_t * buffer, size_t size) -> size_t {
+                auto const bytes = source->Read(reinterpret_cast<char *>(buffer), size);
+                return bytes != 0 ? bytes : chunks->ReadChunkRest(buffer, size);
+              });
+        });
+  }
+  case feature::GenerateInfo::OsmSourceType::XML:
+  {
+    if (threadsCount == 1)
+      return make_unique<ProcessorOsmElementsFromXml>(stream);
+
+    auto chunks = make_shared<XMLChunkReader>(
+        [&stream](char * buffer, uint64_t size) { return stream.Read(buffer, size); }, chunkSize);
+    return make_unique<Processor>(
+        [chunks](string & chunk, bool & /* isComplete */) { return chunks->ReadChunk(chunk); },
+        [](string const & chunk, vector<OsmElement> & elements) {
+          ChunkSource source(chunk);
+          OsmElementsFiller filler(elements);
+          XMLSource xmlSource([&filler](OsmElement * element) { swap(filler.Next(), *element); });
+          XMLSequenceParser<ChunkSource, XMLSource> parser(source, xmlSource);
+          while (parser.Read()) /* empty */;
+        },
+        threadsCount);
+  }
+  case feature::GenerateInfo::OsmSourceType::PBF:
+    return make_unique<ProcessorOsmElementsFromPbf>(stream, threadsCount);
+  }
+  UNREACHABLE();
+}
 }  // namespace generator
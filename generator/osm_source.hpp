@@ -3,17 +3,25 @@
 #include "generator/generate_info.hpp"
 #include "generator/intermediate_data.hpp"
 #include "generator/osm_o5m_source.hpp"
+#include "generator/osm_pbf_source.hpp"
 #include "generator/osm_xml_source.hpp"
 #include "generator/translator_interface.hpp"
 
 #include "coding/parse_xml.hpp"
 
+#include "base/thread_pool_computational.hpp"
+#include "base/thread_safe_queue.hpp"
+
+#include <cstddef>
 #include <functional>
+#include <future>
 #include <iostream>
 #include <memory>
 #include <queue>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 struct OsmElement;
 class FeatureParams;
@@ -43,10 +51,17 @@ public:
   uint64_t Read(char * buffer, uint64_t bufferSize);
 };
 
-bool GenerateIntermediateData(feature::GenerateInfo & info);
+// Generates the intermediate data. When |threadsCount| is greater than one, the source is read
+// in parallel with writing of the data, see IntermediateDataWritersPool. The threads are split
+// between decoding of the source and writing of the data.
+bool GenerateIntermediateData(feature::GenerateInfo & info, size_t threadsCount = 1);
+
+void AddElementToCache(cache::IntermediateDataWriter & cache, OsmElement & element);
 
 void ProcessOsmElementsFromO5M(SourceReader & stream, std::function<void(OsmElement *)> processor);
 void ProcessOsmElementsFromXML(SourceReader & stream, std::function<void(OsmElement *)> processor);
+void ProcessOsmElementsFromPbf(SourceReader & stream, std::function<void(OsmElement *)> processor,
+                               size_t threadsCount = 1);
 
 class ProcessorOsmElementsInterface
 {
@@ -60,16 +75,138 @@ class ProcessorOsmElementsFromO5M : public ProcessorOsmElementsInterface
 {
 public:
   explicit ProcessorOsmElementsFromO5M(SourceReader & stream);
+  explicit ProcessorOsmElementsFromO5M(osm::TReadFunc reader);
 
   // ProcessorOsmElementsInterface overrides:
   bool TryRead(OsmElement & element) override;
 
 private:
-  SourceReader & m_stream;
   osm::O5MSource m_dataset;
   osm::O5MSource::Iterator m_pos;
 };
 
+// Chunks of a source are read by the calling thread and decoded by |threadsCount| threads.
+// Elements are returned in the order of the source. A chunk which can not be decoded alone is
+// incomplete: it is decoded on the calling thread together with its rest from the source.
+template <typename Chunk>
+class ProcessorOsmElementsFromChunks : public ProcessorOsmElementsInterface
+{
+public:
+  // Reads the next chunk, returns false at the end of the source.
+  using ChunkReader = std::function<bool(Chunk & chunk, bool & isComplete)>;
+  // Fills |elements| with the elements of the chunk. Called from several threads. |elements|
+  // may hold the elements of a consumed chunk, they are reused with OsmElementsFiller.
+  using ChunkDecoder = std::function<void(Chunk const & chunk, std::vector<OsmElement> & elements)>;
+  // Makes a processor of the incomplete chunk and its rest.
+  using IncompleteChunkDecoder =
+      std::function<std::unique_ptr<ProcessorOsmElementsInterface>(Chunk && chunk)>;
+
+  ProcessorOsmElementsFromChunks(ChunkReader reader, ChunkDecoder decoder, size_t threadsCount,
+                                 IncompleteChunkDecoder incompleteChunkDecoder = {})
+    : m_reader(std::move(reader))
+    , m_decoder(std::move(decoder))
+    , m_incompleteChunkDecoder(std::move(incompleteChunkDecoder))
+    , m_maxChunksInProcessing(2 * threadsCount)
+    , m_threadPool(threadsCount)
+  {
+  }
+
+  // ProcessorOsmElementsInterface overrides:
+  bool TryRead(OsmElement & element) override
+  {
+    while (m_pos == m_elements.size())
+    {
+      ReadChunks();
+      if (m_chunks.empty())
+        return false;
+
+      auto & chunk = m_chunks.front();
+      if (chunk.m_incomplete)
+      {
+        if (chunk.m_incomplete->TryRead(element))
+          return true;
+
+        m_chunks.pop();
+        continue;
+      }
+
+      m_freeElements.Push(std::move(m_elements));
+      m_elements = chunk.m_elements.get();
+      m_chunks.pop();
+      m_pos = 0;
+    }
+
+    // The element of the caller is reused by the next chunk decoded into m_elements.
+    std::swap(element, m_elements[m_pos++]);
+    return true;
+  }
+
+private:
+  struct ChunkInProcessing
+  {
+    std::future<std::vector<OsmElement>> m_elements;
+    std::unique_ptr<ProcessorOsmElementsInterface> m_incomplete;
+  };
+
+  void ReadChunks()
+  {
+    // The source is read by the processor of an incomplete chunk until it is done.
+    while (!m_isEndOfSource && m_chunks.size() < m_maxChunksInProcessing &&
+           (m_chunks.empty() || !m_chunks.back().m_incomplete))
+    {
+      Chunk chunk;
+      bool isComplete = true;
+      if (!m_reader(chunk, isComplete))
+      {
+        m_isEndOfSource = true;
+        break;
+      }
+
+      if (!isComplete)
+      {
+        CHECK(m_incompleteChunkDecoder, ());
+        m_chunks.push({{}, m_incompleteChunkDecoder(std::move(chunk))});
+        continue;
+      }
+
+      m_chunks.push({m_threadPool.Submit([this, chunk{std::move(chunk)}]() {
+                       std::vector<OsmElement> elements;
+                       m_freeElements.TryPop(elements);
+                       m_decoder(chunk, elements);
+                       return elements;
+                     }),
+                     nullptr});
+    }
+  }
+
+  ChunkReader m_reader;
+  ChunkDecoder m_decoder;
+  IncompleteChunkDecoder m_incompleteChunkDecoder;
+  size_t const m_maxChunksInProcessing;
+  bool m_isEndOfSource = false;
+  std::queue<ChunkInProcessing> m_chunks;
+  std::vector<OsmElement> m_elements;
+  size_t m_pos = 0;
+  // Vectors of consumed elements, chunks are decoded into them.
+  base::threads::ThreadSafeQueue<std::vector<OsmElement>> m_freeElements;
+  base::thread_pool::computational::ThreadPool m_threadPool;
+};
+
+// Blobs of the pbf file are read by the calling thread and decoded by |threadsCount| threads.
+// Elements are returned in the order of the file.
+class ProcessorOsmElementsFromPbf : public ProcessorOsmElementsInterface
+{
+public:
+  explicit ProcessorOsmElementsFromPbf(SourceReader & stream, size_t threadsCount = 1);
+
+  // ProcessorOsmElementsInterface overrides:
+  bool TryRead(OsmElement & element) override;
+
+private:
+  osm::PbfBlobReader m_blobReader;
+  ProcessorOsmElementsFromChunks<std::vector<uint8_t>> m_blobs;
+};
+
 class ProcessorOsmElementsFromXml : public ProcessorOsmElementsInterface
 {
 public:
@@ -85,4 +222,14 @@ private:
   XMLSequenceParser<SourceReader, XMLSource> m_parser;
   std::queue<OsmElement> m_queue;
 };
+
+// Creates a processor of the source of |type|. When |threadsCount| is greater than one, the source
+// is split into chunks of about |chunkSize| bytes, which are decoded in parallel. O5M chunks are
+// cut at Reset datasets only, parts of the source without them longer than
+// kMaxO5MChunkSizeFactor * |chunkSize| are decoded on the calling thread.
+size_t constexpr kMaxO5MChunkSizeFactor = 16;
+
+std::unique_ptr<ProcessorOsmElementsInterface> CreateProcessorOsmElements(
+    SourceReader & stream, feature::GenerateInfo::OsmSourceType type, size_t threadsCount = 1,
+    size_t chunkSize = 4 * 1024 * 1024);
 }  // namespace generator
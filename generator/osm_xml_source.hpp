@@ -5,6 +5,10 @@
 #include "base/assert.hpp"
 #include "base/string_utils.hpp"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <string>
 
@@ -19,25 +23,28 @@ public:
 
   void AddAttr(std::string const & key, std::string const & value)
   {
-    if (!m_current)
-      return;
-
-    if (key == "id")
-      CHECK(strings::to_uint64(value, m_current->m_id), ("Unknown element with invalid id:", value));
-    else if (key == "lon")
-      CHECK(strings::to_double(value, m_current->m_lon), ("Bad node lon:", value));
-    else if (key == "lat")
-      CHECK(strings::to_double(value, m_current->m_lat), ("Bad node lat:", value));
-    else if (key == "ref")
-      CHECK(strings::to_uint64(value, m_current->m_ref), ("Bad node ref in way:", value));
-    else if (key == "k")
-      m_current->m_k = value;
-    else if (key == "v")
-      m_current->m_v = value;
-    else if (key == "type")
-      m_current->m_memberType = OsmElement::StringToEntityType(value);
-    else if (key == "role")
-      m_current->m_role = value;
+    if (m_depth == 2)
+    {
+      if (key == "id")
+        CHECK(strings::to_uint64(value, m_parent.m_id), ("Unknown element with invalid id:", value));
+      else if (key == "lon")
+        CHECK(strings::to_double(value, m_parent.m_lon), ("Bad node lon:", value));
+      else if (key == "lat")
+        CHECK(strings::to_double(value, m_parent.m_lat), ("Bad node lat:", value));
+    }
+    else if (m_depth > 2)
+    {
+      if (key == "ref")
+        CHECK(strings::to_uint64(value, m_child.m_ref), ("Bad node ref in way:", value));
+      else if (key == "k")
+        m_child.m_key = value;
+      else if (key == "v")
+        m_child.m_value = value;
+      else if (key == "type")
+        m_child.m_memberType = OsmElement::StringToEntityType(value);
+      else if (key == "role")
+        m_child.m_role = value;
+    }
   }
 
   bool Push(std::string const & tagName)
@@ -51,15 +58,12 @@ public:
     switch (++m_depth)
     {
     case 1:
-      m_current = nullptr;
       break;
     case 2:
-      m_current = &m_parent;
-      m_current->m_type = tagKey;
+      m_parent.m_type = tagKey;
       break;
     default:
-      m_current = &m_child;
-      m_current->m_type = tagKey;
+      m_child.m_type = tagKey;
       break;
     }
     return true;
@@ -73,7 +77,7 @@ public:
       break;
 
     case 1:
-      m_emitter(m_current);
+      m_emitter(&m_parent);
       m_parent.Clear();
       break;
 
@@ -84,7 +88,7 @@ public:
         m_parent.AddMember(m_child.m_ref, m_child.m_memberType, m_child.m_role);
         break;
       case OsmElement::EntityType::Tag:
-        m_parent.AddTag(m_child.m_k, m_child.m_v);
+        m_parent.AddTag(m_child.m_key, m_child.m_value);
         break;
       case OsmElement::EntityType::Nd:
         m_parent.AddNd(m_child.m_ref);
@@ -92,17 +96,121 @@ public:
       default:
         break;
       }
-      m_current = &m_parent;
       m_child.Clear();
     }
   }
 
 private:
+  // Attributes of a tag, a node of a way or a member of a relation.
+  struct Child
+  {
+    void Clear()
+    {
+      m_type = OsmElement::EntityType::Unknown;
+      m_ref = 0;
+      m_key.clear();
+      m_value.clear();
+      m_memberType = OsmElement::EntityType::Unknown;
+      m_role.clear();
+    }
+
+    OsmElement::EntityType m_type = OsmElement::EntityType::Unknown;
+    uint64_t m_ref = 0;
+    std::string m_key;
+    std::string m_value;
+    OsmElement::EntityType m_memberType = OsmElement::EntityType::Unknown;
+    std::string m_role;
+  };
+
   OsmElement m_parent;
-  OsmElement m_child;
+  Child m_child;
 
   size_t m_depth = 0;
-  OsmElement * m_current = nullptr;
 
   Emitter m_emitter;
 };
+
+// Splits an osm xml file into chunks at the starts of nodes, ways and relations, so the chunks
+// can be parsed independently. Chunks are wrapped into the root element to be complete
+// documents. Chunks are split after |minChunkSize| bytes are read, at the last element start.
+class XMLChunkReader
+{
+public:
+  using ReadFunc = std::function<uint64_t(char *, uint64_t)>;
+
+  XMLChunkReader(ReadFunc reader, size_t minChunkSize)
+    : m_reader(reader), m_minChunkSize(minChunkSize)
+  {
+  }
+
+  // Reads the next chunk to |chunk|. Returns false at the end of the file.
+  bool ReadChunk(std::string & chunk)
+  {
+    if (m_isEnd && m_rest.empty())
+      return false;
+
+    std::string data;
+    data.swap(m_rest);
+    size_t splitPos = std::string::npos;
+    while (splitPos == std::string::npos)
+    {
+      auto const size = data.size();
+      data.resize(size + kReadSize);
+      auto const readBytes = static_cast<size_t>(m_reader(&data[size], kReadSize));
+      data.resize(size + readBytes);
+      if (readBytes == 0)
+      {
+        m_isEnd = true;
+        break;
+      }
+
+      if (data.size() >= m_minChunkSize)
+        splitPos = FindLastElementStart(data);
+    }
+
+    chunk.clear();
+    if (!m_isFirst)
+      chunk += "<osm>";
+    if (splitPos == std::string::npos)
+    {
+      chunk += data;
+    }
+    else
+    {
+      chunk.append(data, 0, splitPos);
+      chunk += "</osm>";
+      m_rest = data.substr(splitPos);
+    }
+    m_isFirst = false;
+    return true;
+  }
+
+private:
+  static size_t constexpr kReadSize = 1 << 16;
+
+  // Returns the position of the last start of a node, way or relation which is not at the
+  // beginning of |data|.
+  static size_t FindLastElementStart(std::string const & data)
+  {
+    for (auto pos = data.rfind('<'); pos != std::string::npos && pos != 0;
+         pos = data.rfind('<', pos - 1))
+    {
+      for (char const * name : {"node", "way", "relation"})
+      {
+        auto const length = strlen(name);
+        if (pos + length + 1 < data.size() && data.compare(pos + 1, length, name) == 0 &&
+            strchr(" \t\r\n/>", data[pos + length + 1]) != nullptr)
+        {
+          return pos;
+        }
+      }
+    }
+    return std::string::npos;
+  }
+
+  ReadFunc m_reader;
+  size_t const m_minChunkSize;
+  std::string m_rest;
+  bool m_isFirst = true;
+  bool m_isEnd = false;
+};
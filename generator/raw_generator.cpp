@@ -8,6 +8,8 @@
 
 #include "base/thread_pool_computational.hpp"
 
+#include <algorithm>
+
 #include "defines.hpp"
 
 namespace generator
@@ -96,30 +98,29 @@ bool RawGenerator::GenerateFilteredFeatures()
   SourceReader reader = m_genInfo.m_osmFileName.empty() ? SourceReader()
                                                         : SourceReader(m_genInfo.m_osmFileName);
 
-  std::unique_ptr<ProcessorOsmElementsInterface> sourceProcessor;
-  switch (m_genInfo.m_osmFileType) {
-  case feature::GenerateInfo::OsmSourceType::O5M:
-    sourceProcessor = std::make_unique<ProcessorOsmElementsFromO5M>(reader);
-    break;
-  case feature::GenerateInfo::OsmSourceType::XML:
-    sourceProcessor = std::make_unique<ProcessorOsmElementsFromXml>(reader);
-    break;
-  }
-  CHECK(sourceProcessor, ());
+  auto sourceProcessor =
+      CreateProcessorOsmElements(reader, m_genInfo.m_osmFileType, m_threadsCount);
 
   TranslatorsPool translators(m_translators, m_threadsCount);
   RawGeneratorWriter rawGeneratorWriter(m_queue, m_genInfo.m_tmpDir);
   rawGeneratorWriter.Run();
 
+  // Chunks grow while all the translators are busy to cut the overhead of the pool, and shrink
+  // while some translators wait for elements to feed them sooner.
+  size_t const minChunkSize = std::max(m_chunkSize / 8, size_t{1});
+  size_t const maxChunkSize = m_chunkSize * 16;
+  size_t chunkSize = m_chunkSize;
   size_t element_pos = 0;
-  std::vector<OsmElement> elements(m_chunkSize);
+  auto elements = translators.GetChunk(chunkSize);
   while (sourceProcessor->TryRead(elements[element_pos]))
   {
-    if (++element_pos != m_chunkSize)
+    if (++element_pos != chunkSize)
       continue;
 
+    chunkSize = translators.HasFreeTranslators() ? std::max(chunkSize / 2, minChunkSize)
+                                                 : std::min(chunkSize * 2, maxChunkSize);
     translators.Emit(std::move(elements));
-    elements = vector<OsmElement>(m_chunkSize);
+    elements = translators.GetChunk(chunkSize);
     element_pos = 0;
   }
   elements.resize(element_pos);
@@ -5,11 +5,14 @@
 #include "generator/regions/place_point.hpp"
 
 #include "geometry/mercator.hpp"
+#include "geometry/region2d/prepared_region.hpp"
 
 #include "base/assert.hpp"
 
 #include <algorithm>
+#include <mutex>
 #include <numeric>
+#include <vector>
 
 #include <boost/geometry.hpp>
 
@@ -19,10 +22,59 @@ namespace generator
 {
 namespace regions
 {
+class Region::PreparedPolygon
+{
+public:
+  // The same as boost::geometry::covered_by(point, polygon) up to the precision of
+  // m2::PreparedRegion.
+  bool Covers(BoostPolygon const & polygon, BoostPoint const & point)
+  {
+    std::call_once(m_prepared, [&]() { Prepare(polygon); });
+
+    m2::PointD const pt{point.get<0>(), point.get<1>()};
+    if (m_outer.Locate(pt) == Location::Outside)
+      return false;
+
+    for (auto const & inner : m_inners)
+    {
+      if (inner.Locate(pt) == Location::Inside)
+        return false;
+    }
+
+    return true;
+  }
+
+private:
+  using Location = m2::PreparedRegionD::Location;
+
+  template <typename Ring>
+  static m2::PreparedRegionD PrepareRing(Ring const & ring)
+  {
+    std::vector<m2::PointD> points;
+    points.reserve(ring.size());
+    for (auto const & point : ring)
+      points.emplace_back(point.template get<0>(), point.template get<1>());
+
+    return m2::PreparedRegionD(std::move(points));
+  }
+
+  void Prepare(BoostPolygon const & polygon)
+  {
+    m_outer = PrepareRing(polygon.outer());
+    for (auto const & inner : polygon.inners())
+      m_inners.emplace_back(PrepareRing(inner));
+  }
+
+  std::once_flag m_prepared;
+  m2::PreparedRegionD m_outer;
+  std::vector<m2::PreparedRegionD> m_inners;
+};
+
 Region::Region(FeatureBuilder const & fb, RegionDataProxy const & rd)
   : RegionWithName(fb.GetParams().name)
   , RegionWithData(rd)
   , m_polygon(std::make_shared<BoostPolygon>())
+  , m_preparedPolygon(std::make_shared<PreparedPolygon>())
 {
   FillPolygon(fb);
   boost::geometry::envelope(*m_polygon, m_rect);
@@ -115,6 +167,7 @@ bool Region::IsLocality() const { return GetPlaceType() >= PlaceType::City; }
 void Region::SetPolygon(std::shared_ptr<BoostPolygon> const & polygon)
 {
   m_polygon = polygon;
+  m_preparedPolygon = std::make_shared<PreparedPolygon>();
   m_rect = {};
   boost::geometry::envelope(*m_polygon, m_rect);
   m_area = boost::geometry::area(*m_polygon);
@@ -126,8 +179,18 @@ bool Region::Contains(Region const & smaller) const
   CHECK(m_polygon, ());
   CHECK(smaller.m_polygon, ());
 
-  return boost::geometry::covered_by(smaller.m_rect, m_rect) &&
-         boost::geometry::covered_by(*smaller.m_polygon, *m_polygon);
+  if (!boost::geometry::covered_by(smaller.m_rect, m_rect))
+    return false;
+
+  // A vertex of the smaller polygon outside of this one is the usual reason of a negative result
+  // and it is found without the heavy polygons check.
+  for (auto const & point : smaller.m_polygon->outer())
+  {
+    if (!m_preparedPolygon->Covers(*m_polygon, point))
+      return false;
+  }
+
+  return boost::geometry::covered_by(*smaller.m_polygon, *m_polygon);
 }
 
 double Region::CalculateOverlapPercentage(Region const & other) const
@@ -140,8 +203,7 @@ double Region::CalculateOverlapPercentage(Region const & other) const
 
   std::vector<BoostPolygon> coll;
   boost::geometry::intersection(*other.m_polygon, *m_polygon, coll);
-  auto const min =
-      std::min(boost::geometry::area(*other.m_polygon), boost::geometry::area(*m_polygon));
+  auto const min = std::min(other.m_area, m_area);
   auto const binOp = [](double x, BoostPolygon const & y) { return x + boost::geometry::area(y); };
   auto const sum = std::accumulate(std::begin(coll), std::end(coll), 0., binOp);
   return (sum / min) * 100;
@@ -173,8 +235,7 @@ bool Region::Contains(BoostPoint const & point) const
 {
   CHECK(m_polygon, ());
 
-  return boost::geometry::covered_by(point, m_rect) &&
-         boost::geometry::covered_by(point, *m_polygon);
+  return boost::geometry::covered_by(point, m_rect) && m_preparedPolygon->Covers(*m_polygon, point);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -54,10 +54,15 @@ public:
   double GetArea() const { return m_area; }
 
 private:
+  // Polygon prepared for point location. It is shared by copies of the region and is built on
+  // the first use, since most of regions are never tested as containers.
+  class PreparedPolygon;
+
   void FillPolygon(feature::FeatureBuilder const & fb);
 
   boost::optional<PlacePoint> m_placeLabel;
   std::shared_ptr<BoostPolygon> m_polygon;
+  std::shared_ptr<PreparedPolygon> m_preparedPolygon;
   BoostRect m_rect;
   double m_area;
 };
@@ -4,13 +4,31 @@
 
 #include "base/logging.hpp"
 
+#include <algorithm>
+#include <utility>
+
 namespace generator
 {
 namespace regions
 {
+namespace
+{
+BinaryKeyValueStorage OpenStorage(std::string const & kvPath)
+{
+  auto const binPath = kvPath + BinaryKeyValueStorage::kExtension;
+  if (!BinaryKeyValueStorage::IsBuiltFrom(kvPath, binPath))
+  {
+    LOG(LINFO, ("Building binary key-value storage", binPath));
+    BinaryKeyValueStorage::Build(kvPath, binPath);
+  }
+
+  return BinaryKeyValueStorage(binPath);
+}
+}  // namespace
+
 RegionInfoGetter::RegionInfoGetter(std::string const & indexPath, std::string const & kvPath)
     : m_index{indexer::ReadIndex<indexer::RegionsIndexBox<IndexReader>, MmapReader>(indexPath)}
-    , m_storage(kvPath, 1'000'000)
+    , m_storage{OpenStorage(kvPath)}
 {
   m_borders.Deserialize(indexPath);
 }
@@ -29,6 +47,19 @@ boost::optional<KeyValue> RegionInfoGetter::FindDeepest(
   return GetDeepest(point, ids, selector);
 }
 
+bool RegionInfoGetter::IsSameRegionInRect(m2::RectD const & rect) const
+{
+  // Each region is either around all points of the rect or around none of them, so
+  // GetDeepest() checks the same regions for all points.
+  bool isSameRegion = true;
+  auto const check = [this, &rect, &isSameRegion](base::GeoObjectId const & osmId) {
+    if (isSameRegion && m_borders.IsBorderInRect(osmId.GetEncodedId(), rect))
+      isSameRegion = false;
+  };
+  m_index.ForEachInRect(check, rect);
+  return isSameRegion;
+}
+
 std::vector<base::GeoObjectId> RegionInfoGetter::SearchObjectsInIndex(m2::PointD const & point) const
 {
   std::vector<base::GeoObjectId> ids;
@@ -41,61 +72,47 @@ boost::optional<KeyValue> RegionInfoGetter::GetDeepest(m2::PointD const & point,
     std::vector<base::GeoObjectId> const & ids, Selector const & selector) const
 {
   // Minimize CPU consumption by minimizing the number of calls to heavy m_borders.IsPointInside().
-  std::multimap<int, KeyValue> regionsByRank;
+  // Ranks and parents are read from the storage without JSON parsing, only the found region is
+  // parsed.
+  std::vector<std::pair<int, uint64_t>> regionsByRank;
   for (auto const & id : ids)
   {
-    auto const region = m_storage.Find(id.GetEncodedId());
-    if (!region)
+    auto const regionId = id.GetEncodedId();
+    if (!m_storage.Contains(regionId))
     {
       LOG(LWARNING, ("Id not found in region key-value storage:", id));
       continue;
     }
 
-    auto rank = GetRank(*region);
-    regionsByRank.emplace(rank, KeyValue{id.GetEncodedId(), std::move(region)});
+    auto const rank = m_storage.GetRank(regionId);
+    CHECK(rank, ("No rank of region", id));
+    regionsByRank.emplace_back(*rank, regionId);
   }
 
+  // Regions of the same rank keep the order of the index, as in a multimap.
+  std::stable_sort(std::begin(regionsByRank), std::end(regionsByRank),
+                   [](auto const & l, auto const & r) { return l.first < r.first; });
+
   boost::optional<uint64_t> borderCheckSkipRegionId;
   for (auto i = regionsByRank.rbegin(); i != regionsByRank.rend(); ++i)
   {
-    auto & kv = i->second;
-    auto regionId = kv.first;
+    auto const regionId = i->second;
     if (regionId != borderCheckSkipRegionId && !m_borders.IsPointInside(regionId, point))
       continue;
 
+    auto kv = KeyValue{regionId, m_storage.Find(regionId)};
     if (selector(kv))
       return std::move(kv);
 
     // Skip border check for parent region.
-    if (auto dref = GetDref(*kv.second))
+    if (auto dref = m_storage.GetDref(regionId))
       borderCheckSkipRegionId = dref;
   }
 
   return {};
 }
 
-int RegionInfoGetter::GetRank(JsonValue const & json) const
-{
-  auto && properties = base::GetJSONObligatoryField(json, "properties");
-  return FromJSONObject<int>(properties, "rank");
-}
-
-boost::optional<uint64_t> RegionInfoGetter::GetDref(JsonValue const & json) const
-{
-  auto && properties = base::GetJSONObligatoryField(json, "properties");
-  auto && drefField = base::GetJSONOptionalField(properties, "dref");
-  if (!drefField || base::JSONIsNull(drefField))
-    return {};
-
-  std::string drefStr = FromJSON<std::string>(drefField);
-  uint64_t dref = 0;
-
-  CHECK(strings::to_uint64(drefStr, dref, 16), ());
-
-  return dref;
-}
-
-KeyValueStorage const & RegionInfoGetter::GetStorage() const noexcept
+BinaryKeyValueStorage const & RegionInfoGetter::GetStorage() const noexcept
 {
   return m_storage;
 }
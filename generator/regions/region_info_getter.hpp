@@ -8,6 +8,7 @@
 #include "coding/reader.hpp"
 
 #include "geometry/point2d.hpp"
+#include "geometry/rect2d.hpp"
 
 #include "base/geo_object_id.hpp"
 
@@ -35,7 +36,10 @@ public:
 
   boost::optional<KeyValue> FindDeepest(m2::PointD const & point) const;
   boost::optional<KeyValue> FindDeepest(m2::PointD const & point, Selector const & selector) const;
-  KeyValueStorage const & GetStorage() const noexcept;
+  // Returns true if FindDeepest() gives the same result for all points of the rect: no region
+  // border passes through the rect. False negatives are possible near borders.
+  bool IsSameRegionInRect(m2::RectD const & rect) const;
+  BinaryKeyValueStorage const & GetStorage() const noexcept;
 
 private:
   using IndexReader = ReaderPtr<Reader>;
@@ -43,13 +47,10 @@ private:
   std::vector<base::GeoObjectId> SearchObjectsInIndex(m2::PointD const & point) const;
   boost::optional<KeyValue> GetDeepest(m2::PointD const & point, std::vector<base::GeoObjectId> const & ids,
                                        Selector const & selector) const;
-  int GetRank(JsonValue const & json) const;
-  // Get parent id of object: optional field `properties.dref` in JSON.
-  boost::optional<uint64_t> GetDref(JsonValue const & json) const;
 
   indexer::RegionsIndex<IndexReader> m_index;
   indexer::Borders m_borders;
-  KeyValueStorage m_storage;
+  BinaryKeyValueStorage m_storage;
 };
 }  // namespace regions
 }  // namespace generator
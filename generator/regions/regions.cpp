@@ -62,7 +62,7 @@ public:
     RegionsBuilder::Regions regions;
     PlacePointsMap placePointsMap;
     std::tie(regions, placePointsMap) =
-        ReadDatasetFromTmpMwm(m_pathInRegionsTmpMwm, m_regionsInfoCollector);
+        ReadDatasetFromTmpMwm(m_pathInRegionsTmpMwm, m_regionsInfoCollector, threadsCount);
     RegionsBuilder builder{std::move(regions), std::move(placePointsMap), threadsCount};
 
     GenerateRegions(builder);
@@ -226,7 +226,7 @@ private:
   }
 
   std::tuple<RegionsBuilder::Regions, PlacePointsMap> ReadDatasetFromTmpMwm(
-      std::string const & tmpMwmFilename, RegionInfo & collector)
+      std::string const & tmpMwmFilename, RegionInfo & collector, size_t threadsCount)
   {
     RegionsBuilder::Regions regions;
     PlacePointsMap placePointsMap;
@@ -256,7 +256,7 @@ private:
       }
     };
 
-    ForEachFromDatRawFormat(tmpMwmFilename, toDo);
+    ForEachParallelOrderedFromDatRawFormat(threadsCount, tmpMwmFilename, toDo);
     return std::make_tuple(std::move(regions), std::move(placePointsMap));
   }
 
@@ -337,6 +337,10 @@ void GenerateRegions(std::string const & pathInRegionsTmpMwm,
 {
   RegionsGenerator(pathInRegionsTmpMwm, pathInRegionsCollector, pathOutRegionsKv,
                    pathOutRepackedRegionsTmpMwm, verbose, threadsCount);
+
+  // JSONL is kept for downstream consumers, the binary storage is read by RegionInfoGetter.
+  BinaryKeyValueStorage::Build(pathOutRegionsKv,
+                               pathOutRegionsKv + BinaryKeyValueStorage::kExtension);
 }
 }  // namespace regions
 }  // namespace generator
@@ -24,12 +24,27 @@ namespace generator
 {
 namespace regions
 {
+namespace
+{
+// The tree does not report rects which only touch a query rect, so query rects are inflated.
+double const kRectEps = 1e-9;
+
+m2::RectD ToRect(BoostRect const & rect)
+{
+  return {rect.min_corner().get<0>(), rect.min_corner().get<1>(), rect.max_corner().get<0>(),
+          rect.max_corner().get<1>()};
+}
+}  // namespace
+
 RegionsBuilder::RegionsBuilder(Regions && regions, PlacePointsMap && placePointsMap,
                                size_t threadsCount)
   : m_threadsCount(threadsCount)
 {
   ASSERT(m_threadsCount != 0, ());
 
+  m_nodesThreadPool =
+      std::make_unique<base::thread_pool::computational::ThreadPool>(m_threadsCount);
+
   std::erase_if(placePointsMap, [](auto const & item) {
     return strings::IsASCIINumeric(item.second.GetName());
   });
@@ -41,6 +56,8 @@ RegionsBuilder::RegionsBuilder(Regions && regions, PlacePointsMap && placePoints
   m_placePointsMap = std::move(placePointsMap);
 }
 
+RegionsBuilder::~RegionsBuilder() = default;
+
 void RegionsBuilder::MoveLabelPlacePoints(PlacePointsMap & placePointsMap, Regions & regions)
 {
   for (auto & region : regions)
@@ -112,19 +129,55 @@ Node::Ptr RegionsBuilder::BuildCountryRegionTree(
     CountrySpecifier const & countrySpecifier) const
 {
   auto nodes = MakeCountryNodesInAreaOrder(outer, m_regionsInAreaOrder, isoCode, countrySpecifier);
+  auto const nodesTree = MakeNodesTree(nodes);
+  auto const parents = ChooseParents(nodes, nodesTree, countrySpecifier);
 
-  for (auto i = std::crbegin(nodes), end = std::crend(nodes); i != end; ++i)
+  for (size_t i = nodes.size(); i > 0; --i)
   {
-    if (auto parent = ChooseParent(nodes, i, countrySpecifier))
+    if (auto const & parent = parents[i - 1])
     {
-      (*i)->SetParent(parent);
-      parent->AddChild(*i);
+      nodes[i - 1]->SetParent(parent);
+      parent->AddChild(nodes[i - 1]);
     }
   }
 
   return nodes.front();
 }
 
+std::vector<Node::Ptr> RegionsBuilder::ChooseParents(
+    std::vector<Node::Ptr> const & nodesInAreaOrder, NodesTree const & nodesTree,
+    CountrySpecifier const & countrySpecifier) const
+{
+  // A parent depends on the geometry of larger nodes only, not on the tree, so parents of all
+  // the nodes are chosen independently.
+  std::vector<Node::Ptr> parents(nodesInAreaOrder.size());
+  auto const chooseParents = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+    {
+      auto const forItem = std::crbegin(nodesInAreaOrder) + (nodesInAreaOrder.size() - 1 - i);
+      parents[i] = ChooseParent(nodesInAreaOrder, forItem, nodesTree, countrySpecifier);
+    }
+  };
+
+  if (nodesInAreaOrder.size() <= kNodesInChunk)
+  {
+    chooseParents(0, nodesInAreaOrder.size());
+    return parents;
+  }
+
+  std::vector<std::future<void>> chunks;
+  for (size_t begin = 0; begin < nodesInAreaOrder.size(); begin += kNodesInChunk)
+  {
+    auto const end = std::min(begin + kNodesInChunk, nodesInAreaOrder.size());
+    chunks.emplace_back(m_nodesThreadPool->Submit(chooseParents, begin, end));
+  }
+
+  for (auto & chunk : chunks)
+    chunk.get();
+
+  return parents;
+}
+
 std::vector<Node::Ptr> RegionsBuilder::MakeCountryNodesInAreaOrder(
     Region const & countryOuter, Regions const & regionsInAreaOrder,
     boost::optional<std::string> const & isoCode,
@@ -150,8 +203,20 @@ std::vector<Node::Ptr> RegionsBuilder::MakeCountryNodesInAreaOrder(
   return nodes;
 }
 
+// static
+RegionsBuilder::NodesTree RegionsBuilder::MakeNodesTree(
+    std::vector<Node::Ptr> const & nodesInAreaOrder)
+{
+  NodesTree tree;
+  for (size_t i = 0; i < nodesInAreaOrder.size(); ++i)
+    tree.Add(i, ToRect(nodesInAreaOrder[i]->GetData().GetRect()));
+
+  return tree;
+}
+
 Node::Ptr RegionsBuilder::ChooseParent(std::vector<Node::Ptr> const & nodesInAreaOrder,
                                        std::vector<Node::Ptr>::const_reverse_iterator forItem,
+                                       NodesTree const & nodesTree,
                                        CountrySpecifier const & countrySpecifier) const
 {
   auto const & node = *forItem;
@@ -160,10 +225,31 @@ Node::Ptr RegionsBuilder::ChooseParent(std::vector<Node::Ptr> const & nodesInAre
   auto const from = FindAreaLowerBoundRely(nodesInAreaOrder, forItem);
   CHECK(from <= forItem, ());
 
+  auto const toIndex = [&nodesInAreaOrder](auto const & it) {
+    return static_cast<size_t>(std::crend(nodesInAreaOrder) - it) - 1;
+  };
+  auto const fromIndex = toIndex(from);
+  auto const forIndex = toIndex(forItem);
+
+  // A candidate which contains the rect or the center of the region has a rect touching
+  // the query rect. The tree returns such candidates only, they are visited in the order of
+  // increasing area, like the whole range [from, crend) was.
+  auto queryRect = ToRect(region.GetRect());
+  auto const center = region.GetCenter();
+  queryRect.Add({center.get<0>(), center.get<1>()});
+  queryRect.Inflate(kRectEps, kRectEps);
+
+  std::vector<size_t> candidates;
+  nodesTree.ForEachInRect(queryRect, [&](size_t index) {
+    if (index <= fromIndex && index != forIndex)
+      candidates.push_back(index);
+  });
+  std::sort(std::begin(candidates), std::end(candidates), std::greater<size_t>());
+
   Node::Ptr parent;
-  for (auto i = from, end = std::crend(nodesInAreaOrder); i != end; ++i)
+  for (auto const index : candidates)
   {
-    auto const & candidate = *i;
+    auto const & candidate = nodesInAreaOrder[index];
     auto const & candidateRegion = candidate->GetData();
 
     if (parent)
@@ -176,9 +262,6 @@ Node::Ptr RegionsBuilder::ChooseParent(std::vector<Node::Ptr> const & nodesInAre
     if (!candidateRegion.ContainsRect(region) && !candidateRegion.Contains(region.GetCenter()))
       continue;
 
-    if (i == forItem)
-      continue;
-
     auto const c = CompareAffiliation(candidateRegion, region, countrySpecifier);
     if (c == 1)
     {
@@ -288,16 +371,26 @@ bool RegionsBuilder::IsAreaLessRely(Region const & l, Region const & r)
 
 void RegionsBuilder::ForEachCountry(CountryFn fn)
 {
-  std::vector<std::future<Node::PtrList>> buildingTasks;
+  auto const countryNames = GetCountryInternationalNames();
+
+  // The largest countries take the most time, so they are started first to not be left alone
+  // at the end.
+  std::unordered_map<std::string, double> countryAreas;
+  for (auto const & country : GetCountriesOuters())
+    countryAreas[country.GetInternationalName()] += country.GetArea();
+
+  std::vector<size_t> buildingOrder(countryNames.size());
+  std::iota(std::begin(buildingOrder), std::end(buildingOrder), 0);
+  std::stable_sort(std::begin(buildingOrder), std::end(buildingOrder), [&](size_t l, size_t r) {
+    return countryAreas[countryNames[l]] > countryAreas[countryNames[r]];
+  });
 
+  std::vector<std::future<Node::PtrList>> buildingTasks(countryNames.size());
+  base::thread_pool::computational::ThreadPool threadPool(m_threadsCount);
+  for (auto const i : buildingOrder)
   {
-    base::thread_pool::computational::ThreadPool threadPool(m_threadsCount);
-
-    for (auto const & countryName : GetCountryInternationalNames())
-    {
-      auto result = threadPool.Submit([this, countryName]() { return BuildCountry(countryName); });
-      buildingTasks.emplace_back(std::move(result));
-    }
+    auto const & countryName = countryNames[i];
+    buildingTasks[i] = threadPool.Submit([this, countryName]() { return BuildCountry(countryName); });
   }
 
   for (auto && task : buildingTasks)
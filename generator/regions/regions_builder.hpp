@@ -5,6 +5,10 @@
 #include "generator/regions/node.hpp"
 #include "generator/regions/region.hpp"
 
+#include "geometry/tree4d.hpp"
+
+#include "base/thread_pool_computational.hpp"
+
 #include <functional>
 #include <map>
 #include <memory>
@@ -28,9 +32,12 @@ public:
 
   explicit RegionsBuilder(Regions && regions, PlacePointsMap && placePointsMap,
                           size_t threadsCount = 1);
+  ~RegionsBuilder();
 
   Regions const & GetCountriesOuters() const;
   StringsList GetCountryInternationalNames() const;
+  // Countries are built concurrently, the largest ones first. |fn| is called on the caller thread
+  // in the order of GetCountryInternationalNames() as soon as the next country is built.
   void ForEachCountry(CountryFn fn);
 
   static void InsertIntoSubtree(Node::Ptr & subtree, LevelRegion && region,
@@ -42,6 +49,11 @@ public:
 
 private:
   static constexpr double kAreaRelativeErrorPercent = 0.1;
+  // Parents of nodes of a country are chosen by chunks of this size on m_nodesThreadPool.
+  static constexpr size_t kNodesInChunk = 256;
+
+  // Indexes of nodes of a country by rects of their regions.
+  using NodesTree = m4::Tree<size_t>;
 
   void MoveLabelPlacePoints(PlacePointsMap & placePointsMap, Regions & regions);
   Regions FormRegionsInAreaOrder(Regions && regions);
@@ -58,8 +70,13 @@ private:
       Region const & countryOuter, Regions const & regionsInAreaOrder,
       boost::optional<std::string> const & isoCode,
       CountrySpecifier const & countrySpecifier) const;
+  static NodesTree MakeNodesTree(std::vector<Node::Ptr> const & nodesInAreaOrder);
+  std::vector<Node::Ptr> ChooseParents(std::vector<Node::Ptr> const & nodesInAreaOrder,
+                                       NodesTree const & nodesTree,
+                                       CountrySpecifier const & countrySpecifier) const;
   Node::Ptr ChooseParent(std::vector<Node::Ptr> const & nodesInAreaOrder,
                          std::vector<Node::Ptr>::const_reverse_iterator forItem,
+                         NodesTree const & nodesTree,
                          CountrySpecifier const & countrySpecifier) const;
   std::vector<Node::Ptr>::const_reverse_iterator FindAreaLowerBoundRely(
       std::vector<Node::Ptr> const & nodesInAreaOrder,
@@ -71,6 +88,9 @@ private:
   Regions m_regionsInAreaOrder;
   PlacePointsMap m_placePointsMap;
   size_t m_threadsCount;
+  // Country trees are built on their own threads which wait for the parents of the nodes, so
+  // the parents are chosen on a separate pool.
+  std::unique_ptr<base::thread_pool::computational::ThreadPool> m_nodesThreadPool;
 };
 }  // namespace regions
 }  // namespace generator
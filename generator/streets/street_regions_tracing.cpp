@@ -15,8 +15,11 @@ constexpr m2::Meter const StreetRegionsTracing::kRegionCheckStepDistance;
 constexpr m2::Meter const StreetRegionsTracing::kRegionBoundarySearchStepDistance;
 
 StreetRegionsTracing::StreetRegionsTracing(Path const & path,
-                                           StreetRegionInfoGetter const & streetRegionInfoGetter)
-  : m_path{path}, m_streetRegionInfoGetter{streetRegionInfoGetter}
+                                           StreetRegionInfoGetter const & streetRegionInfoGetter,
+                                           SameRegionChecker const & sameRegionChecker)
+  : m_path{path}
+  , m_streetRegionInfoGetter{streetRegionInfoGetter}
+  , m_sameRegionChecker{sameRegionChecker}
 {
   CHECK_GREATER_OR_EQUAL(m_path.size(), 2, ());
 
@@ -54,9 +57,13 @@ bool StreetRegionsTracing::TraceToNextCheckPointInCurrentRegion()
   auto checkPoint = FollowToNextPoint(m_currentPoint, kRegionCheckStepDistance, m_nextPathPoint,
                                       distanceToCheckPoint, newNextPathPoint);
 
-  auto checkPointRegion = m_streetRegionInfoGetter(checkPoint);
-  if (!IsSameRegion(checkPointRegion))
-    return false;
+  // Streets mostly lie far from region borders, so the region lookup is skipped there.
+  if (!IsSameRegionOnPathTo(checkPoint, newNextPathPoint))
+  {
+    auto checkPointRegion = m_streetRegionInfoGetter(checkPoint);
+    if (!IsSameRegion(checkPointRegion))
+      return false;
+  }
 
   AdvanceTo(checkPoint, distanceToCheckPoint, newNextPathPoint);
   return true;
@@ -189,5 +196,22 @@ bool StreetRegionsTracing::IsSameRegion(boost::optional<KeyValue> const & region
 
   return !m_currentRegion && !region;
 }
+
+bool StreetRegionsTracing::IsSameRegionOnPathTo(m2::PointD const & toPoint,
+                                                Path::const_iterator nextPathPoint) const
+{
+  if (!m_sameRegionChecker)
+    return false;
+
+  auto segmentBegin = m_currentPoint;
+  for (auto pathPoint = m_nextPathPoint; pathPoint != nextPathPoint; ++pathPoint)
+  {
+    if (!m_sameRegionChecker(segmentBegin, *pathPoint))
+      return false;
+    segmentBegin = *pathPoint;
+  }
+
+  return m_sameRegionChecker(segmentBegin, toPoint);
+}
 }  // namespace streets
 }  // namespace generator
@@ -19,6 +19,10 @@ class StreetRegionsTracing final
 public:
   using Meter = m2::Meter;
   using StreetRegionInfoGetter = std::function<boost::optional<KeyValue>(m2::PointD const & pathPoint)>;
+  // Returns true if the getter gives the same region for all points of the segment. False
+  // negatives only make the tracing check the region at the end of the segment.
+  using SameRegionChecker =
+      std::function<bool(m2::PointD const & segmentBegin, m2::PointD const & segmentEnd)>;
   using Path = std::vector<m2::PointD>;
 
   constexpr static auto const kRegionCheckStepDistance = 100.0_m;
@@ -33,7 +37,8 @@ public:
 
   using PathSegments = std::vector<Segment>;
 
-  StreetRegionsTracing(Path const & path, StreetRegionInfoGetter const & streetRegionInfoGetter);
+  StreetRegionsTracing(Path const & path, StreetRegionInfoGetter const & streetRegionInfoGetter,
+                       SameRegionChecker const & sameRegionChecker = {});
 
   PathSegments && StealPathSegments();
 
@@ -50,9 +55,11 @@ private:
   m2::PointD FollowToNextPoint(m2::PointD const & startPoint, Meter stepDistance,
       Path::const_iterator nextPathPoint, Meter & distance, Path::const_iterator & newNextPathPoint) const;
   bool IsSameRegion(boost::optional<KeyValue> const & region) const;
+  bool IsSameRegionOnPathTo(m2::PointD const & toPoint, Path::const_iterator nextPathPoint) const;
 
   Path const & m_path;
   StreetRegionInfoGetter const & m_streetRegionInfoGetter;
+  SameRegionChecker const & m_sameRegionChecker;
   m2::PointD m_currentPoint;
   Path::const_iterator m_nextPathPoint;
   boost::optional<KeyValue> m_currentRegion;
@@ -7,8 +7,6 @@
 #include "base/scope_guard.hpp"
 #include "base/timer.hpp"
 
-#include <fstream>
-
 namespace generator
 {
 namespace streets
@@ -36,8 +34,7 @@ void GenerateStreets(std::string const & pathInRegionsIndex, std::string const &
   streetsBuilder.AssembleBindings(pathInGeoObjectsTmpMwm);
   LOG(LINFO, ("Binding's streets were built."));
 
-  std::ofstream streamStreetsKv(pathOutStreetsKv);
-  streetsBuilder.SaveStreetsKv(streamStreetsKv);
+  streetsBuilder.SaveStreetsKv(pathOutStreetsKv);
   LOG(LINFO, ("Streets key-value storage saved to", pathOutStreetsKv));
 }
 }  // namespace streets
@@ -8,8 +8,12 @@
 
 #include "geometry/mercator.hpp"
 
+#include "base/cache.hpp"
 #include "base/logging.hpp"
+#include "base/thread_pool_computational.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <utility>
 
 #include "3party/jansson/myjansson.hpp"
@@ -20,9 +24,41 @@ namespace generator
 {
 namespace streets
 {
+namespace
+{
+size_t const kShardsPerThread = 8;
+
+// Region owners are cached per thread for cells of about 100 m.
+double const kRegionOwnersCellSize = 1e-3;
+uint32_t const kLogRegionOwnersCacheSize = 12;
+
+struct CachedRegionOwner
+{
+  uint64_t m_builderId = 0;
+  // The owner is cached only if it is the same for all points of the cell.
+  bool m_isSameInCell = false;
+  boost::optional<KeyValue> m_owner;
+};
+
+// Indexes fit into 20 bits.
+uint64_t GetRegionOwnersCellIndex(double offset)
+{
+  return static_cast<uint64_t>(offset / kRegionOwnersCellSize);
+}
+
+uint64_t NextBuilderId()
+{
+  static std::atomic<uint64_t> counter{0};
+  return ++counter;
+}
+}  // namespace
+
 StreetsBuilder::StreetsBuilder(regions::RegionInfoGetter const & regionInfoGetter,
                                size_t threadsCount)
-  : m_regionInfoGetter{regionInfoGetter}, m_threadsCount{threadsCount}
+  : m_shards(std::max<size_t>(threadsCount, 1) * kShardsPerThread)
+  , m_regionInfoGetter{regionInfoGetter}
+  , m_threadsCount{threadsCount}
+  , m_id{NextBuilderId()}
 {
 }
 
@@ -47,13 +83,24 @@ void StreetsBuilder::AssembleBindings(std::string const & pathInGeoObjectsTmpMwm
   ForEachParallelFromDatRawFormat(m_threadsCount, pathInGeoObjectsTmpMwm, transform);
 }
 
-void StreetsBuilder::SaveStreetsKv(std::ostream & streamStreetsKv)
+void StreetsBuilder::SaveStreetsKv(std::string const & pathOutStreetsKv)
 {
-  for (auto const & region : m_regions)
-    SaveRegionStreetsKv(streamStreetsKv, region.first, region.second);
+  KeyValueConcurrentWriter streetsKv{pathOutStreetsKv, FileWriter::OP_WRITE_TRUNCATE};
+  {
+    base::thread_pool::computational::ThreadPool threadPool{std::max<size_t>(m_threadsCount, 1)};
+    for (auto const & shard : m_shards)
+    {
+      threadPool.SubmitWork([this, &streetsKv, &shard]() {
+        for (auto const & region : shard.m_regions)
+          SaveRegionStreetsKv(streetsKv, region.first, region.second);
+      });
+    }
+    threadPool.WaitingStop();
+  }
+  streetsKv.Finish();
 }
 
-void StreetsBuilder::SaveRegionStreetsKv(std::ostream & streamStreetsKv, uint64_t regionId,
+void StreetsBuilder::SaveRegionStreetsKv(KeyValueConcurrentWriter & streetsKv, uint64_t regionId,
                                          RegionStreets const & streets)
 {
   auto const & regionsStorage = m_regionInfoGetter.GetStorage();
@@ -65,10 +112,9 @@ void StreetsBuilder::SaveRegionStreetsKv(std::ostream & streamStreetsKv, uint64_
     auto const & bbox = street.second.m_geometry.GetBbox();
     auto const & pin = street.second.m_geometry.GetOrChoosePin();
 
-    auto const id = KeyValueStorage::SerializeDref(pin.m_osmId.GetEncodedId());
     auto const & value =
         MakeStreetValue(regionId, *regionObject, street.second.m_name, bbox, pin.m_position);
-    streamStreetsKv << id << " " << KeyValueStorage::Serialize(value) << "\n";
+    streetsKv.Write(pin.m_osmId.GetEncodedId(), value);
   }
 }
 
@@ -89,16 +135,21 @@ void StreetsBuilder::AddStreetHighway(FeatureBuilder & fb)
   auto streetRegionInfoGetter = [this](auto const & pathPoint) {
     return this->FindStreetRegionOwner(pathPoint);
   };
-  StreetRegionsTracing regionsTracing(fb.GetOuterGeometry(), streetRegionInfoGetter);
-
-  std::lock_guard<std::mutex> lock{m_updateMutex};
+  auto sameRegionChecker = [this](auto const & segmentBegin, auto const & segmentEnd) {
+    return m_regionInfoGetter.IsSameRegionInRect(m2::RectD(segmentBegin, segmentEnd));
+  };
+  StreetRegionsTracing regionsTracing(fb.GetOuterGeometry(), streetRegionInfoGetter,
+                                      sameRegionChecker);
 
   auto && pathSegments = regionsTracing.StealPathSegments();
   for (auto & segment : pathSegments)
   {
     auto && region = segment.m_region;
-    auto & street = InsertStreet(region.first, fb.GetName(), fb.GetMultilangName());
     auto const osmId = pathSegments.size() == 1 ? fb.GetMostGenericOsmId() : NextOsmSurrogateId();
+
+    auto & shard = GetShard(region.first);
+    std::lock_guard<std::mutex> lock{shard.m_mutex};
+    auto & street = InsertStreet(region.first, fb.GetName(), fb.GetMultilangName());
     street.m_geometry.AddHighwayLine(osmId, std::move(segment.m_path));
   }
 }
@@ -109,7 +160,8 @@ void StreetsBuilder::AddStreetArea(FeatureBuilder & fb)
   if (!region)
     return;
 
-  std::lock_guard<std::mutex> lock{m_updateMutex};
+  auto & shard = GetShard(region->first);
+  std::lock_guard<std::mutex> lock{shard.m_mutex};
 
   auto & street = InsertStreet(region->first, fb.GetName(), fb.GetMultilangName());
   auto osmId = fb.GetMostGenericOsmId();
@@ -122,7 +174,8 @@ void StreetsBuilder::AddStreetPoint(FeatureBuilder & fb)
   if (!region)
     return;
 
-  std::lock_guard<std::mutex> lock{m_updateMutex};
+  auto & shard = GetShard(region->first);
+  std::lock_guard<std::mutex> lock{shard.m_mutex};
 
   auto osmId = fb.GetMostGenericOsmId();
   auto & street = InsertStreet(region->first, fb.GetName(), fb.GetMultilangName());
@@ -136,14 +189,49 @@ void StreetsBuilder::AddStreetBinding(std::string && streetName, FeatureBuilder
   if (!region)
     return;
 
-  std::lock_guard<std::mutex> lock{m_updateMutex};
+  auto const osmId = NextOsmSurrogateId();
+
+  auto & shard = GetShard(region->first);
+  std::lock_guard<std::mutex> lock{shard.m_mutex};
 
   auto & street = InsertStreet(region->first, std::move(streetName), multiLangName);
-  street.m_geometry.AddBinding(NextOsmSurrogateId(), fb.GetKeyPoint());
+  street.m_geometry.AddBinding(osmId, fb.GetKeyPoint());
 }
 
 boost::optional<KeyValue> StreetsBuilder::FindStreetRegionOwner(m2::PointD const & point,
                                                                 bool needLocality)
+{
+  thread_local base::Cache<uint64_t, CachedRegionOwner> cache(kLogRegionOwnersCacheSize);
+
+  auto const cellX =
+      GetRegionOwnersCellIndex(MercatorBounds::ClampX(point.x) - MercatorBounds::kMinX);
+  auto const cellY =
+      GetRegionOwnersCellIndex(MercatorBounds::ClampY(point.y) - MercatorBounds::kMinY);
+  auto const cellKey = ((cellX << 20 | cellY) << 1) | static_cast<uint64_t>(needLocality);
+
+  bool found = false;
+  auto & cached = cache.Find(cellKey, found);
+  if (found && cached.m_builderId == m_id)
+  {
+    if (cached.m_isSameInCell)
+      return cached.m_owner;
+
+    return FindStreetRegionOwnerAtPoint(point, needLocality);
+  }
+
+  m2::RectD const cell{MercatorBounds::kMinX + cellX * kRegionOwnersCellSize,
+                       MercatorBounds::kMinY + cellY * kRegionOwnersCellSize,
+                       MercatorBounds::kMinX + (cellX + 1) * kRegionOwnersCellSize,
+                       MercatorBounds::kMinY + (cellY + 1) * kRegionOwnersCellSize};
+  cached.m_builderId = m_id;
+  cached.m_isSameInCell = m_regionInfoGetter.IsSameRegionInRect(cell);
+  auto owner = FindStreetRegionOwnerAtPoint(point, needLocality);
+  cached.m_owner = cached.m_isSameInCell ? owner : boost::none;
+  return owner;
+}
+
+boost::optional<KeyValue> StreetsBuilder::FindStreetRegionOwnerAtPoint(m2::PointD const & point,
+                                                                       bool needLocality) const
 {
   auto const isStreetAdministrator = [needLocality](KeyValue const & region) {
     auto && address = base::GetJSONObligatoryFieldByPath(*region.second, "properties", "locales",
@@ -179,7 +267,7 @@ StringUtf8Multilang MergeNames(const StringUtf8Multilang & first,
 StreetsBuilder::Street & StreetsBuilder::InsertStreet(uint64_t regionId, std::string && streetName,
                                                       StringUtf8Multilang const & multilangName)
 {
-  auto & regionStreets = m_regions[regionId];
+  auto & regionStreets = GetShard(regionId).m_regions[regionId];
   StreetsBuilder::Street & street = regionStreets[std::move(streetName)];
   street.m_name = MergeNames(multilangName, street.m_name);
   return street;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "generator/feature_builder.hpp"
+#include "generator/key_value_concurrent_writer.hpp"
 #include "generator/key_value_storage.hpp"
 #include "generator/osm_element.hpp"
 #include "generator/regions/region_info_getter.hpp"
@@ -13,11 +14,12 @@
 #include "base/geo_object_id.hpp"
 
 #include <stdint.h>
+#include <atomic>
 #include <memory>
 #include <mutex>
-#include <ostream>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <boost/optional.hpp>
 
@@ -35,7 +37,7 @@ public:
   // Save built streets in the jsonl format with the members: "properties", "bbox" (array: left
   // bottom longitude, left bottom latitude, right top longitude, right top latitude), "pin" (array:
   // longitude, latitude).
-  void SaveStreetsKv(std::ostream & streamStreetsKv);
+  void SaveStreetsKv(std::string const & pathOutStreetsKv);
 
   static bool IsStreet(OsmElement const & element);
   static bool IsStreet(feature::FeatureBuilder const & fb);
@@ -48,7 +50,15 @@ private:
   };
   using RegionStreets = std::unordered_map<std::string, Street>;
 
-  void SaveRegionStreetsKv(std::ostream & streamStreetsKv, uint64_t regionId,
+  // Streets are sharded by region, so threads which add streets to different regions do not
+  // wait for each other.
+  struct RegionsShard
+  {
+    std::mutex m_mutex;
+    std::unordered_map<uint64_t, RegionStreets> m_regions;
+  };
+
+  void SaveRegionStreetsKv(KeyValueConcurrentWriter & streetsKv, uint64_t regionId,
                            RegionStreets const & streets);
 
   void AddStreet(feature::FeatureBuilder & fb);
@@ -59,6 +69,10 @@ private:
                         StringUtf8Multilang const & multiLangName);
   boost::optional<KeyValue> FindStreetRegionOwner(m2::PointD const & point,
                                                   bool needLocality = false);
+  boost::optional<KeyValue> FindStreetRegionOwnerAtPoint(m2::PointD const & point,
+                                                         bool needLocality) const;
+  RegionsShard & GetShard(uint64_t regionId) { return m_shards[regionId % m_shards.size()]; }
+  // Must be called under the lock of the region shard.
   Street & InsertStreet(uint64_t regionId, std::string && streetName,
                         StringUtf8Multilang const & multilangName);
   base::JSONPtr MakeStreetValue(uint64_t regionId, JsonValue const & regionObject,
@@ -66,11 +80,12 @@ private:
                                 m2::PointD const & pinPoint);
   base::GeoObjectId NextOsmSurrogateId();
 
-  std::unordered_map<uint64_t, RegionStreets> m_regions;
+  std::vector<RegionsShard> m_shards;
   regions::RegionInfoGetter const & m_regionInfoGetter;
-  uint64_t m_osmSurrogateCounter{0};
+  std::atomic<uint64_t> m_osmSurrogateCounter{0};
   size_t m_threadsCount;
-  std::mutex m_updateMutex;
+  // Distinguishes entries of the per-thread region owners cache of different builders.
+  uint64_t m_id;
 };
 }  // namespace streets
 }  // namespace generator
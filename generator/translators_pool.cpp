@@ -24,9 +24,18 @@ void TranslatorsPool::Emit(std::vector<OsmElement> && elements)
       translator->Emit(element);
 
     m_translators.Push(translator);
+    m_freeChunks.Push(std::move(elements));
   });
 }
 
+std::vector<OsmElement> TranslatorsPool::GetChunk(size_t size)
+{
+  std::vector<OsmElement> elements;
+  m_freeChunks.TryPop(elements);
+  elements.resize(size);
+  return elements;
+}
+
 bool TranslatorsPool::Finish()
 {
   m_threadPool.WaitingStop();
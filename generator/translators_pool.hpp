@@ -7,6 +7,7 @@
 #include "base/thread_pool_computational.hpp"
 #include "base/thread_safe_queue.hpp"
 
+#include <cstddef>
 #include <memory>
 #include <vector>
 
@@ -21,8 +22,15 @@ public:
   void Emit(std::vector<OsmElement> && elements);
   bool Finish();
 
+  // Returns true when some translators wait for elements.
+  bool HasFreeTranslators() const { return !m_translators.Empty(); }
+  // Returns a chunk of |size| elements to be filled and emitted. Emitted chunks are reused
+  // after they are translated, so their elements keep the memory they allocated.
+  std::vector<OsmElement> GetChunk(size_t size);
+
 private:
   base::thread_pool::computational::ThreadPool m_threadPool;
   base::threads::ThreadSafeQueue<std::shared_ptr<TranslatorInterface>> m_translators;
+  base::threads::ThreadSafeQueue<std::vector<OsmElement>> m_freeChunks;
 };
 }  // namespace generator
@@ -6,6 +6,11 @@
 
 #include "indexer/search_string_utils.hpp"
 
+#include "coding/endianness.hpp"
+#include "coding/reader.hpp"
+#include "coding/succinct_mapper.hpp"
+#include "coding/write_to_sink.hpp"
+
 #include "base/assert.hpp"
 #include "base/exception.hpp"
 #include "base/logging.hpp"
@@ -15,14 +20,13 @@
 #include "base/timer.hpp"
 
 #include <algorithm>
-#include <fstream>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <numeric>
-#include <set>
 #include <thread>
 #include <utility>
 
-#include <boost/archive/binary_iarchive.hpp>
-#include <boost/archive/binary_oarchive.hpp>
 #include <boost/exception/exception.hpp>
 #include <boost/exception/diagnostic_information.hpp>
 #include <boost/iostreams/device/file.hpp>
@@ -30,13 +34,20 @@
 #include <boost/iostreams/filtering_streambuf.hpp>
 #include <boost/optional.hpp>
 
+#include "defines.hpp"
+
 using namespace std;
 
 namespace geocoder
 {
 namespace
 {
-size_t const kMaxResults = 100;
+// Number of queries per thread which may be processed ahead of the first unwritten one
+// by Geocoder::ProcessQueries() with a stream of queries.
+size_t const kQueriesInProcessingPerThread = 64;
+
+// Share of the weight of a token which is lost when the token is matched with misprints.
+double const kMisprintPenalty = 0.5;
 
 // While Result's |m_certainty| is deliberately vaguely defined,
 // current implementation is a log-prob type measure of our belief
@@ -122,6 +133,42 @@ Type NextType(Type type)
   return static_cast<Type>(t + 1);
 }
 
+uint32_t ToMask(Type type) { return uint32_t{1} << static_cast<size_t>(type); }
+
+// Returns an upper bound of the certainty of the results that can be found
+// by matching the unused tokens of |ctx| to |type| and the types after it.
+double GetCertaintyUpperBound(Geocoder::Context const & ctx, Type type)
+{
+  double certainty = 0;
+  for (size_t tokId = 0; tokId < ctx.GetNumTokens(); ++tokId)
+    certainty += GetWeight(ctx.GetTokenType(tokId));
+
+  double maxWeight = 0;
+  for (auto t = type; t != Type::Count; t = NextType(t))
+    maxWeight = max(maxWeight, GetWeight(t));
+  certainty += maxWeight * static_cast<double>(ctx.GetNumTokens() - ctx.GetNumUsedTokens());
+
+  // See the bonus of localities in Geocoder::AddResults().
+  if (type <= Type::Locality)
+    certainty += GetWeight(Type::Region) + GetWeight(Type::Subregion);
+
+  // Certainties of results are summed up in another order.
+  double const kRoundingEps = 1e-9;
+  return certainty + kRoundingEps;
+}
+
+// Returns false when no result found by Go(ctx, type) can change the results of the query,
+// so the branch can be skipped.
+bool CanImproveResults(Geocoder::Context const & ctx, Type type)
+{
+  // House number positions filter the results (see Geocoder::Context::FillResults()),
+  // so the branches that may mark them are never skipped.
+  if (ctx.MayMarkHouseNumberPositions())
+    return true;
+
+  return ctx.IsCertaintyAcceptable(GetCertaintyUpperBound(ctx, type));
+}
+
 strings::UniString MakeHouseNumber(Tokens const & tokens)
 {
   return strings::MakeUniString(strings::JoinStrings(tokens, " "));
@@ -129,11 +176,50 @@ strings::UniString MakeHouseNumber(Tokens const & tokens)
 }  // namespace
 
 // Geocoder::Context -------------------------------------------------------------------------------
-Geocoder::Context::Context(string const & query) : m_beam(kMaxResults)
+Geocoder::Context::Context(string const & query, size_t maxResults) : m_beam(maxResults)
+{
+  Reset(query, maxResults);
+}
+
+void Geocoder::Context::Clear()
 {
+  m_tokens.clear();
+  m_tokenTypes.clear();
+  m_numUsedTokens = 0;
+  m_houseNumberPositionsInQuery.clear();
+  m_beam.Clear();
+  while (!m_layers.empty())
+    PopLayer();
+}
+
+void Geocoder::Context::Reset(string const & query, size_t maxResults)
+{
+  Clear();
+  m_beam.Reset(maxResults);
   search::NormalizeAndTokenizeAsUtf8(query, m_tokens);
   m_tokenTypes.assign(m_tokens.size(), Type::Count);
-  m_numUsedTokens = 0;
+
+  auto const rangesCount = m_tokens.size() * m_tokens.size();
+  if (m_keysWithMisprints.size() < rangesCount)
+    m_keysWithMisprints.resize(rangesCount);
+  for (size_t i = 0; i < rangesCount; ++i)
+    m_keysWithMisprints[i].clear();
+  m_hasKeysWithMisprints.assign(rangesCount, false);
+
+  m_houseNumberRanges.clear();
+  strings::UniString houseNumber;
+  for (size_t l = 0; l < m_tokens.size(); ++l)
+  {
+    houseNumber.clear();
+    for (size_t r = l; r < m_tokens.size(); ++r)
+    {
+      if (r != l)
+        houseNumber.push_back(' ');
+      houseNumber.append(strings::MakeUniString(m_tokens[r]));
+      if (search::house_numbers::LooksLikeHouseNumber(houseNumber, false /* isPrefix */))
+        m_houseNumberRanges.emplace_back(l, r + 1);
+    }
+  }
 }
 
 vector<Type> & Geocoder::Context::GetTokenTypes() { return m_tokenTypes; }
@@ -180,22 +266,29 @@ bool Geocoder::Context::IsTokenUsed(size_t id) const
 bool Geocoder::Context::AllTokensUsed() const { return m_numUsedTokens == m_tokens.size(); }
 
 void Geocoder::Context::AddResult(base::GeoObjectId const & osmId, double certainty, Type type,
-                                  vector<size_t> const & tokenIds, vector<Type> const & allTypes)
+                                  TokenIds const & tokenIds, uint32_t allTypes)
 {
   m_beam.Add(BeamKey(osmId, type, tokenIds, allTypes), certainty);
 }
 
+bool Geocoder::Context::IsCertaintyAcceptable(double certainty) const
+{
+  return m_beam.IsAcceptable(certainty);
+}
+
 void Geocoder::Context::FillResults(vector<Result> & results) const
 {
   results.clear();
   results.reserve(m_beam.GetEntries().size());
 
-  set<base::GeoObjectId> seen;
+  buffer_vector<uint64_t, kMaxResults> seen;
   bool const hasPotentialHouseNumber = !m_houseNumberPositionsInQuery.empty();
   for (auto const & e : m_beam.GetEntries())
   {
-    if (!seen.insert(e.m_key.m_osmId).second)
+    auto const encodedId = e.m_key.m_osmId.GetEncodedId();
+    if (find(seen.begin(), seen.end(), encodedId) != seen.end())
       continue;
+    seen.push_back(encodedId);
 
     if (hasPotentialHouseNumber && !IsGoodForPotentialHouseNumberAt(e.m_key, m_houseNumberPositionsInQuery))
       continue;
@@ -215,20 +308,81 @@ void Geocoder::Context::FillResults(vector<Result> & results) const
   }
 
   ASSERT(is_sorted(results.rbegin(), results.rend(), base::LessBy(&Result::m_certainty)), ());
-  ASSERT_LESS_OR_EQUAL(results.size(), kMaxResults, ());
+  ASSERT_LESS_OR_EQUAL(results.size(), m_beam.GetCapacity(), ());
 }
 
 vector<Geocoder::Layer> & Geocoder::Context::GetLayers() { return m_layers; }
 
 vector<Geocoder::Layer> const & Geocoder::Context::GetLayers() const { return m_layers; }
 
-void Geocoder::Context::MarkHouseNumberPositionsInQuery(vector<size_t> const & tokenIds)
+Geocoder::Layer Geocoder::Context::MakeLayer(Type type)
+{
+  Layer layer;
+  layer.m_type = type;
+  if (!m_freeEntries.empty())
+  {
+    layer.m_entries.swap(m_freeEntries.back());
+    m_freeEntries.pop_back();
+  }
+  return layer;
+}
+
+void Geocoder::Context::ReleaseLayer(Layer && layer)
+{
+  layer.m_entries.clear();
+  m_freeEntries.emplace_back(move(layer.m_entries));
+}
+
+void Geocoder::Context::PopLayer()
+{
+  CHECK(!m_layers.empty(), ());
+  ReleaseLayer(move(m_layers.back()));
+  m_layers.pop_back();
+}
+
+Geocoder::Context::Subquery & Geocoder::Context::GetSubquery(Type type)
+{
+  CHECK_LESS(type, Type::Count, ());
+  return m_subqueries[static_cast<size_t>(type)];
+}
+
+void Geocoder::Context::MarkHouseNumberPositionsInQuery(TokenIds const & tokenIds)
+{
+  auto & positions = m_houseNumberPositionsInQuery;
+  for (auto const id : tokenIds)
+  {
+    auto const it = lower_bound(positions.begin(), positions.end(), id);
+    if (it == positions.end() || *it != id)
+      positions.insert(it, id);
+  }
+}
+
+bool Geocoder::Context::LooksLikeHouseNumber(size_t l, size_t r) const
+{
+  return binary_search(m_houseNumberRanges.begin(), m_houseNumberRanges.end(), make_pair(l, r));
+}
+
+bool Geocoder::Context::MayMarkHouseNumberPositions() const
 {
-  m_houseNumberPositionsInQuery.insert(tokenIds.begin(), tokenIds.end());
+  auto const & positions = m_houseNumberPositionsInQuery;
+  for (auto const & range : m_houseNumberRanges)
+  {
+    bool unused = true;
+    bool marked = true;
+    for (size_t i = range.first; i < range.second && unused; ++i)
+    {
+      unused = !IsTokenUsed(i);
+      marked = marked && binary_search(positions.begin(), positions.end(), i);
+    }
+
+    if (unused && !marked)
+      return true;
+  }
+  return false;
 }
 
 bool Geocoder::Context::IsGoodForPotentialHouseNumberAt(BeamKey const & beamKey,
-                                                        set<size_t> const & tokenIds) const
+                                                        TokenIds const & tokenIds) const
 {
   if (beamKey.m_tokenIds.size() == m_tokens.size())
     return true;
@@ -248,33 +402,19 @@ bool Geocoder::Context::IsBuildingWithAddress(BeamKey const & beamKey) const
   if (beamKey.m_type != Type::Building)
     return false;
 
-  bool gotLocality = false;
-  bool gotStreet = false;
-  bool gotBuilding = false;
-  for (Type t : beamKey.m_allTypes)
-  {
-    if (t == Type::Region || t == Type::Subregion || t == Type::Locality)
-      gotLocality = true;
-    if (t == Type::Street)
-      gotStreet = true;
-    if (t == Type::Building)
-      gotBuilding = true;
-  }
-  return gotLocality && gotStreet && gotBuilding;
+  bool const gotStreet = (beamKey.m_allTypes & ToMask(Type::Street)) != 0;
+  bool const gotBuilding = (beamKey.m_allTypes & ToMask(Type::Building)) != 0;
+  return HasLocalityOrRegion(beamKey) && gotStreet && gotBuilding;
 }
 
 bool Geocoder::Context::HasLocalityOrRegion(BeamKey const & beamKey) const
 {
-  for (Type t : beamKey.m_allTypes)
-  {
-    if (t == Type::Region || t == Type::Subregion || t == Type::Locality)
-      return true;
-  }
-
-  return false;
+  auto const localityOrRegion =
+      ToMask(Type::Region) | ToMask(Type::Subregion) | ToMask(Type::Locality);
+  return (beamKey.m_allTypes & localityOrRegion) != 0;
 }
 
-bool Geocoder::Context::ContainsTokenIds(BeamKey const & beamKey, set<size_t> const & needTokenIds) const
+bool Geocoder::Context::ContainsTokenIds(BeamKey const & beamKey, TokenIds const & needTokenIds) const
 {
   auto const & keyTokenIds = beamKey.m_tokenIds;
   return base::Includes(keyTokenIds.begin(), keyTokenIds.end(), needTokenIds.begin(), needTokenIds.end());
@@ -284,20 +424,29 @@ bool Geocoder::Context::ContainsTokenIds(BeamKey const & beamKey, set<size_t> co
 void Geocoder::LoadFromJsonl(std::string const & pathToJsonHierarchy, unsigned int loadThreadsCount)
 try
 {
-  using namespace boost::iostreams;
-  filtering_istreambuf fileStreamBuf;
-
   if (strings::EndsWith(pathToJsonHierarchy, ".gz"))
+  {
+    using namespace boost::iostreams;
+    filtering_istreambuf fileStreamBuf;
     fileStreamBuf.push(gzip_decompressor());
 
-  file_source file(pathToJsonHierarchy);
-  if (!file.is_open())
-    MYTHROW(OpenException, ("Failed to open file", pathToJsonHierarchy));
-  fileStreamBuf.push(file);
+    file_source file(pathToJsonHierarchy);
+    if (!file.is_open())
+      MYTHROW(OpenException, ("Failed to open file", pathToJsonHierarchy));
+    fileStreamBuf.push(file);
 
-  std::istream fileStream(&fileStreamBuf);
-  m_hierarchy = HierarchyReader{fileStream}.Read(loadThreadsCount);
+    std::istream fileStream(&fileStreamBuf);
+    m_hierarchy = HierarchyReader{fileStream}.Read(loadThreadsCount);
+  }
+  else
+  {
+    m_hierarchy = HierarchyReader{pathToJsonHierarchy}.Read(loadThreadsCount);
+  }
   m_index.BuildIndex(loadThreadsCount);
+
+  m_indexRegion.reset();
+  m_hierarchyRegion.reset();
+  m_indexContainer.reset();
 }
 catch (boost::exception const & err)
 {
@@ -311,13 +460,31 @@ catch (std::exception const & err)
 void Geocoder::LoadFromBinaryIndex(std::string const & pathToTokenIndex)
 try
 {
-  std::ifstream ifs{pathToTokenIndex};
-  if (!ifs)
-    MYTHROW(OpenException, ("Failed to open file", pathToTokenIndex));
-  ifs.exceptions(std::ifstream::badbit | std::ifstream::failbit);
+  auto container = make_unique<FilesMappingContainer>(pathToTokenIndex);
+
+  ReaderSource<FileReader> headerSource(container->GetReader(GEOCODER_HEADER_FILE_TAG));
+  auto const version = ReadPrimitiveFromSource<uint32_t>(headerSource);
+  if (version != kIndexFormatVersion)
+    MYTHROW(Exception, ("Unsupported geocoder index version", version, "in", pathToTokenIndex));
+  auto const isDataBigEndian = ReadPrimitiveFromSource<uint8_t>(headerSource) != 0;
+  if (isDataBigEndian != IsBigEndianMacroBased())
+    MYTHROW(Exception, ("Endianness mismatch of geocoder index", pathToTokenIndex));
 
-  boost::archive::binary_iarchive ia{ifs};
-  ia >> *this;
+  auto hierarchyRegion =
+      make_unique<MappedMemoryRegion>(container->Map(GEOCODER_HIERARCHY_FILE_TAG));
+  auto indexRegion = make_unique<MappedMemoryRegion>(container->Map(GEOCODER_INDEX_FILE_TAG));
+
+  Hierarchy hierarchy;
+  coding::Map(hierarchy, hierarchyRegion->ImmutableData(), "hierarchy");
+  m_hierarchy = move(hierarchy);
+  coding::Map(m_index, indexRegion->ImmutableData(), "index");
+
+  m_indexContainer = move(container);
+  m_hierarchyRegion = move(hierarchyRegion);
+  m_indexRegion = move(indexRegion);
+
+  LOG(LINFO, ("Mapped geocoder index", pathToTokenIndex, "with",
+              m_hierarchy.GetEntriesCount(), "entries"));
 }
 catch (boost::exception const & err)
 {
@@ -328,16 +495,28 @@ catch (std::exception const & err)
   MYTHROW(Exception, ("Failed to load geocoder index:", err.what()));
 }
 
-void Geocoder::SaveToBinaryIndex(std::string const & pathToTokenIndex) const
+void Geocoder::SaveToBinaryIndex(std::string const & pathToTokenIndex)
 try
 {
-  std::ofstream ofs{pathToTokenIndex};
-  if (!ofs)
-    MYTHROW(OpenException, ("Failed to open file", pathToTokenIndex));
-  ofs.exceptions(std::ifstream::badbit | std::ifstream::failbit);
+  FilesContainerW container(pathToTokenIndex);
+
+  {
+    auto writer = container.GetWriter(GEOCODER_HEADER_FILE_TAG);
+    WriteToSink(*writer, static_cast<uint32_t>(kIndexFormatVersion));
+    WriteToSink(*writer, static_cast<uint8_t>(IsBigEndianMacroBased()));
+  }
+
+  {
+    auto writer = container.GetWriter(GEOCODER_HIERARCHY_FILE_TAG);
+    coding::Freeze(m_hierarchy, *writer, "hierarchy");
+  }
 
-  boost::archive::binary_oarchive oa{ofs};
-  oa << *this;
+  {
+    auto writer = container.GetWriter(GEOCODER_INDEX_FILE_TAG);
+    coding::Freeze(m_index, *writer, "index");
+  }
+
+  container.Finish();
 }
 catch (boost::exception const & err)
 {
@@ -348,7 +527,8 @@ catch (std::exception const & err)
   MYTHROW(Exception, ("Failed to save geocoder index:", err.what()));
 }
 
-void Geocoder::ProcessQuery(string const & query, vector<Result> & results) const
+void Geocoder::ProcessQuery(string const & query, vector<Result> & results,
+                            size_t maxResults) const
 {
 #if defined(DEBUG)
   base::Timer timer;
@@ -357,11 +537,138 @@ void Geocoder::ProcessQuery(string const & query, vector<Result> & results) cons
   });
 #endif
 
-  Context ctx(query);
+  Context ctx;
+  ProcessQuery(query, results, ctx, maxResults);
+}
+
+void Geocoder::ProcessQuery(string const & query, vector<Result> & results, Context & ctx,
+                            size_t maxResults) const
+{
+  ctx.Reset(query, maxResults);
   Go(ctx, Type::Country);
   ctx.FillResults(results);
 }
 
+void Geocoder::ProcessQueries(vector<string> const & queries, vector<vector<Result>> & results,
+                              unsigned int threadsCount, size_t maxResults) const
+{
+  vector<double> durations;
+  ProcessQueries(queries, results, durations, threadsCount, maxResults);
+}
+
+void Geocoder::ProcessQueries(vector<string> const & queries, vector<vector<Result>> & results,
+                              vector<double> & durations, unsigned int threadsCount,
+                              size_t maxResults) const
+{
+  CHECK_GREATER(threadsCount, 0, ());
+
+  results.resize(queries.size());
+  durations.resize(queries.size());
+
+  atomic<size_t> nextQuery{0};
+  auto const processQueries = [&]() {
+    Context ctx;
+    base::Timer timer;
+    for (auto i = nextQuery++; i < queries.size(); i = nextQuery++)
+    {
+      timer.Reset();
+      ProcessQuery(queries[i], results[i], ctx, maxResults);
+      durations[i] = timer.ElapsedSeconds();
+    }
+  };
+
+  vector<thread> threads;
+  threads.reserve(threadsCount - 1);
+  for (unsigned int t = 1; t < threadsCount; ++t)
+    threads.emplace_back(processQueries);
+  processQueries();
+
+  for (auto & t : threads)
+    t.join();
+}
+
+void Geocoder::ProcessQueries(QueryReader const & readQuery, ResultWriter const & writeResult,
+                              unsigned int threadsCount, size_t maxResults) const
+{
+  CHECK_GREATER(threadsCount, 0, ());
+
+  // The query |i| is kept in the slot |i % slots.size()| until its results are written.
+  struct Slot
+  {
+    string m_query;
+    vector<Result> m_results;
+    double m_duration = 0.0;
+    bool m_isReady = false;
+  };
+  vector<Slot> slots(kQueriesInProcessingPerThread * threadsCount);
+
+  mutex inputMutex;
+  size_t nextQuery = 0;
+  bool isInputEnd = false;
+
+  mutex outputMutex;
+  condition_variable outputCondition;
+  size_t nextResult = 0;
+
+  auto const processQueries = [&]() {
+    Context ctx;
+    string query;
+    vector<Result> results;
+    base::Timer timer;
+    while (true)
+    {
+      size_t i = 0;
+      {
+        lock_guard<mutex> lock(inputMutex);
+        if (isInputEnd || !readQuery(query))
+        {
+          isInputEnd = true;
+          return;
+        }
+        i = nextQuery++;
+      }
+
+      {
+        // The thread which has the first unwritten query never waits here.
+        unique_lock<mutex> lock(outputMutex);
+        outputCondition.wait(lock, [&] { return i < nextResult + slots.size(); });
+      }
+
+      timer.Reset();
+      ProcessQuery(query, results, ctx, maxResults);
+      auto const duration = timer.ElapsedSeconds();
+
+      lock_guard<mutex> lock(outputMutex);
+      auto & slot = slots[i % slots.size()];
+      slot.m_query.swap(query);
+      slot.m_results.swap(results);
+      slot.m_duration = duration;
+      slot.m_isReady = true;
+
+      auto const prevNextResult = nextResult;
+      while (slots[nextResult % slots.size()].m_isReady)
+      {
+        auto & next = slots[nextResult % slots.size()];
+        writeResult(next.m_query, next.m_results, next.m_duration);
+        next.m_isReady = false;
+        ++nextResult;
+      }
+
+      if (nextResult != prevNextResult)
+        outputCondition.notify_all();
+    }
+  };
+
+  vector<thread> threads;
+  threads.reserve(threadsCount - 1);
+  for (unsigned int t = 1; t < threadsCount; ++t)
+    threads.emplace_back(processQueries);
+  processQueries();
+
+  for (auto & t : threads)
+    t.join();
+}
+
 Hierarchy const & Geocoder::GetHierarchy() const { return m_hierarchy; }
 
 Index const & Geocoder::GetIndex() const { return m_index; }
@@ -377,8 +684,14 @@ void Geocoder::Go(Context & ctx, Type type) const
   if (type == Type::Count)
     return;
 
-  Tokens subquery;
-  vector<size_t> subqueryTokenIds;
+  if (!CanImproveResults(ctx, type))
+    return;
+
+  // Go() is called recursively for the next types only, so the scratch buffers
+  // of |type| are not used by the nested calls.
+  auto & scratch = ctx.GetSubquery(type);
+  auto & subquery = scratch.m_tokens;
+  auto & subqueryTokenIds = scratch.m_tokenIds;
   for (size_t i = 0; i < ctx.GetNumTokens(); ++i)
   {
     subquery.clear();
@@ -388,11 +701,14 @@ void Geocoder::Go(Context & ctx, Type type) const
       if (ctx.IsTokenUsed(j))
         break;
 
+      // The results of the previous subqueries may have raised the bar.
+      if (!CanImproveResults(ctx, type))
+        return;
+
       subquery.push_back(ctx.GetToken(j));
       subqueryTokenIds.push_back(j);
 
-      Layer curLayer;
-      curLayer.m_type = type;
+      auto curLayer = ctx.MakeLayer(type);
 
       // Buildings are indexed separately.
       if (type == Type::Building)
@@ -401,11 +717,14 @@ void Geocoder::Go(Context & ctx, Type type) const
       }
       else
       {
-        FillRegularLayer(ctx, type, subquery, curLayer);
+        FillRegularLayer(ctx, type, subquery, subqueryTokenIds, curLayer);
       }
 
       if (curLayer.m_entries.empty())
+      {
+        ctx.ReleaseLayer(move(curLayer));
         continue;
+      }
 
       ScopedMarkTokens mark(ctx, type, i, j + 1);
 
@@ -413,10 +732,10 @@ void Geocoder::Go(Context & ctx, Type type) const
       if (type == Type::Street)
         MarkStreetSynonym(ctx, streetSynonymMark);
 
-      AddResults(ctx, curLayer.m_entries);
+      AddResults(ctx, curLayer);
 
       ctx.GetLayers().emplace_back(move(curLayer));
-      SCOPE_GUARD(pop, [&] { ctx.GetLayers().pop_back(); });
+      SCOPE_GUARD(pop, [&] { ctx.PopLayer(); });
 
       Go(ctx, NextType(type));
     }
@@ -425,17 +744,17 @@ void Geocoder::Go(Context & ctx, Type type) const
   Go(ctx, NextType(type));
 }
 
-void Geocoder::FillBuildingsLayer(Context & ctx, Tokens const & subquery, vector<size_t> const & subqueryTokenIds,
+void Geocoder::FillBuildingsLayer(Context & ctx, Tokens const & subquery, TokenIds const & subqueryTokenIds,
                                   Layer & curLayer) const
 {
   if (ctx.GetLayers().empty())
     return;
 
-  auto const & subqueryHN = MakeHouseNumber(subquery);
-
-  if (!search::house_numbers::LooksLikeHouseNumber(subqueryHN, false /* isPrefix */))
+  if (!ctx.LooksLikeHouseNumber(subqueryTokenIds.front(), subqueryTokenIds.back() + 1))
     return;
 
+  auto const & subqueryHN = MakeHouseNumber(subquery);
+
   for_each(ctx.GetLayers().rbegin(), ctx.GetLayers().rend(), [&, this] (auto const & layer) {
     if (layer.m_type != Type::Street && layer.m_type != Type::Locality)
       return;
@@ -448,11 +767,9 @@ void Geocoder::FillBuildingsLayer(Context & ctx, Tokens const & subquery, vector
     for (auto const & docId : layer.m_entries)
     {
       m_index.ForEachRelatedBuilding(docId, [&](Index::DocId const & buildingDocId) {
-        auto const & bld = m_index.GetDoc(buildingDocId);
-        auto const & multipleHN = bld.GetNormalizedMultipleNames(
-            Type::Building, m_hierarchy.GetNormalizedNameDictionary());
-        auto const & realHN = multipleHN.GetMainName();
-        auto const & realHNUniStr = strings::MakeUniString(realHN);
+        auto const realHN =
+            m_hierarchy.GetNormalizedMultipleNames(buildingDocId, Type::Building).GetMainName();
+        auto const & realHNUniStr = strings::MakeUniString(realHN.to_string());
         if (search::house_numbers::HouseNumbersMatch(realHNUniStr, subqueryHN,
                                                      false /* queryIsPrefix */))
         {
@@ -463,29 +780,54 @@ void Geocoder::FillBuildingsLayer(Context & ctx, Tokens const & subquery, vector
   });
 }
 
-void Geocoder::FillRegularLayer(Context const & ctx, Type type, Tokens const & subquery,
-                                Layer & curLayer) const
+void Geocoder::FillRegularLayer(Context & ctx, Type type, Tokens const & subquery,
+                                TokenIds const & subqueryTokenIds, Layer & curLayer) const
 {
-  m_index.ForEachDocId(subquery, [&](Index::DocId const & docId) {
-    auto const & d = m_index.GetDoc(docId);
-    if (d.m_type != type)
+  bool found = false;
+  auto const addDoc = [&](Index::DocId const & docId) {
+    if (m_hierarchy.GetType(docId) != type)
       return;
 
-    if (ctx.GetLayers().empty() || HasParent(ctx.GetLayers(), d))
+    found = true;
+    if (ctx.GetLayers().empty() || HasParent(ctx.GetLayers(), docId))
     {
-      if (type > Type::Locality && !IsRelevantLocalityMember(ctx, d, subquery))
+      if (type > Type::Locality && !IsRelevantLocalityMember(ctx, docId, subquery))
         return;
 
       curLayer.m_entries.emplace_back(docId);
     }
+  };
+
+  m_index.ForEachDocId(subquery, addDoc);
+  if (found)
+    return;
+
+  auto const l = subqueryTokenIds.front();
+  auto const r = subqueryTokenIds.back() + 1;
+  // Prefix matching is only meaningful for a single token: the index keys
+  // consist of sorted tokens, so an unfinished token is not the last one in general.
+  bool const isPrefix = r == ctx.GetNumTokens() && subquery.size() == 1 &&
+                        strings::MakeUniString(subquery.front()).size() >=
+                            Index::kMinMisprintPrefixSize;
+  auto const & keyIds = ctx.GetKeysWithMisprints(l, r, [&](vector<size_t> & keyIds) {
+    m_index.ForEachKeyWithMisprints(subquery, isPrefix,
+                                    [&](size_t keyId) { keyIds.push_back(keyId); });
   });
+
+  for (auto const keyId : keyIds)
+    m_index.ForEachDocIdOfKey(keyId, addDoc);
+
+  // A doc may be found by several keys, e.g. by names in different languages.
+  base::SortUnique(curLayer.m_entries);
+  curLayer.m_withMisprints = true;
+  curLayer.m_tokensCount = subquery.size();
 }
 
-void Geocoder::AddResults(Context & ctx, std::vector<Index::DocId> const & entries) const
+void Geocoder::AddResults(Context & ctx, Layer const & curLayer) const
 {
   double certainty = 0;
-  vector<size_t> tokenIds;
-  vector<Type> allTypes;
+  TokenIds tokenIds;
+  uint32_t allTypes = 0;
   for (size_t tokId = 0; tokId < ctx.GetNumTokens(); ++tokId)
   {
     auto const t = ctx.GetTokenType(tokId);
@@ -493,53 +835,62 @@ void Geocoder::AddResults(Context & ctx, std::vector<Index::DocId> const & entri
     if (t != Type::Count)
     {
       tokenIds.push_back(tokId);
-      allTypes.push_back(t);
+      allTypes |= ToMask(t);
     }
   }
 
-  for (auto const & docId : entries)
+  // Tokens matched with misprints weigh less, so the exact matches win.
+  auto const penalize = [&certainty](Layer const & layer) {
+    if (layer.m_withMisprints)
+      certainty -= kMisprintPenalty * GetWeight(layer.m_type) * layer.m_tokensCount;
+  };
+  for (auto const & layer : ctx.GetLayers())
+    penalize(layer);
+  penalize(curLayer);
+
+  for (auto const & docId : curLayer.m_entries)
   {
-    auto const & entry = m_index.GetDoc(docId);
+    auto const type = m_hierarchy.GetType(docId);
 
     auto entryCertainty = certainty;
-    if (entry.m_type == Type::Locality)
+    if (type == Type::Locality)
     {
-      auto const localityName = entry.m_normalizedAddress[static_cast<size_t>(Type::Locality)];
+      auto const localityName = m_hierarchy.GetNormalizedAddress(docId, Type::Locality);
 
-      if (entry.m_normalizedAddress[static_cast<size_t>(Type::Region)] == localityName)
+      if (m_hierarchy.GetNormalizedAddress(docId, Type::Region) == localityName)
         entryCertainty += GetWeight(Type::Region);
 
-      if (entry.m_normalizedAddress[static_cast<size_t>(Type::Subregion)] == localityName)
+      if (m_hierarchy.GetNormalizedAddress(docId, Type::Subregion) == localityName)
         entryCertainty += GetWeight(Type::Subregion);
     }
 
-    ctx.AddResult(entry.m_osmId, entryCertainty, entry.m_type, tokenIds, allTypes);
+    ctx.AddResult(m_hierarchy.GetOsmId(docId), entryCertainty, type, tokenIds, allTypes);
   }
 }
 
-bool Geocoder::HasParent(vector<Geocoder::Layer> const & layers, Hierarchy::Entry const & e) const
+bool Geocoder::HasParent(vector<Geocoder::Layer> const & layers, Index::DocId docId) const
 {
   CHECK(!layers.empty(), ());
   auto const & layer = layers.back();
-  for (auto const & docId : layer.m_entries)
+  for (auto const & parentDocId : layer.m_entries)
   {
     // Note that the relationship is somewhat inverted: every ancestor
     // is stored in the address but the nodes have no information
     // about their children.
-    if (m_hierarchy.IsParentTo(m_index.GetDoc(docId), e))
+    if (m_hierarchy.IsParentTo(parentDocId, docId))
       return true;
   }
   return false;
 }
 
-bool Geocoder::IsRelevantLocalityMember(Context const & ctx, Hierarchy::Entry const & member,
+bool Geocoder::IsRelevantLocalityMember(Context const & ctx, Index::DocId member,
                                         Tokens const & subquery) const
 {
   auto const isNumeric = subquery.size() == 1 && strings::IsASCIINumeric(subquery.front());
   return !isNumeric || HasMemberLocalityInMatching(ctx, member);
 }
 
-bool Geocoder::HasMemberLocalityInMatching(Context const & ctx, Hierarchy::Entry const & member) const
+bool Geocoder::HasMemberLocalityInMatching(Context const & ctx, Index::DocId member) const
 {
   for (auto const & layer : ctx.GetLayers())
   {
@@ -551,8 +902,7 @@ bool Geocoder::HasMemberLocalityInMatching(Context const & ctx, Hierarchy::Entry
 
     for (auto const docId : layer.m_entries)
     {
-      auto const & matchedEntry = m_index.GetDoc(docId);
-      if (m_hierarchy.IsParentTo(matchedEntry, member))
+      if (m_hierarchy.IsParentTo(docId, member))
         return true;
     }
   }
@@ -5,21 +5,27 @@
 #include "geocoder/result.hpp"
 #include "geocoder/types.hpp"
 
+#include "coding/file_container.hpp"
+#include "coding/memory_region.hpp"
+
+#include "base/assert.hpp"
 #include "base/beam.hpp"
+#include "base/buffer_vector.hpp"
 #include "base/geo_object_id.hpp"
 #include "base/stl_helpers.hpp"
 #include "base/string_utils.hpp"
 
+#include <array>
 #include <cstddef>
-#include <set>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
 #include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
-#include <boost/serialization/version.hpp>
-
 namespace geocoder
 {
 // This class performs geocoding by using the data that we are currently unable
@@ -50,34 +56,56 @@ public:
   {
     Type m_type = Type::Count;
     std::vector<Index::DocId> m_entries;
+    // Entries are matched with misprints, so they rank below the exact matches.
+    bool m_withMisprints = false;
+    size_t m_tokensCount = 0;
   };
 
+  // Default limit of the number of results of a query.
+  static size_t constexpr kMaxResults = 100;
+
+  // Queries of up to this number of tokens are processed without heap allocations
+  // of token id lists.
+  static size_t constexpr kInlineTokensCount = 16;
+
+  using TokenIds = buffer_vector<size_t, kInlineTokensCount>;
+
   // This class is very similar to the one we use in search/.
   // See search/geocoder_context.hpp.
+  //
+  // All the buffers of the context are kept between queries (see Reset()),
+  // so a context that is reused for a series of queries stops allocating memory
+  // after the first few of them.
   class Context
   {
   public:
     struct BeamKey
     {
-      BeamKey(base::GeoObjectId osmId, Type type, std::vector<size_t> const & tokenIds,
-              std::vector<Type> const & allTypes)
-        : m_osmId(osmId)
-        , m_type(type)
-        , m_tokenIds{tokenIds}
-        , m_allTypes(allTypes)
+      BeamKey(base::GeoObjectId osmId, Type type, TokenIds const & tokenIds, uint32_t allTypes)
+        : m_osmId(osmId), m_type(type), m_tokenIds{tokenIds}, m_allTypes(allTypes)
       {
-        base::SortUnique(m_allTypes);
       }
 
       base::GeoObjectId m_osmId;
       Type m_type;
-      std::vector<size_t> m_tokenIds;
-      std::vector<Type> m_allTypes;
+      TokenIds m_tokenIds;
+      // The i-th bit is set iff the type |static_cast<Type>(i)| is matched by some tokens.
+      uint32_t m_allTypes;
+    };
+
+    // Scratch buffers for the subqueries of the same type.
+    struct Subquery
+    {
+      Tokens m_tokens;
+      TokenIds m_tokenIds;
     };
 
-    Context(std::string const & query);
+    explicit Context(std::string const & query = {}, size_t maxResults = kMaxResults);
 
+    // Clears the state of the previous query but keeps the allocated buffers,
+    // so the same context can be reused for a series of queries.
     void Clear();
+    void Reset(std::string const & query, size_t maxResults = kMaxResults);
 
     std::vector<Type> & GetTokenTypes();
     size_t GetNumTokens() const;
@@ -96,7 +124,10 @@ public:
     bool AllTokensUsed() const;
 
     void AddResult(base::GeoObjectId const & osmId, double certainty, Type type,
-                   std::vector<size_t> const & tokenIds, std::vector<Type> const & allTypes);
+                   TokenIds const & tokenIds, uint32_t allTypes);
+
+    // Returns whether a result with |certainty| would get to the results.
+    bool IsCertaintyAcceptable(double certainty) const;
 
     void FillResults(std::vector<Result> & results) const;
 
@@ -104,47 +135,114 @@ public:
 
     std::vector<Layer> const & GetLayers() const;
 
-    void MarkHouseNumberPositionsInQuery(std::vector<size_t> const & tokenIds);
+    // Returns an empty layer whose entries reuse the memory of the released layers.
+    Layer MakeLayer(Type type);
+    void ReleaseLayer(Layer && layer);
+    // Pops the last layer and releases it.
+    void PopLayer();
+
+    Subquery & GetSubquery(Type type);
+
+    void MarkHouseNumberPositionsInQuery(TokenIds const & tokenIds);
+
+    // Keys which match the tokens [l, r) with misprints do not depend on the matching
+    // of the other tokens, so they are looked up by |lookup| once per query.
+    template <typename Lookup>
+    std::vector<size_t> const & GetKeysWithMisprints(size_t l, size_t r, Lookup && lookup)
+    {
+      CHECK_LESS(l, r, ());
+      CHECK_LESS_OR_EQUAL(r, m_tokens.size(), ());
+      auto const i = l * m_tokens.size() + r - 1;
+      if (!m_hasKeysWithMisprints[i])
+      {
+        lookup(m_keysWithMisprints[i]);
+        m_hasKeysWithMisprints[i] = true;
+      }
+      return m_keysWithMisprints[i];
+    }
+
+    // Returns whether the tokens [l, r) look like a house number.
+    bool LooksLikeHouseNumber(size_t l, size_t r) const;
+    // Returns whether the matching of the unused tokens may add new house number positions.
+    bool MayMarkHouseNumberPositions() const;
 
   private:
-    bool IsGoodForPotentialHouseNumberAt(BeamKey const & beamKey, std::set<size_t> const & tokenIds) const;
+    bool IsGoodForPotentialHouseNumberAt(BeamKey const & beamKey, TokenIds const & tokenIds) const;
     bool IsBuildingWithAddress(BeamKey const & beamKey) const;
     bool HasLocalityOrRegion(BeamKey const & beamKey) const;
-    bool ContainsTokenIds(BeamKey const & beamKey, std::set<size_t> const & needTokenIds) const;
+    bool ContainsTokenIds(BeamKey const & beamKey, TokenIds const & needTokenIds) const;
 
     Tokens m_tokens;
     std::vector<Type> m_tokenTypes;
 
     size_t m_numUsedTokens = 0;
 
-    // |m_houseNumberPositionsInQuery| has indexes of query tokens which are placed on
+    // |m_houseNumberPositionsInQuery| has sorted indexes of query tokens which are placed on
     // context-dependent positions of house number.
     // The rationale is that we must only emit buildings in this case
     // and implement a fallback to a more powerful geocoder if we
     // could not find a building.
-    std::set<size_t> m_houseNumberPositionsInQuery;
+    TokenIds m_houseNumberPositionsInQuery;
+    // Ranges [l, r) of query tokens that look like house numbers.
+    std::vector<std::pair<size_t, size_t>> m_houseNumberRanges;
 
     // The highest value of certainty for a fixed amount of
     // the most relevant retrieved osm ids.
     base::Beam<BeamKey, double> m_beam;
 
     std::vector<Layer> m_layers;
+    // Entries buffers of the released layers.
+    std::vector<std::vector<Index::DocId>> m_freeEntries;
+
+    std::array<Subquery, static_cast<size_t>(Type::Count)> m_subqueries;
+
+    // Keys matched with misprints by the tokens [l, r) are at l * GetNumTokens() + r - 1.
+    std::vector<std::vector<size_t>> m_keysWithMisprints;
+    std::vector<bool> m_hasKeysWithMisprints;
   };
 
   void LoadFromJsonl(std::string const & pathToJsonHierarchy, unsigned int loadThreadsCount = 1);
 
+  // Maps the token index file to memory: the hierarchy and the index are queried in place
+  // and the pages are shared between all processes that use the same file.
   void LoadFromBinaryIndex(std::string const & pathToTokenIndex);
-  void SaveToBinaryIndex(std::string const & pathToTokenIndex) const;
-
-  template<class Archive>
-  void serialize(Archive & ar, const unsigned int version)
-  {
-    CHECK_EQUAL(version, kIndexFormatVersion, ());
-    ar & m_hierarchy;
-    ar & m_index;
-  }
-
-  void ProcessQuery(std::string const & query, std::vector<Result> & results) const;
+  void SaveToBinaryIndex(std::string const & pathToTokenIndex);
+
+  // Stores the best results of |query| to |results|. Only |maxResults| best matchings
+  // of the query are kept, and the matchings of the same object are counted separately,
+  // so there may be fewer results. The results with a smaller |maxResults| are the first ones
+  // of the results with a bigger limit, but the search skips more branches.
+  void ProcessQuery(std::string const & query, std::vector<Result> & results,
+                    size_t maxResults = kMaxResults) const;
+  // Same as above but uses |ctx| as a scratch space.
+  void ProcessQuery(std::string const & query, std::vector<Result> & results, Context & ctx,
+                    size_t maxResults = kMaxResults) const;
+
+  // Processes |queries| by |threadsCount| threads which share the index. Queries are
+  // handed out to threads one by one, so a thread that gets cheap queries takes more of them.
+  // The results of |queries[i]| are stored to |results[i]|, and the time spent on it
+  // to |durations[i]| (in seconds).
+  void ProcessQueries(std::vector<std::string> const & queries,
+                      std::vector<std::vector<Result>> & results, unsigned int threadsCount = 1,
+                      size_t maxResults = kMaxResults) const;
+  void ProcessQueries(std::vector<std::string> const & queries,
+                      std::vector<std::vector<Result>> & results, std::vector<double> & durations,
+                      unsigned int threadsCount = 1, size_t maxResults = kMaxResults) const;
+
+  // Reads the next query to |query|, returns false when there are no more queries.
+  using QueryReader = std::function<bool(std::string & query)>;
+  // Takes the results of |query| and the time spent on it (in seconds).
+  using ResultWriter = std::function<void(std::string const & query,
+                                          std::vector<Result> const & results, double duration)>;
+
+  // Same as above but for a stream of queries. Each of |threadsCount| threads reads queries
+  // by |readQuery| one by one and processes them with its own context. The results are given
+  // to |writeResult| in the order of the queries as soon as the previous ones are written.
+  // Threads do not run ahead of the first unwritten query too far, so only the results of
+  // a bounded number of queries are kept. |readQuery| and |writeResult| are not called
+  // concurrently with themselves.
+  void ProcessQueries(QueryReader const & readQuery, ResultWriter const & writeResult,
+                      unsigned int threadsCount = 1, size_t maxResults = kMaxResults) const;
 
   Hierarchy const & GetHierarchy() const;
 
@@ -153,22 +251,28 @@ public:
 private:
   void Go(Context & ctx, Type type) const;
 
-  void FillBuildingsLayer(Context & ctx, Tokens const & subquery, std::vector<size_t> const & subqueryTokenIds,
+  void FillBuildingsLayer(Context & ctx, Tokens const & subquery, TokenIds const & subqueryTokenIds,
                           Layer & curLayer) const;
-  void FillRegularLayer(Context const & ctx, Type type, Tokens const & subquery,
-                        Layer & curLayer) const;
-  void AddResults(Context & ctx, std::vector<Index::DocId> const & entries) const;
+  // When no doc of |type| matches |subquery| exactly, docs are looked up with misprints;
+  // the last (maybe unfinished) query token is matched as a prefix.
+  void FillRegularLayer(Context & ctx, Type type, Tokens const & subquery,
+                        TokenIds const & subqueryTokenIds, Layer & curLayer) const;
+  void AddResults(Context & ctx, Layer const & curLayer) const;
 
   // Returns whether any of the paths through |layers| can be extended
-  // by appending |e|.
-  bool HasParent(std::vector<Geocoder::Layer> const & layers, Hierarchy::Entry const & e) const;
-  bool IsRelevantLocalityMember(Context const & ctx, Hierarchy::Entry const & member,
+  // by appending |docId|.
+  bool HasParent(std::vector<Geocoder::Layer> const & layers, Index::DocId docId) const;
+  bool IsRelevantLocalityMember(Context const & ctx, Index::DocId member,
                                 Tokens const & subquery) const;
-  bool HasMemberLocalityInMatching(Context const & ctx, Hierarchy::Entry const & member) const;
+  bool HasMemberLocalityInMatching(Context const & ctx, Index::DocId member) const;
+
+  // Mapped sections of the token index file that |m_hierarchy| and |m_index| refer to
+  // when the geocoder is loaded from a binary index.
+  std::unique_ptr<FilesMappingContainer> m_indexContainer;
+  std::unique_ptr<MappedMemoryRegion> m_hierarchyRegion;
+  std::unique_ptr<MappedMemoryRegion> m_indexRegion;
 
   Hierarchy m_hierarchy;
   Index m_index{m_hierarchy};
 };
 }  // namespace geocoder
-
-BOOST_CLASS_VERSION(geocoder::Geocoder, geocoder::kIndexFormatVersion)
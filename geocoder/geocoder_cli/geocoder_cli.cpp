@@ -3,14 +3,20 @@
 
 #include "base/internal/message.hpp"
 #include "base/string_utils.hpp"
+#include "base/timer.hpp"
 
 #include <boost/program_options.hpp>
 
+#include <algorithm>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
 
+#include "3party/jansson/myjansson.hpp"
+
 using namespace geocoder;
 using namespace std;
 
@@ -23,22 +29,22 @@ void PrintResults(Hierarchy const & hierarchy, vector<Result> const & results, i
     return;
   cout << "Top results:" << endl;
 
-  auto const & dictionary = hierarchy.GetNormalizedNameDictionary();
   for (size_t i = 0; i < results.size(); ++i)
   {
     if (top >= 0 && static_cast<int32_t>(i) >= top)
       break;
     cout << "  " << DebugPrint(results[i]);
-    if (auto const && e = hierarchy.GetEntryForOsmId(results[i].m_osmId))
+    Hierarchy::EntryId entryId;
+    if (hierarchy.FindEntry(results[i].m_osmId, entryId))
     {
       cout << " [";
       auto const * delimiter = "";
       for (size_t i = 0; i < static_cast<size_t>(Type::Count); ++i)
       {
-        if (e->m_normalizedAddress[i] != NameDictionary::kUnspecifiedPosition)
+        auto const type = static_cast<Type>(i);
+        if (hierarchy.GetNormalizedAddress(entryId, type) != NameDictionary::kUnspecifiedPosition)
         {
-          auto type = static_cast<Type>(i);
-          auto multipleNames = e->GetNormalizedMultipleNames(type, dictionary);
+          auto multipleNames = hierarchy.GetNormalizedMultipleNames(entryId, type);
           cout << delimiter << ToString(type) << ": " << multipleNames.GetMainName();
           delimiter = ", ";
         }
@@ -49,7 +55,8 @@ void PrintResults(Hierarchy const & hierarchy, vector<Result> const & results, i
   }
 }
 
-void ProcessQueriesFromFile(Geocoder const & geocoder, string const & path, int32_t top)
+void ProcessQueriesFromFile(Geocoder const & geocoder, string const & path, int32_t top,
+                            size_t maxResults)
 {
   ifstream stream(path.c_str());
   CHECK(stream.is_open(), ("Can't open", path));
@@ -63,13 +70,87 @@ void ProcessQueriesFromFile(Geocoder const & geocoder, string const & path, int3
       continue;
 
     cout << s << endl;
-    geocoder.ProcessQuery(s, results);
+    geocoder.ProcessQuery(s, results, maxResults);
     PrintResults(geocoder.GetHierarchy(), results, top);
     cout << endl;
   }
 }
 
-void ProcessQueriesFromCommandLine(Geocoder const & geocoder, int32_t top)
+string MakeResultsJsonLine(string const & query, vector<Result> const & results, int32_t top)
+{
+  auto resultsJson = base::NewJSONArray();
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    if (top >= 0 && static_cast<int32_t>(i) >= top)
+      break;
+
+    ostringstream osmId;
+    osmId << uppercase << hex << setw(16) << setfill('0') << results[i].m_osmId.GetEncodedId();
+
+    auto resultJson = base::NewJSONObject();
+    ToJSONObject(*resultJson, "id", osmId.str());
+    ToJSONObject(*resultJson, "certainty", results[i].m_certainty);
+    ToJSONArray(*resultsJson, resultJson);
+  }
+
+  auto line = base::NewJSONObject();
+  ToJSONObject(*line, "query", query);
+  ToJSONObject(*line, "results", resultsJson);
+  return base::DumpToString(line, JSON_COMPACT);
+}
+
+// Returns the |q|-quantile of |values| sorted in the ascending order.
+double GetQuantile(vector<double> const & values, double q)
+{
+  if (values.empty())
+    return 0.0;
+  auto const i = static_cast<size_t>(q * (values.size() - 1) + 0.5);
+  return values[min(i, values.size() - 1)];
+}
+
+void ProcessQueriesInBatch(Geocoder const & geocoder, string const & queriesPath,
+                           string const & outputPath, int32_t top, unsigned int threadsCount,
+                           size_t maxResults)
+{
+  ifstream input(queriesPath.c_str());
+  CHECK(input.is_open(), ("Can't open", queriesPath));
+
+  ofstream output(outputPath.c_str());
+  CHECK(output.is_open(), ("Can't open", outputPath));
+
+  auto const readQuery = [&input](string & query) {
+    while (getline(input, query))
+    {
+      strings::Trim(query);
+      if (!query.empty())
+        return true;
+    }
+    return false;
+  };
+
+  // Durations of all the queries are kept for the exact latency quantiles.
+  vector<double> durations;
+  auto const writeResult = [&](string const & query, vector<Result> const & results,
+                               double duration) {
+    output << MakeResultsJsonLine(query, results, top) << "\n";
+    durations.push_back(duration);
+  };
+
+  base::Timer timer;
+  geocoder.ProcessQueries(readQuery, writeResult, threadsCount, maxResults);
+  auto const totalSeconds = timer.ElapsedSeconds();
+
+  auto const queriesCount = durations.size();
+  sort(durations.begin(), durations.end());
+  cout << "Queries: " << queriesCount << ", threads: " << threadsCount
+       << ", total time: " << totalSeconds << " s" << endl;
+  cout << "Queries per second: " << (totalSeconds > 0 ? queriesCount / totalSeconds : 0.0)
+       << endl;
+  cout << "Latency p50: " << GetQuantile(durations, 0.5) * 1000 << " ms"
+       << ", p99: " << GetQuantile(durations, 0.99) * 1000 << " ms" << endl;
+}
+
+void ProcessQueriesFromCommandLine(Geocoder const & geocoder, int32_t top, size_t maxResults)
 {
   string query;
   vector<Result> results;
@@ -80,7 +161,7 @@ void ProcessQueriesFromCommandLine(Geocoder const & geocoder, int32_t top)
       break;
     if (query == "q" || query == ":q" || query == "quit")
       break;
-    geocoder.ProcessQuery(query, results);
+    geocoder.ProcessQuery(query, results, maxResults);
     PrintResults(geocoder.GetHierarchy(), results, top);
   }
 }
@@ -89,7 +170,10 @@ struct CliCommandOptions
 {
   std::string m_hierarchy_path;
   std::string m_queries_path;
+  std::string m_batch_output_path;
   int32_t m_top;
+  unsigned int m_threads;
+  size_t m_max_results;
 };
 
 CliCommandOptions DefineOptions(int argc, char * argv[])
@@ -101,6 +185,9 @@ CliCommandOptions DefineOptions(int argc, char * argv[])
     ("hierarchy_path", po::value(&o.m_hierarchy_path), "Path to the hierarchy file for the geocoder")
     ("queries_path", po::value(&o.m_queries_path)->default_value(""), "Path to the file with queries")
     ("top", po::value(&o.m_top)->default_value(5), "Number of top results to show for every query, -1 to show all results")
+    ("batch_output_path", po::value(&o.m_batch_output_path)->default_value(""), "Path to the jsonl file for results of queries from --queries_path. Enables the batch mode that reports throughput and latency")
+    ("threads", po::value(&o.m_threads)->default_value(1), "Number of threads to process queries in the batch mode")
+    ("max_results", po::value(&o.m_max_results)->default_value(Geocoder::kMaxResults), "Maximal number of results to search for every query, smaller numbers speed up the search")
     ("help", "produce help message");
 
   po::variables_map vm;
@@ -142,12 +229,20 @@ int main(int argc, char * argv[])
     geocoder.LoadFromBinaryIndex(options.m_hierarchy_path);
   }
 
+  if (!options.m_queries_path.empty() && !options.m_batch_output_path.empty())
+  {
+    ProcessQueriesInBatch(geocoder, options.m_queries_path, options.m_batch_output_path,
+                          options.m_top, max(options.m_threads, 1u), options.m_max_results);
+    return 0;
+  }
+
   if (!options.m_queries_path.empty())
   {
-    ProcessQueriesFromFile(geocoder, options.m_queries_path, options.m_top);
+    ProcessQueriesFromFile(geocoder, options.m_queries_path, options.m_top,
+                           options.m_max_results);
     return 0;
   }
 
-  ProcessQueriesFromCommandLine(geocoder, options.m_top);
+  ProcessQueriesFromCommandLine(geocoder, options.m_top, options.m_max_results);
   return 0;
 }
@@ -13,7 +13,9 @@
 
 #include <algorithm>
 #include <iomanip>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 using namespace platform::tests_support;
@@ -64,6 +66,109 @@ UNIT_TEST(Geocoder_Smoke)
   TestGeocoder(geocoder, "florencia somewhere in cuba", {{cubaId, 0.714286}, {florenciaId, 1.0}});
 }
 
+UNIT_TEST(Geocoder_ProcessQueries)
+{
+  Geocoder geocoder;
+  ScopedFile const regionsJsonFile("regions.jsonl", kRegionsData);
+  geocoder.LoadFromJsonl(regionsJsonFile.GetFullPath());
+
+  vector<string> const queries = {"florencia", "cuba florencia", "", "florencia somewhere in cuba",
+                                  "ciego de avila", "nowhere"};
+
+  vector<vector<Result>> results;
+  vector<double> durations;
+  geocoder.ProcessQueries(queries, results, durations, 3 /* threadsCount */);
+  TEST_EQUAL(results.size(), queries.size(), ());
+  TEST_EQUAL(durations.size(), queries.size(), ());
+
+  vector<Result> expected;
+  for (size_t i = 0; i < queries.size(); ++i)
+  {
+    geocoder.ProcessQuery(queries[i], expected);
+    TEST_EQUAL(results[i].size(), expected.size(), (queries[i]));
+    for (size_t j = 0; j < expected.size(); ++j)
+    {
+      TEST_EQUAL(results[i][j].m_osmId, expected[j].m_osmId, (queries[i]));
+      TEST(base::AlmostEqualAbs(results[i][j].m_certainty, expected[j].m_certainty,
+                                kCertaintyEps),
+           (queries[i]));
+    }
+  }
+}
+
+UNIT_TEST(Geocoder_ProcessQueriesStream)
+{
+  Geocoder geocoder;
+  ScopedFile const regionsJsonFile("regions.jsonl", kRegionsData);
+  geocoder.LoadFromJsonl(regionsJsonFile.GetFullPath());
+
+  vector<string> queries;
+  for (size_t i = 0; i < 1000; ++i)
+  {
+    for (auto const & query : {"florencia", "cuba florencia", "ciego de avila", "nowhere"})
+      queries.emplace_back(query);
+  }
+
+  size_t nextQuery = 0;
+  auto const readQuery = [&](string & query) {
+    if (nextQuery == queries.size())
+      return false;
+    query = queries[nextQuery++];
+    return true;
+  };
+
+  vector<string> writtenQueries;
+  vector<vector<Result>> results;
+  auto const writeResult = [&](string const & query, vector<Result> const & queryResults,
+                               double duration) {
+    TEST_GREATER_OR_EQUAL(duration, 0.0, ());
+    writtenQueries.push_back(query);
+    results.push_back(queryResults);
+  };
+  geocoder.ProcessQueries(readQuery, writeResult, 4 /* threadsCount */);
+
+  // Results are written in the order of queries.
+  TEST_EQUAL(writtenQueries, queries, ());
+  vector<Result> expected;
+  for (size_t i = 0; i < queries.size(); ++i)
+  {
+    geocoder.ProcessQuery(queries[i], expected);
+    TEST_EQUAL(results[i].size(), expected.size(), (queries[i]));
+    for (size_t j = 0; j < expected.size(); ++j)
+      TEST_EQUAL(results[i][j].m_osmId, expected[j].m_osmId, (queries[i]));
+  }
+}
+
+UNIT_TEST(Geocoder_MaxResults)
+{
+  Geocoder geocoder;
+  ScopedFile const regionsJsonFile("regions.jsonl", kRegionsData);
+  geocoder.LoadFromJsonl(regionsJsonFile.GetFullPath());
+
+  vector<string> const queries = {"cuba florencia", "florencia somewhere in cuba",
+                                  "cuba ciego de avila florencia cuba ciego florencia de avila"};
+  for (auto const & query : queries)
+  {
+    vector<Result> expected;
+    geocoder.ProcessQuery(query, expected);
+    TEST_GREATER(expected.size(), 1, (query));
+
+    // A smaller limit prunes more branches of the search but keeps the best results.
+    for (size_t maxResults = 0; maxResults <= expected.size(); ++maxResults)
+    {
+      vector<Result> actual;
+      geocoder.ProcessQuery(query, actual, maxResults);
+      TEST_LESS_OR_EQUAL(actual.size(), maxResults, (query));
+      for (size_t i = 0; i < actual.size(); ++i)
+      {
+        TEST_EQUAL(actual[i].m_osmId, expected[i].m_osmId, (query, maxResults));
+        TEST(base::AlmostEqualAbs(actual[i].m_certainty, expected[i].m_certainty, kCertaintyEps),
+             (query, maxResults));
+      }
+    }
+  }
+}
+
 UNIT_TEST(Geocoder_Hierarchy)
 {
   Geocoder geocoder;
@@ -100,6 +205,38 @@ UNIT_TEST(Geocoder_EnglishNames)
   TestGeocoder(geocoder, "Moscow, New Arbat", {{Id{0x11}, 1.0}, {Id{0x10}, 0.6}});
 }
 
+UNIT_TEST(Geocoder_ParentWithOtherAltNames)
+{
+  string const kData = R"#(
+10 {"properties": {"locales": {"default": {"address": {"locality": "Москва"}}, "en": {"address": {"locality": "Moscow"}}}}}
+11 {"properties": {"locales": {"default": {"address": {"locality": "Москва", "street": "улица Новый Арбат"}}}}}
+12 {"properties": {"locales": {"default": {"address": {"locality": "Санкт-Петербург"}}}}}
+)#";
+
+  Geocoder geocoder;
+  ScopedFile const regionsJsonFile("regions.jsonl", kData);
+  geocoder.LoadFromJsonl(regionsJsonFile.GetFullPath());
+
+  auto const & hierarchy = geocoder.GetHierarchy();
+  auto const & dictionary = hierarchy.GetNormalizedNameDictionary();
+  Hierarchy::EntryId moscow, arbat, spb;
+  TEST(hierarchy.FindEntry(Id{0x10}, moscow), ());
+  TEST(hierarchy.FindEntry(Id{0x11}, arbat), ());
+  TEST(hierarchy.FindEntry(Id{0x12}, spb), ());
+
+  auto const moscowLocality = hierarchy.GetNormalizedAddress(moscow, Type::Locality);
+  auto const arbatLocality = hierarchy.GetNormalizedAddress(arbat, Type::Locality);
+  TEST_NOT_EQUAL(moscowLocality, arbatLocality, ());
+  TEST_EQUAL(dictionary.GetMainNameId(moscowLocality), dictionary.GetMainNameId(arbatLocality),
+             ());
+
+  TEST(hierarchy.IsParentTo(moscow, arbat), ());
+  TEST(!hierarchy.IsParentTo(arbat, moscow), ());
+  TEST(!hierarchy.IsParentTo(spb, arbat), ());
+
+  TestGeocoder(geocoder, "москва новый арбат", {{Id{0x11}, 1.0}, {Id{0x10}, 0.6}});
+}
+
 UNIT_TEST(Geocoder_OnlyBuildings)
 {
   string const kData = R"#(
@@ -356,6 +493,37 @@ UNIT_TEST(Geocoder_NumericalSuburbRelevance)
   TestGeocoder(geocoder, "Белгород, Щорса, 60", {{Id{0x22}, 1.0}});
 }
 
+// Geocoder_Misprints* ----------------------------------------------------------------------------
+UNIT_TEST(Geocoder_MisprintsAndPrefixes)
+{
+  string const kData = R"#(
+10 {"properties": {"locales": {"default": {"address": {"locality": "Moscow"}}}}}
+11 {"properties": {"locales": {"default": {"address": {"locality": "Moscow", "street": "Krymskaya"}}}}}
+12 {"properties": {"locales": {"default": {"address": {"locality": "Moscow", "street": "Parys"}}}}}
+20 {"properties": {"locales": {"default": {"address": {"locality": "Paris"}}}}}
+)#";
+
+  Geocoder geocoder;
+  ScopedFile const regionsJsonFile("regions.jsonl", kData);
+  geocoder.LoadFromJsonl(regionsJsonFile.GetFullPath());
+
+  TestGeocoder(geocoder, "moscw", {{Id{0x10}, 1.0}});
+  TestGeocoder(geocoder, "mosc", {{Id{0x10}, 1.0}});
+  TestGeocoder(geocoder, "moscow krymskya", {{Id{0x11}, 1.0}, {Id{0x10}, 0.857143}});
+  TestGeocoder(geocoder, "moscow krym", {{Id{0x11}, 1.0}, {Id{0x10}, 0.857143}});
+
+  // Prefixes are only allowed for the last token.
+  TestGeocoder(geocoder, "mosc krymskaya", {{Id{0x11}, 1.0}});
+  // Too short prefixes are not matched with misprints.
+  TestGeocoder(geocoder, "mo", {});
+
+  // Matches with misprints rank below the exact ones.
+  TestGeocoder(geocoder, "paris moscw",
+               {{Id{0x20}, 1.0}, {Id{0x12}, 0.666667}, {Id{0x10}, 0.5}});
+  // An exact match of another type does not prevent the lookup with misprints.
+  TestGeocoder(geocoder, "parys", {{Id{0x20}, 1.0}, {Id{0x12}, 0.666667}});
+}
+
 // Geocoder_Serialization --------------------------------------------------------------------------
 UNIT_TEST(Geocoder_Serialization)
 {
@@ -400,6 +568,25 @@ UNIT_TEST(Geocoder_Serialization)
     TEST_GREATER_OR_EQUAL(objectsFromJsonl.size(), 1, ());
     TEST_EQUAL(objectsFromTokenIndex, objectsFromJsonl, ());
   }
+
+  for (auto const & query : {"russia", "москва, арбат, 4", "россия москва"})
+  {
+    vector<Result> resultsFromJsonl;
+    geocoderFromJsonl.ProcessQuery(query, resultsFromJsonl);
+
+    vector<Result> resultsFromTokenIndex;
+    geocoderFromTokenIndex.ProcessQuery(query, resultsFromTokenIndex);
+
+    TEST_GREATER_OR_EQUAL(resultsFromJsonl.size(), 1, (query));
+    TEST_EQUAL(resultsFromTokenIndex.size(), resultsFromJsonl.size(), (query));
+    for (size_t i = 0; i < resultsFromJsonl.size(); ++i)
+    {
+      TEST_EQUAL(resultsFromTokenIndex[i].m_osmId, resultsFromJsonl[i].m_osmId, (query));
+      TEST(base::AlmostEqualAbs(resultsFromTokenIndex[i].m_certainty,
+                                resultsFromJsonl[i].m_certainty, kCertaintyEps),
+           (query));
+    }
+  }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -409,7 +596,7 @@ UNIT_TEST(Geocoder_EmptyFileConcurrentRead)
   ScopedFile const regionsJsonFile("regions.jsonl", "");
   geocoder.LoadFromJsonl(regionsJsonFile.GetFullPath(), 8 /* reader threads */);
 
-  TEST_EQUAL(geocoder.GetHierarchy().GetEntries().size(), 0, ());
+  TEST_EQUAL(geocoder.GetHierarchy().GetEntriesCount(), 0, ());
 }
 
 UNIT_TEST(Geocoder_BigFileConcurrentRead)
@@ -432,6 +619,107 @@ UNIT_TEST(Geocoder_BigFileConcurrentRead)
   ScopedFile const regionsJsonFile("regions.jsonl", s.str());
   geocoder.LoadFromJsonl(regionsJsonFile.GetFullPath(), 8 /* reader threads */);
 
-  TEST_EQUAL(geocoder.GetHierarchy().GetEntries().size(), kEntryCount, ());
+  TEST_EQUAL(geocoder.GetHierarchy().GetEntriesCount(), kEntryCount, ());
+
+  // Streams (e.g. decompressed ones) are read by blocks.
+  istringstream stream(s.str());
+  auto const hierarchy = HierarchyReader{stream}.Read(8 /* reader threads */);
+  TEST_EQUAL(hierarchy.GetEntriesCount(), kEntryCount, ());
+}
+
+UNIT_TEST(Geocoder_ConcurrentHousesIndexing)
+{
+  int const kStreetCount = 3;
+  int const kBuildingCount = 20000;
+
+  stringstream s;
+  s << R"(0000000000000001 {"properties": {"locales": {"default": {"address": {"locality": "City"}}}}})"
+    << "\n";
+  for (int i = 0; i < kStreetCount; ++i)
+  {
+    s << setw(16) << setfill('0') << hex << uppercase << 0x10 + i << " "
+      << R"({"properties": {"locales": {"default": {"address": {"locality": "City", "street": "Street )"
+      << i << R"("}}}}})"
+      << "\n";
+  }
+  for (int i = 0; i < kBuildingCount; ++i)
+  {
+    s << setw(16) << setfill('0') << hex << uppercase << 0x100 + i << " "
+      << R"({"properties": {"locales": {"default": {"address": {"locality": "City", "street": "Street )"
+      << i % kStreetCount << R"(", "building": ")" << dec << i << R"("}}}}})"
+      << "\n";
+  }
+  ScopedFile const regionsJsonFile("regions.jsonl", s.str());
+
+  auto const getRelatedBuildings = [&](unsigned int threadsCount) {
+    Geocoder geocoder;
+    geocoder.LoadFromJsonl(regionsJsonFile.GetFullPath(), threadsCount);
+    auto const & index = geocoder.GetIndex();
+
+    vector<vector<base::GeoObjectId>> relatedBuildings;
+    for (Index::DocId docId = 0; docId < kStreetCount + 1; ++docId)
+    {
+      relatedBuildings.emplace_back();
+      index.ForEachRelatedBuilding(docId, [&](Index::DocId const & buildingDocId) {
+        relatedBuildings.back().push_back(index.GetDoc(buildingDocId).m_osmId);
+      });
+    }
+    return relatedBuildings;
+  };
+
+  auto const expected = getRelatedBuildings(1 /* threadsCount */);
+  TEST_EQUAL(expected.size(), kStreetCount + 1, ());
+  // Buildings on streets are not related to the locality.
+  TEST(expected[0].empty(), ());
+  for (int i = 0; i < kStreetCount; ++i)
+  {
+    TEST_EQUAL(expected[i + 1].size(), (kBuildingCount - i + kStreetCount - 1) / kStreetCount, ());
+    TEST(is_sorted(expected[i + 1].begin(), expected[i + 1].end()), ());
+  }
+
+  TEST_EQUAL(getRelatedBuildings(8 /* threadsCount */), expected, ());
+}
+
+UNIT_TEST(Geocoder_ConcurrentNameDictionaryBuilding)
+{
+  size_t const kThreadsCount = 8;
+  size_t const kNamesCount = 1000;
+
+  auto const makeNames = [](size_t i) {
+    MultipleNames names{"name " + to_string(i % (kNamesCount / 2))};
+    if (i >= kNamesCount / 2)
+      names.AddAltName("alt name " + to_string(i));
+    return names;
+  };
+
+  NameDictionaryBuilder builder;
+  vector<vector<NameDictionary::Position>> positions(kThreadsCount);
+  vector<thread> threads;
+  for (size_t t = 0; t < kThreadsCount; ++t)
+  {
+    threads.emplace_back([&, t] {
+      for (size_t i = 0; i < kNamesCount; ++i)
+        positions[t].push_back(builder.Add(makeNames((i + t * 17) % kNamesCount)));
+    });
+  }
+  for (auto & thread : threads)
+    thread.join();
+
+  auto const dictionary = builder.Release();
+  TEST_EQUAL(dictionary.Size(), kNamesCount, ());
+  for (size_t t = 0; t < kThreadsCount; ++t)
+  {
+    for (size_t i = 0; i < kNamesCount; ++i)
+    {
+      auto const n = (i + t * 17) % kNamesCount;
+      auto const position = positions[t][i];
+      TEST_EQUAL(position, positions[0][n], ());
+      TEST(dictionary.Get(position).ToMultipleNames() == makeNames(n), (n));
+
+      // Names with equal main names have equal main name ids.
+      auto const sameMainName = positions[0][(n + kNamesCount / 2) % kNamesCount];
+      TEST_EQUAL(dictionary.GetMainNameId(position), dictionary.GetMainNameId(sameMainName), ());
+    }
+  }
 }
 }  // namespace geocoder
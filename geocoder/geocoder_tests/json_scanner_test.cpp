@@ -0,0 +1,97 @@
+#include "testing/testing.hpp"
+
+#include "geocoder/json_scanner.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace geocoder;
+using namespace std;
+
+namespace
+{
+// Reads "name" and "rank" from the "properties" of |json|.
+bool ReadProperties(string const & json, string & name, uint64_t & rank)
+{
+  try
+  {
+    JsonScanner scanner{json};
+    scanner.ForEachField([&](boost::string_view key) {
+      if (key != "properties")
+      {
+        scanner.SkipValue();
+        return;
+      }
+
+      scanner.ForEachField([&](boost::string_view key) {
+        if (key == "name")
+          scanner.ReadString(name);
+        else if (key == "rank")
+          rank = scanner.ReadUInt();
+        else
+          scanner.SkipValue();
+      });
+    });
+    scanner.Finish();
+  }
+  catch (JsonScanner::Exception const &)
+  {
+    return false;
+  }
+  return true;
+}
+}  // namespace
+
+UNIT_TEST(JsonScanner_Smoke)
+{
+  string name;
+  uint64_t rank = 0;
+  TEST(ReadProperties(R"({"geometry": {"type": "Point", "coordinates": [-1.5e3, 2, [{}]]},)"
+                      R"( "properties": {"name": "Moscow", "rank": 4, "flag": true, "x": null}})",
+                      name, rank),
+       ());
+  TEST_EQUAL(name, "Moscow", ());
+  TEST_EQUAL(rank, 4, ());
+
+  TEST(ReadProperties(R"( { "properties" : { } } )", name, rank), ());
+  TEST(ReadProperties(R"({})", name, rank), ());
+}
+
+UNIT_TEST(JsonScanner_Escapes)
+{
+  string name;
+  uint64_t rank = 0;
+  TEST(ReadProperties(R"({"skip": "a \" } \\", "properties": {"name": )"
+                      R"("\"q\" \\ \/ Москва 😀"}})",
+                      name, rank),
+       ());
+  TEST_EQUAL(name, "\"q\" \\ / Москва \xF0\x9F\x98\x80", ());
+
+  TEST(ReadProperties(R"({"properties": {"name": "escaped key"}})", name, rank), ());
+  TEST_EQUAL(name, "escaped key", ());
+}
+
+UNIT_TEST(JsonScanner_Malformed)
+{
+  vector<string> const kMalformed = {
+    "",
+    "[]",
+    R"({"properties": {"name": "unterminated}})",
+    R"({"properties": {"name": 1}})",
+    R"({"properties": {"rank": -1}})",
+    R"({"properties": {"rank": 1.5}})",
+    R"({"properties": {"name": "bad escape \x"}})",
+    R"({"properties": {"name": "bad unicode \u04"}})",
+    R"({"properties": {"name": "a"} "b": 1})",
+    R"({"geometry": [1, 2})",
+    R"({"properties": {}} trailing)",
+  };
+
+  for (auto const & json : kMalformed)
+  {
+    string name;
+    uint64_t rank = 0;
+    TEST(!ReadProperties(json, name, rank), (json));
+  }
+}
@@ -1,7 +1,10 @@
 #include "geocoder/hierarchy.hpp"
 
+#include "geocoder/json_scanner.hpp"
+
 #include "indexer/search_string_utils.hpp"
 
+#include "base/bits.hpp"
 #include "base/exception.hpp"
 #include "base/logging.hpp"
 #include "base/macros.hpp"
@@ -9,100 +12,177 @@
 #include "base/string_utils.hpp"
 
 #include <algorithm>
+#include <array>
+#include <limits>
+#include <string>
 #include <utility>
+#include <vector>
+
+#include <boost/optional.hpp>
 
 using namespace std;
 
 namespace geocoder
 {
-// Hierarchy::Entry --------------------------------------------------------------------------------
-bool Hierarchy::Entry::DeserializeFromJSON(string const & jsonStr,
-                                           NameDictionaryBuilder & normalizedNameDictionaryBuilder,
-                                           ParsingStats & stats)
+namespace
 {
-  try
-  {
-    base::Json root(jsonStr.c_str());
-    return DeserializeFromJSONImpl(root.get(), jsonStr, normalizedNameDictionaryBuilder, stats);
-  }
-  catch (base::Json::Exception const & e)
-  {
-    LOG(LDEBUG, ("Can't parse entry:", e.Msg(), jsonStr));
-  }
-  return false;
+uint8_t ToMask(size_t typeIndex) { return static_cast<uint8_t>(1u << typeIndex); }
+
+// Address fields of a single locale of a geojson entry.
+struct LocaleAddress
+{
+  bool m_isDefault = false;
+  bool m_hasAddress = false;
+  array<string, static_cast<size_t>(Type::Count)> m_levels;
+};
+
+// Fields of a geojson entry that are used by the hierarchy.
+struct EntryFields
+{
+  bool m_hasProperties = false;
+  bool m_hasLocales = false;
+  // Whether some address level is null. Such entries are skipped.
+  bool m_hasNullLevel = false;
+  vector<LocaleAddress> m_locales;
+  string m_name;
+  boost::optional<uint64_t> m_rank;
+};
+
+array<string, static_cast<size_t>(Type::Count)> const & GetLevelKeys()
+{
+  static auto const kLevelKeys = [] {
+    array<string, static_cast<size_t>(Type::Count)> keys;
+    for (size_t i = 0; i < keys.size(); ++i)
+      keys[i] = ToString(static_cast<Type>(i));
+    return keys;
+  }();
+  return kLevelKeys;
 }
 
-// todo(@m) Factor out to geojson.hpp? Add geojson to myjansson?
-bool Hierarchy::Entry::DeserializeFromJSONImpl(
-    json_t * const root, string const & jsonStr,
-    NameDictionaryBuilder & normalizedNameDictionaryBuilder, ParsingStats & stats)
+void ReadAddress(JsonScanner & scanner, LocaleAddress & locale, bool & hasNullLevel)
 {
-  if (!json_is_object(root))
-  {
-    ++stats.m_badJsons;
-    MYTHROW(base::Json::Exception, ("Not a json object."));
-  }
+  auto const & levelKeys = GetLevelKeys();
+  scanner.ForEachField([&](boost::string_view key) {
+    auto const it = find(levelKeys.begin(), levelKeys.end(), key);
+    if (it == levelKeys.end())
+    {
+      scanner.SkipValue();
+      return;
+    }
 
-  if (!DeserializeAddressFromJSON(root, normalizedNameDictionaryBuilder, stats))
-    return false;
+    if (scanner.ReadNull())
+      hasNullLevel = true;
+    else
+      scanner.ReadString(locale.m_levels[static_cast<size_t>(it - levelKeys.begin())]);
+  });
+}
 
-  auto const defaultLocale = base::GetJSONObligatoryFieldByPath(root, "properties", "locales",
-                                                                "default");
-  FromJSONObjectOptionalField(defaultLocale, "name", m_name);
-  if (m_name.empty())
-    ++stats.m_emptyNames;
+void ReadLocales(JsonScanner & scanner, EntryFields & fields)
+{
+  scanner.ForEachField([&](boost::string_view localeName) {
+    fields.m_locales.emplace_back();
+    auto & locale = fields.m_locales.back();
+    locale.m_isDefault = localeName == "default";
+    scanner.ForEachField([&](boost::string_view key) {
+      if (key == "address")
+      {
+        locale.m_hasAddress = true;
+        ReadAddress(scanner, locale, fields.m_hasNullLevel);
+      }
+      else if (key == "name" && locale.m_isDefault)
+      {
+        scanner.ReadString(fields.m_name);
+      }
+      else
+      {
+        scanner.SkipValue();
+      }
+    });
+  });
+}
 
-  if (m_type == Type::Count)
-  {
-    LOG(LDEBUG, ("No address in an hierarchy entry:", jsonStr));
-    ++stats.m_emptyAddresses;
-  }
-  return true;
+void ReadEntryFields(JsonScanner & scanner, EntryFields & fields)
+{
+  scanner.ForEachField([&](boost::string_view key) {
+    if (key != "properties")
+    {
+      scanner.SkipValue();
+      return;
+    }
+
+    fields.m_hasProperties = true;
+    scanner.ForEachField([&](boost::string_view key) {
+      if (key == "locales")
+      {
+        fields.m_hasLocales = true;
+        ReadLocales(scanner, fields);
+      }
+      else if (key == "rank")
+      {
+        fields.m_rank = scanner.ReadUInt();
+      }
+      else
+      {
+        scanner.SkipValue();
+      }
+    });
+  });
+  scanner.Finish();
 }
 
-bool Hierarchy::Entry::DeserializeAddressFromJSON(
-    json_t * const root, NameDictionaryBuilder & normalizedNameDictionaryBuilder,
-    ParsingStats & stats)
+bool FillAddress(EntryFields const & fields, Hierarchy::Entry & entry,
+                 NameDictionaryBuilder & normalizedNameDictionaryBuilder,
+                 Hierarchy::ParsingStats & stats)
 {
-  auto const properties = base::GetJSONObligatoryField(root, "properties");
-  auto const locales = base::GetJSONObligatoryField(properties, "locales");
-  m_normalizedAddress= {};
+  auto & address = entry.m_normalizedAddress;
+  address = {};
+  Tokens tokens;
   for (size_t i = 0; i < static_cast<size_t>(Type::Count); ++i)
   {
-    Type const type = static_cast<Type>(i);
     MultipleNames multipleNames;
-    if (!FetchAddressFieldNames(locales, type, multipleNames, normalizedNameDictionaryBuilder,
-                                stats))
+    for (auto const & locale : fields.m_locales)
     {
-      return false;
+      auto const & levelValue = locale.m_levels[i];
+      if (levelValue.empty())
+        continue;
+
+      search::NormalizeAndTokenizeAsUtf8(levelValue, tokens);
+      if (tokens.empty())
+        continue;
+
+      auto normalizedValue = strings::JoinStrings(tokens, " ");
+      if (locale.m_isDefault)
+        multipleNames.SetMainName(normalizedValue);
+      else
+        multipleNames.AddAltName(normalizedValue);
     }
 
     if (!multipleNames.GetMainName().empty())
     {
-      m_normalizedAddress[i] = normalizedNameDictionaryBuilder.Add(move(multipleNames));
-      m_type = static_cast<Type>(i);
+      address[i] = normalizedNameDictionaryBuilder.Add(multipleNames);
+      entry.m_type = static_cast<Type>(i);
     }
   }
 
-  if (auto const rank = FromJSONObjectOptional<uint8_t>(properties, "rank"))
+  if (fields.m_rank && *fields.m_rank <= numeric_limits<uint8_t>::max())
   {
-    auto const type = RankToType(*rank);
+    auto const type = Hierarchy::Entry::RankToType(static_cast<uint8_t>(*fields.m_rank));
     if (type != Type::Count &&
-        m_normalizedAddress[static_cast<size_t>(type)] != NameDictionary::kUnspecifiedPosition)
+        address[static_cast<size_t>(type)] != NameDictionary::kUnspecifiedPosition)
     {
-      m_type = type;
+      entry.m_type = type;
     }
   }
 
-  auto const & subregion = m_normalizedAddress[static_cast<size_t>(Type::Subregion)];
-  auto const & locality = m_normalizedAddress[static_cast<size_t>(Type::Locality)];
-  if (m_type == Type::Street && locality == NameDictionary::kUnspecifiedPosition &&
+  auto const & subregion = address[static_cast<size_t>(Type::Subregion)];
+  auto const & locality = address[static_cast<size_t>(Type::Locality)];
+  if (entry.m_type == Type::Street && locality == NameDictionary::kUnspecifiedPosition &&
       subregion == NameDictionary::kUnspecifiedPosition)
   {
     ++stats.m_noLocalityStreets;
     return false;
   }
-  if (m_type == Type::Building && locality == NameDictionary::kUnspecifiedPosition &&
+  if (entry.m_type == Type::Building && locality == NameDictionary::kUnspecifiedPosition &&
       subregion == NameDictionary::kUnspecifiedPosition)
   {
     ++stats.m_noLocalityBuildings;
@@ -111,50 +191,61 @@ bool Hierarchy::Entry::DeserializeAddressFromJSON(
 
   return true;
 }
+}  // namespace
 
-// static
-bool Hierarchy::Entry::FetchAddressFieldNames(
-    json_t * const locales, Type type, MultipleNames & multipleNames,
-    NameDictionaryBuilder & /*normalizedNameDictionaryBuilder*/, ParsingStats & /*stats*/)
+// Hierarchy::Entry --------------------------------------------------------------------------------
+bool Hierarchy::Entry::DeserializeFromJSON(boost::string_view json,
+                                           NameDictionaryBuilder & normalizedNameDictionaryBuilder,
+                                           ParsingStats & stats)
 {
-  char const * localeName = nullptr;
-  json_t * localisedNames = nullptr;
-  string const & levelKey = ToString(type);
-  Tokens tokens;
-  json_object_foreach(locales, localeName, localisedNames)
+  EntryFields fields;
+  try
   {
-    auto const address = base::GetJSONObligatoryField(localisedNames, "address");
-    auto const levelJson = base::GetJSONOptionalField(address, levelKey);
-    if (!levelJson)
-      continue;
+    JsonScanner scanner{json};
+    if (!scanner.IsObject())
+      MYTHROW(JsonScanner::Exception, ("Not a json object."));
+    ReadEntryFields(scanner, fields);
+  }
+  catch (JsonScanner::Exception const & e)
+  {
+    LOG(LDEBUG, ("Can't parse entry:", e.Msg(), json.to_string()));
+    ++stats.m_badJsons;
+    return false;
+  }
 
-    if (base::JSONIsNull(levelJson))
-      return false;
+  auto const hasDefaultLocale =
+      any_of(fields.m_locales.begin(), fields.m_locales.end(),
+             [](LocaleAddress const & locale) { return locale.m_isDefault; });
+  auto const hasAllAddresses =
+      all_of(fields.m_locales.begin(), fields.m_locales.end(),
+             [](LocaleAddress const & locale) { return locale.m_hasAddress; });
+  if (!fields.m_hasProperties || !fields.m_hasLocales || !hasDefaultLocale || !hasAllAddresses)
+  {
+    LOG(LDEBUG, ("Can't parse entry: obligatory fields are missing", json.to_string()));
+    return false;
+  }
 
-    string levelValue;
-    FromJSON(levelJson, levelValue);
-    if (levelValue.empty())
-      continue;
+  if (fields.m_hasNullLevel)
+    return false;
 
-    search::NormalizeAndTokenizeAsUtf8(levelValue, tokens);
-    if (tokens.empty())
-      continue;
+  if (!FillAddress(fields, *this, normalizedNameDictionaryBuilder, stats))
+    return false;
 
-    auto normalizedValue = strings::JoinStrings(tokens, " ");
-    static std::string defaultLocale = "default";
-    if (localeName == defaultLocale)
-      multipleNames.SetMainName(normalizedValue);
-    else
-      multipleNames.AddAltName(normalizedValue);
-  }
+  if (fields.m_name.empty())
+    ++stats.m_emptyNames;
 
+  if (m_type == Type::Count)
+  {
+    LOG(LDEBUG, ("No address in an hierarchy entry:", json.to_string()));
+    ++stats.m_emptyAddresses;
+  }
   return true;
 }
 
-MultipleNames const & Hierarchy::Entry::GetNormalizedMultipleNames(
+MultipleNamesView Hierarchy::Entry::GetNormalizedMultipleNames(
     Type type, NameDictionary const & normalizedNameDictionary) const
 {
-  auto const & addressField = m_normalizedAddress[static_cast<size_t>(type)];
+  auto const addressField = m_normalizedAddress[static_cast<size_t>(type)];
   return normalizedNameDictionary.Get(addressField);
 }
 
@@ -179,20 +270,51 @@ Type Hierarchy::Entry::RankToType(uint8_t rank)
 // Hierarchy ---------------------------------------------------------------------------------------
 Hierarchy::Hierarchy(vector<Entry> && entries, NameDictionary && normalizedNameDictionary,
                      std::string && dataVersion)
-  : m_entries{move(entries)}
-  , m_normalizedNameDictionary{move(normalizedNameDictionary)}
-  , m_dataVersion(move(dataVersion))
+  : m_normalizedNameDictionary{move(normalizedNameDictionary)}
 {
-  if (!is_sorted(m_entries.begin(), m_entries.end()))
+  if (!is_sorted(entries.begin(), entries.end()))
   {
     LOG(LINFO, ("Sorting entries..."));
-    sort(m_entries.begin(), m_entries.end());
+    sort(entries.begin(), entries.end());
   }
-}
 
-vector<Hierarchy::Entry> const & Hierarchy::GetEntries() const
-{
-  return m_entries;
+  vector<uint64_t> osmIds;
+  vector<uint8_t> types;
+  vector<uint8_t> addressMasks;
+  vector<uint32_t> addressOffsets{0};
+  vector<NameDictionary::Position> addressPositions;
+  osmIds.reserve(entries.size());
+  types.reserve(entries.size());
+  addressMasks.reserve(entries.size());
+  addressOffsets.reserve(entries.size() + 1);
+  for (auto const & entry : entries)
+  {
+    osmIds.push_back(entry.m_osmId.GetEncodedId());
+    types.push_back(static_cast<uint8_t>(entry.m_type));
+
+    uint8_t mask = 0;
+    for (size_t i = 0; i < entry.m_normalizedAddress.size(); ++i)
+    {
+      if (entry.m_normalizedAddress[i] == NameDictionary::kUnspecifiedPosition)
+        continue;
+      mask |= ToMask(i);
+      addressPositions.push_back(entry.m_normalizedAddress[i]);
+    }
+    addressMasks.push_back(mask);
+
+    CHECK_LESS(addressPositions.size(), numeric_limits<uint32_t>::max(), ());
+    addressOffsets.push_back(static_cast<uint32_t>(addressPositions.size()));
+  }
+  vector<Entry>().swap(entries);
+
+  m_osmIds.steal(osmIds);
+  m_types.steal(types);
+  m_addressMasks.steal(addressMasks);
+  m_addressOffsets.steal(addressOffsets);
+  m_addressPositions.steal(addressPositions);
+
+  vector<char> dataVersionChars(dataVersion.begin(), dataVersion.end());
+  m_dataVersion.steal(dataVersionChars);
 }
 
 NameDictionary const & Hierarchy::GetNormalizedNameDictionary() const
@@ -200,39 +322,90 @@ NameDictionary const & Hierarchy::GetNormalizedNameDictionary() const
   return m_normalizedNameDictionary;
 }
 
-Hierarchy::Entry const * Hierarchy::GetEntryForOsmId(base::GeoObjectId const & osmId) const
+NameDictionary::Position Hierarchy::GetNormalizedAddress(EntryId id, Type type) const
+{
+  ASSERT_LESS(id, m_addressMasks.size(), ());
+  ASSERT_LESS(type, Type::Count, ());
+
+  auto const typeMask = ToMask(static_cast<size_t>(type));
+  auto const mask = m_addressMasks[id];
+  if ((mask & typeMask) == 0)
+    return NameDictionary::kUnspecifiedPosition;
+
+  auto const rank = bits::PopCount(static_cast<uint8_t>(mask & (typeMask - 1)));
+  return m_addressPositions[m_addressOffsets[id] + rank];
+}
+
+MultipleNamesView Hierarchy::GetNormalizedMultipleNames(EntryId id, Type type) const
+{
+  return m_normalizedNameDictionary.Get(GetNormalizedAddress(id, type));
+}
+
+Hierarchy::Entry Hierarchy::GetEntry(EntryId id) const
 {
-  auto const cmp = [](Hierarchy::Entry const & e, base::GeoObjectId const & id) {
-    return e.m_osmId < id;
-  };
+  Entry entry;
+  entry.m_osmId = GetOsmId(id);
+  entry.m_type = GetType(id);
+  for (size_t i = 0; i < entry.m_normalizedAddress.size(); ++i)
+    entry.m_normalizedAddress[i] = GetNormalizedAddress(id, static_cast<Type>(i));
+  return entry;
+}
 
-  auto const it = lower_bound(m_entries.begin(), m_entries.end(), osmId, cmp);
+void Hierarchy::Swap(Hierarchy & other)
+{
+  m_osmIds.swap(other.m_osmIds);
+  m_types.swap(other.m_types);
+  m_addressMasks.swap(other.m_addressMasks);
+  m_addressOffsets.swap(other.m_addressOffsets);
+  m_addressPositions.swap(other.m_addressPositions);
+  m_normalizedNameDictionary.Swap(other.m_normalizedNameDictionary);
+  m_dataVersion.swap(other.m_dataVersion);
+}
 
-  if (it == m_entries.end() || it->m_osmId != osmId)
-    return nullptr;
+bool Hierarchy::FindEntry(base::GeoObjectId const & osmId, EntryId & id) const
+{
+  auto const encodedId = osmId.GetEncodedId();
+  auto const it = lower_bound(m_osmIds.begin(), m_osmIds.end(), encodedId);
+  if (it == m_osmIds.end() || *it != encodedId)
+    return false;
 
-  return &(*it);
+  id = static_cast<EntryId>(distance(m_osmIds.begin(), it));
+  return true;
 }
 
-bool Hierarchy::IsParentTo(Hierarchy::Entry const & entry, Hierarchy::Entry const & toEntry) const
+bool Hierarchy::IsParentTo(EntryId entry, EntryId toEntry) const
 {
-  for (size_t i = 0; i < static_cast<size_t>(geocoder::Type::Count); ++i)
+  ASSERT_LESS(entry, m_addressMasks.size(), ());
+  ASSERT_LESS(toEntry, m_addressMasks.size(), ());
+
+  auto const mask = m_addressMasks[entry];
+  auto const toMask = m_addressMasks[toEntry];
+  // Every field of the parent address must be in the child address.
+  if ((mask & ~toMask) != 0)
+    return false;
+
+  auto position = m_addressOffsets[entry];
+  auto toPosition = m_addressOffsets[toEntry];
+  for (size_t i = 0; i < static_cast<size_t>(Type::Count); ++i)
   {
-    if (entry.m_normalizedAddress[i] == NameDictionary::kUnspecifiedPosition)
+    auto const typeMask = ToMask(i);
+    if ((toMask & typeMask) == 0)
       continue;
 
-    if (toEntry.m_normalizedAddress[i] == NameDictionary::kUnspecifiedPosition)
-      return false;
+    auto const pos2 = m_addressPositions[toPosition++];
+    if ((mask & typeMask) == 0)
+      continue;
 
-    auto const pos1 = entry.m_normalizedAddress[i];
-    auto const pos2 = toEntry.m_normalizedAddress[i];
+    auto const pos1 = m_addressPositions[position++];
     if (pos1 == pos2)
       continue;
 
-    auto const & name1 = m_normalizedNameDictionary.Get(pos1).GetMainName();
-    auto const & name2 = m_normalizedNameDictionary.Get(pos2).GetMainName();
-    if (name1 != name2)
+    // Names with different alternative names are still the same name.
+    if (m_normalizedNameDictionary.GetMainNameId(pos1) !=
+        m_normalizedNameDictionary.GetMainNameId(pos2))
+    {
       return false;
+    }
   }
   return true;
 }
@@ -12,13 +12,9 @@
 #include <string>
 #include <vector>
 
-#include <boost/serialization/array.hpp>
-#include <boost/serialization/split_free.hpp>
-#include <boost/serialization/string.hpp>
-#include <boost/serialization/vector.hpp>
-#include <boost/serialization/version.hpp>
+#include <boost/utility/string_view.hpp>
 
-#include "3party/jansson/myjansson.hpp"
+#include "3party/succinct/mappable_vector.hpp"
 
 namespace geocoder
 {
@@ -64,105 +60,106 @@ public:
   // A single entry in the hierarchy directed acyclic graph.
   // Currently, this is more or less the "properties"-"address"
   // part of the geojson entry.
+  // Entries are read one by one but the hierarchy stores their fields in separate
+  // packed arrays (see the private part), so an Entry is only assembled on request.
   struct Entry
   {
-    template<class Archive>
-    void serialize(Archive & ar, const unsigned int version)
-    {
-      CHECK_EQUAL(version, kIndexFormatVersion, ());
-      ar & m_osmId;
-      ar & m_name;
-      ar & m_type;
-      ar & m_normalizedAddress;
-    }
-
-    bool DeserializeFromJSON(std::string const & jsonStr,
+    // Reads the entry from the geojson |json|. Only the address, the default name and
+    // the rank are extracted, the rest of the json is skipped without parsing.
+    bool DeserializeFromJSON(boost::string_view json,
                              NameDictionaryBuilder & normalizedNameDictionaryBuilder,
                              ParsingStats & stats);
-    bool DeserializeFromJSONImpl(json_t * const root, std::string const & jsonStr,
-                                 NameDictionaryBuilder & normalizedNameDictionaryBuilder,
-                                 ParsingStats & stats);
-    bool DeserializeAddressFromJSON(json_t * const root,
-                                    NameDictionaryBuilder & normalizedNameDictionaryBuilder,
-                                    ParsingStats & stats);
-    static bool FetchAddressFieldNames(json_t * const locales, Type type,
-                                       MultipleNames & multipleNames,
-                                       NameDictionaryBuilder & normalizedNameDictionaryBuilder,
-                                       ParsingStats & stats);
     // See generator::regions::LevelRegion::GetRank().
     static Type RankToType(uint8_t rank);
 
-    MultipleNames const & GetNormalizedMultipleNames(
+    MultipleNamesView GetNormalizedMultipleNames(
         Type type, NameDictionary const & normalizedNameDictionary) const;
     bool operator<(Entry const & rhs) const { return m_osmId < rhs.m_osmId; }
 
     base::GeoObjectId m_osmId = base::GeoObjectId(base::GeoObjectId::kInvalid);
 
-    // Original name of the entry. Useful for debugging.
-    std::string m_name;
-
     Type m_type = Type::Count;
 
     // The positions of entry address fields in normalized name dictionary, one per Type.
     std::array<NameDictionary::Position, static_cast<size_t>(Type::Count)> m_normalizedAddress{};
   };
 
+  // Number of the entry in the list of all entries sorted by osm ids.
+  using EntryId = std::uint32_t;
+
   Hierarchy() = default;
   Hierarchy(std::vector<Entry> && entries, NameDictionary && normalizeNameDictionary,
             std::string && dataVersion);
+  Hierarchy(Hierarchy && other) { Swap(other); }
+  Hierarchy & operator=(Hierarchy && other)
+  {
+    Swap(other);
+    return *this;
+  }
 
-  template<class Archive>
-  void serialize(Archive & ar, const unsigned int version)
+  // Maps the hierarchy to the memory of the token index file or freezes it there.
+  // The hierarchy only references the memory, so it must outlive the hierarchy.
+  template <typename Visitor>
+  void map(Visitor & visitor)
   {
-    CHECK_EQUAL(version, kIndexFormatVersion, ());
-    ar & m_entries;
-    ar & m_normalizedNameDictionary;
-    ar & m_dataVersion;
+    visitor(m_osmIds, "osmIds");
+    visitor(m_types, "types");
+    visitor(m_addressMasks, "addressMasks");
+    visitor(m_addressOffsets, "addressOffsets");
+    visitor(m_addressPositions, "addressPositions");
+    visitor(m_normalizedNameDictionary, "normalizedNameDictionary");
+    visitor(m_dataVersion, "dataVersion");
   }
 
-  std::vector<Entry> const & GetEntries() const;
+  size_t GetEntriesCount() const { return m_osmIds.size(); }
   NameDictionary const & GetNormalizedNameDictionary() const;
 
-  Entry const * GetEntryForOsmId(base::GeoObjectId const & osmId) const;
-  bool IsParentTo(Hierarchy::Entry const & entry, Hierarchy::Entry const & toEntry) const;
+  base::GeoObjectId GetOsmId(EntryId id) const
+  {
+    ASSERT_LESS(id, m_osmIds.size(), ());
+    return base::GeoObjectId(m_osmIds[id]);
+  }
 
-  std::string const & GetDataVersion() const
+  Type GetType(EntryId id) const
   {
-    return m_dataVersion;
+    ASSERT_LESS(id, m_types.size(), ());
+    return static_cast<Type>(m_types[id]);
   }
 
-private:
-  std::vector<Entry> m_entries;
-  NameDictionary m_normalizedNameDictionary;
-  std::string m_dataVersion;
-};
-}  // namespace geocoder
+  // Returns the position of the |type| field of the entry address in the normalized name
+  // dictionary or kUnspecifiedPosition.
+  NameDictionary::Position GetNormalizedAddress(EntryId id, Type type) const;
+  MultipleNamesView GetNormalizedMultipleNames(EntryId id, Type type) const;
 
-BOOST_CLASS_VERSION(geocoder::Hierarchy, geocoder::kIndexFormatVersion)
-BOOST_CLASS_VERSION(geocoder::Hierarchy::Entry, geocoder::kIndexFormatVersion)
+  // Assembles all the fields of the entry. Prefer the getters of single fields
+  // in the loops over entries.
+  Entry GetEntry(EntryId id) const;
+  bool FindEntry(base::GeoObjectId const & osmId, EntryId & id) const;
 
-namespace boost
-{
-namespace serialization
-{
-template<class Archive>
-inline void serialize(Archive & ar, base::GeoObjectId & t, const unsigned int version)
-{
-  split_free(ar, t, version);
-}
+  bool IsParentTo(EntryId entry, EntryId toEntry) const;
 
-template<class Archive>
-inline void save(Archive & ar, base::GeoObjectId const & t, const unsigned int /*version*/)
-{
-  ar & t.GetEncodedId();
-}
+  std::string GetDataVersion() const
+  {
+    return {m_dataVersion.begin(), m_dataVersion.end()};
+  }
 
-template<class Archive>
-inline void load(Archive & ar, base::GeoObjectId & t, const unsigned int /*version*/)
-{
-  uint64_t encodedId = 0;
-  ar & encodedId;
-  t = base::GeoObjectId(encodedId);
-}
-}  // namespace serialization
-}  // namespace boost
+  void Swap(Hierarchy & other);
+
+private:
+  static_assert(static_cast<size_t>(Type::Count) <= 8, "Address masks are 8-bit");
+
+  // Fields of the entries sorted by osm ids: the encoded osm ids, the types and the masks
+  // of address fields. The i-th bit of a mask is set iff the address has the field of
+  // the type static_cast<Type>(i).
+  succinct::mapper::mappable_vector<std::uint64_t> m_osmIds;
+  succinct::mapper::mappable_vector<std::uint8_t> m_types;
+  succinct::mapper::mappable_vector<std::uint8_t> m_addressMasks;
+  // Positions of the specified address fields of the entry |id| in the order of types are
+  // [m_addressOffsets[id], m_addressOffsets[id + 1]) of |m_addressPositions|.
+  succinct::mapper::mappable_vector<std::uint32_t> m_addressOffsets;
+  succinct::mapper::mappable_vector<NameDictionary::Position> m_addressPositions;
+
+  NameDictionary m_normalizedNameDictionary;
+  succinct::mapper::mappable_vector<char> m_dataVersion;
+};
+}  // namespace geocoder
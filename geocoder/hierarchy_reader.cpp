@@ -1,13 +1,15 @@
 #include "geocoder/hierarchy_reader.hpp"
 
+#include "platform/platform.hpp"
+
 #include "base/logging.hpp"
 #include "base/thread_pool_computational.hpp"
 
 #include <algorithm>
+#include <cstring>
 #include <iomanip>
 #include <list>
 #include <sstream>
-#include <thread>
 #include <vector>
 
 using namespace std;
@@ -19,6 +21,9 @@ namespace
 // Information will be logged for every |kLogBatch| entries.
 size_t const kLogBatch = 100000;
 
+// Approximate size of a block of lines that is parsed by a single task.
+size_t const kReadBlockSize = 4 * 1024 * 1024;
+
 void operator+=(Hierarchy::ParsingStats & accumulator, Hierarchy::ParsingStats & stats)
 {
   struct ValidationStats
@@ -43,14 +48,29 @@ void operator+=(Hierarchy::ParsingStats & accumulator, Hierarchy::ParsingStats &
 } // namespace
 
 HierarchyReader::HierarchyReader(string const & pathToJsonHierarchy)
-  : m_fileStream{pathToJsonHierarchy}, m_in{m_fileStream}
 {
-  if (!m_fileStream)
+  uint64_t size = 0;
+  if (!Platform::GetFileSizeByFullPath(pathToJsonHierarchy, size))
     MYTHROW(OpenException, ("Failed to open file", pathToJsonHierarchy));
+
+  // Empty files can not be mapped.
+  if (size == 0)
+    return;
+
+  try
+  {
+    m_mappedFile = make_unique<MmapReader>(pathToJsonHierarchy);
+  }
+  catch (Reader::OpenException const & e)
+  {
+    MYTHROW(OpenException, ("Failed to open file", pathToJsonHierarchy, e.Msg()));
+  }
+  m_mappedLines = {reinterpret_cast<char const *>(m_mappedFile->Data()),
+                   static_cast<size_t>(m_mappedFile->Size())};
 }
 
 HierarchyReader::HierarchyReader(istream & in)
-  : m_in{in}
+  : m_in{&in}
 {
 }
 
@@ -67,13 +87,29 @@ Hierarchy HierarchyReader::Read(unsigned int readersCount)
 
   base::thread_pool::computational::ThreadPool threadPool{readersCount};
   list<future<ParsingResult>> tasks{};
-  while (!m_eof || !tasks.empty())
+  bool eof = false;
+  while (!eof || !tasks.empty())
   {
-    size_t const kReadBlockLineCount = 1000;
-    while (!m_eof && tasks.size() <= 2 * readersCount)
-      tasks.emplace_back(threadPool.Submit([&] { return ReadEntries(kReadBlockLineCount); }));
+    while (!eof && tasks.size() <= 2 * readersCount)
+    {
+      boost::string_view lines;
+      shared_ptr<string> buffer;
+      if (!ReadLines(lines, buffer))
+      {
+        eof = true;
+        break;
+      }
+
+      // |buffer| owns the lines read from the stream until they are parsed.
+      tasks.emplace_back(threadPool.Submit([this, lines, buffer, &nameDictionaryBuilder] {
+        return DeserializeEntries(buffer ? boost::string_view{*buffer} : lines,
+                                  nameDictionaryBuilder);
+      }));
+    }
+
+    if (tasks.empty())
+      break;
 
-    CHECK(!tasks.empty(), ());
     auto & task = tasks.front();
     auto taskResult = task.get();
     if (!taskResult.m_dataVersion.empty())
@@ -88,18 +124,6 @@ Hierarchy HierarchyReader::Read(unsigned int readersCount)
     tasks.pop_front();
 
     auto & taskEntries = taskResult.m_entries;
-    auto const & taskNameDictionary = taskResult.m_nameDictionary;
-    for (auto & entry : taskEntries)
-    {
-      for (size_t i = 0; i < static_cast<size_t>(Type::Count); ++i)
-      {
-        if (auto & position = entry.m_normalizedAddress[i])
-        {
-          auto const & multipleNames = taskNameDictionary.Get(position);
-          position = nameDictionaryBuilder.Add(MultipleNames{multipleNames});
-        }
-      }
-    }
     move(begin(taskEntries), end(taskEntries), back_inserter(entries));
 
     stats += taskResult.m_stats;
@@ -152,60 +176,82 @@ void HierarchyReader::CheckDuplicateOsmIds(vector<geocoder::Hierarchy::Entry> co
   }
 }
 
-HierarchyReader::ParsingResult HierarchyReader::ReadEntries(size_t count)
+bool HierarchyReader::ReadLines(boost::string_view & lines, shared_ptr<string> & buffer)
 {
-  vector<string> linesBuffer(count);
-  size_t bufferSize = 0;
+  if (!m_in)
+  {
+    if (m_mappedLines.empty())
+      return false;
 
+    auto end = min(kReadBlockSize, m_mappedLines.size());
+    auto const newLine = m_mappedLines.find('\n', end - 1);
+    end = newLine == boost::string_view::npos ? m_mappedLines.size() : newLine + 1;
+
+    lines = m_mappedLines.substr(0, end);
+    m_mappedLines.remove_prefix(end);
+    return true;
+  }
+
+  buffer = make_shared<string>(move(m_tail));
+  m_tail.clear();
+  auto newLine = string::npos;
+  while (newLine == string::npos && *m_in)
   {
-    lock_guard<mutex> lock(m_mutex);
+    auto const size = buffer->size();
+    buffer->resize(size + kReadBlockSize);
+    m_in->read(&(*buffer)[size], kReadBlockSize);
+    buffer->resize(size + static_cast<size_t>(m_in->gcount()));
+    newLine = buffer->rfind('\n');
+  }
 
-    for (; bufferSize < count; ++bufferSize)
-    {
-      if (!getline(m_in, linesBuffer[bufferSize]))
-      {
-        m_eof = true;
-        break;
-      }
-    }
+  // The last line of the stream may have no line break.
+  if (*m_in && newLine != string::npos)
+  {
+    m_tail.assign(*buffer, newLine + 1, string::npos);
+    buffer->resize(newLine + 1);
   }
 
-  return DeserializeEntries(linesBuffer, bufferSize);
+  if (buffer->empty())
+    return false;
+
+  lines = *buffer;
+  return true;
 }
 
 HierarchyReader::ParsingResult HierarchyReader::DeserializeEntries(
-    vector<string> const & linesBuffer, size_t const bufferSize)
+    boost::string_view lines, NameDictionaryBuilder & nameDictionaryBuilder)
 {
   vector<Entry> entries;
-  entries.reserve(bufferSize);
-  NameDictionaryBuilder nameDictionaryBuilder;
   ParsingStats stats;
   std::string dataVersion;
 
-  for (size_t i = 0; i < bufferSize; ++i)
+  while (!lines.empty())
   {
-    auto & line = linesBuffer[i];
+    auto const lineEnd = lines.find('\n');
+    auto const line = lines.substr(0, lineEnd);
+    lines.remove_prefix(lineEnd == boost::string_view::npos ? lines.size() : lineEnd + 1);
 
     if (line.empty())
       continue;
 
     auto const p = line.find(' ');
 
-    std::string const & key = line.substr(0, p);
+    auto const key = line.substr(0, p);
     if (key == kVersionKey)
     {
-      dataVersion = line.substr(p + 1);
+      if (p != boost::string_view::npos)
+        dataVersion = line.substr(p + 1).to_string();
       continue;
     }
 
     uint64_t encodedId = 0;
-    if (p == string::npos || !DeserializeId(key, encodedId))
+    if (p == boost::string_view::npos || !DeserializeId(key, encodedId))
     {
-      LOG(LWARNING, ("Cannot read osm id. Line:", line));
+      LOG(LWARNING, ("Cannot read osm id. Line:", line.to_string()));
       ++stats.m_badOsmIds;
       continue;
     }
-    auto json = line.substr(p + 1);
+    auto const json = line.substr(p + 1);
 
     Entry entry;
     auto const osmId = base::GeoObjectId(encodedId);
@@ -226,13 +272,13 @@ HierarchyReader::ParsingResult HierarchyReader::DeserializeEntries(
     entries.push_back(move(entry));
   }
 
-  return {move(entries), nameDictionaryBuilder.Release(), move(stats), move(dataVersion)};
+  return {move(entries), move(stats), move(dataVersion)};
 }
 
 // static
-bool HierarchyReader::DeserializeId(string const & str, uint64_t & id)
+bool HierarchyReader::DeserializeId(boost::string_view str, uint64_t & id)
 {
-  return strings::to_uint64(str, id, 16 /* base */);
+  return strings::to_uint64(str.to_string(), id, 16 /* base */);
 }
 
 // static
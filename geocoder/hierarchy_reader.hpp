@@ -3,17 +3,21 @@
 #include "geocoder/hierarchy.hpp"
 #include "geocoder/name_dictionary.hpp"
 
+#include "coding/mmap_reader.hpp"
+
 #include "base/exception.hpp"
 #include "base/geo_object_id.hpp"
 
 #include <atomic>
-#include <fstream>
-#include <mutex>
+#include <cstddef>
+#include <istream>
+#include <memory>
 #include <string>
-#include <thread>
 #include <utility>
 #include <vector>
 
+#include <boost/utility/string_view.hpp>
+
 namespace geocoder
 {
 class HierarchyReader
@@ -26,7 +30,9 @@ public:
 
   DECLARE_EXCEPTION(OpenException, RootException);
 
+  // Maps the file to memory and hands out its parts to the readers without copying.
   explicit HierarchyReader(std::string const & pathToJsonHierarchy);
+  // Reads the stream (e.g. a decompressed one) by big blocks of lines.
   explicit HierarchyReader(std::istream & jsonHierarchy);
 
   // Read hierarchy file/stream concurrently in |readersCount| threads.
@@ -36,23 +42,28 @@ private:
   struct ParsingResult
   {
     std::vector<Entry> m_entries;
-    NameDictionary m_nameDictionary;
     ParsingStats m_stats;
     std::string m_dataVersion;
   };
 
-  ParsingResult ReadEntries(size_t count);
-  ParsingResult DeserializeEntries(std::vector<std::string> const & linesBuffer,
-                                   std::size_t const bufferSize);
-  static bool DeserializeId(std::string const & str, uint64_t & id);
+  // Gets the next block of whole lines. The block is either a part of the mapped file
+  // or is read from the stream to |buffer|. Returns false when there are no more lines.
+  bool ReadLines(boost::string_view & lines, std::shared_ptr<std::string> & buffer);
+  // Names are added to the |nameDictionaryBuilder| shared by all the readers.
+  ParsingResult DeserializeEntries(boost::string_view lines,
+                                   NameDictionaryBuilder & nameDictionaryBuilder);
+  static bool DeserializeId(boost::string_view str, uint64_t & id);
   static std::string SerializeId(uint64_t id);
 
   void CheckDuplicateOsmIds(std::vector<Entry> const & entries, ParsingStats & stats);
 
-  std::ifstream m_fileStream;
-  std::istream & m_in;
-  bool m_eof{false};
-  std::mutex m_mutex;
+  std::unique_ptr<MmapReader> m_mappedFile;
+  boost::string_view m_mappedLines;
+
+  std::istream * m_in = nullptr;
+  // The incomplete last line of the block that was read from |m_in|.
+  std::string m_tail;
+
   std::atomic<std::uint64_t> m_totalNumLoaded{0};
 };
 } // namespace geocoder
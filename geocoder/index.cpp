@@ -11,8 +11,12 @@
 #include <algorithm>
 #include <atomic>
 #include <cstddef>
-#include <mutex>
+#include <limits>
+#include <numeric>
 #include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 using namespace std;
 
@@ -20,22 +24,22 @@ namespace
 {
 // Information will be logged for every |kLogBatch| docs.
 size_t const kLogBatch = 100000;
+
+// Number of docs that a thread takes at once when indexing houses.
+size_t const kHousesChunkSize = 4096;
 }  // namespace
 
 namespace geocoder
 {
 Index::Index(Hierarchy const & hierarchy)
-  : m_docs(hierarchy.GetEntries())
-  , m_hierarchy{hierarchy}
+  : m_hierarchy{hierarchy}
 {
 }
 
 void Index::BuildIndex(unsigned int loadThreadsCount)
 {
   CHECK_GREATER_OR_EQUAL(loadThreadsCount, 1, ());
-
-  m_docIdsByTokens.clear();
-  m_relatedBuildings.clear();
+  CHECK_LESS(m_hierarchy.GetEntriesCount(), numeric_limits<DocId>::max(), ());
 
   LOG(LINFO, ("Indexing hierarchy entries..."));
   AddEntries();
@@ -43,10 +47,38 @@ void Index::BuildIndex(unsigned int loadThreadsCount)
   AddHouses(loadThreadsCount);
 }
 
-Index::Doc const & Index::GetDoc(DocId const id) const
+Index::Doc Index::GetDoc(DocId const id) const
+{
+  ASSERT_LESS(static_cast<size_t>(id), m_hierarchy.GetEntriesCount(), ());
+  return m_hierarchy.GetEntry(id);
+}
+
+boost::string_view Index::GetKey(size_t keyId) const
 {
-  ASSERT_LESS(static_cast<size_t>(id), m_docs.size(), ());
-  return m_docs[static_cast<size_t>(id)];
+  ASSERT_LESS(keyId, GetKeysCount(), ());
+  auto const begin = m_keysOffsets[keyId];
+  auto const end = m_keysOffsets[keyId + 1];
+  return {m_keysData.data() + begin, static_cast<size_t>(end - begin)};
+}
+
+bool Index::FindKey(string const & key, size_t & keyId) const
+{
+  size_t lo = 0;
+  size_t hi = GetKeysCount();
+  while (lo < hi)
+  {
+    auto const mid = lo + (hi - lo) / 2;
+    if (GetKey(mid) < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (lo == GetKeysCount() || GetKey(lo) != key)
+    return false;
+
+  keyId = lo;
+  return true;
 }
 
 // static
@@ -60,32 +92,49 @@ string Index::MakeIndexKey(Tokens const & tokens)
   return strings::JoinStrings(indexTokens, " ");
 }
 
+size_t Index::FindPrefixEnd(size_t lo, size_t hi, size_t size) const
+{
+  ASSERT_LESS(lo, hi, ());
+  auto const prefix = GetKey(lo).substr(0, size);
+  ++lo;
+  while (lo < hi)
+  {
+    auto const mid = lo + (hi - lo) / 2;
+    if (GetKey(mid).substr(0, size) == prefix)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
 void Index::AddEntries()
 {
   size_t numIndexed = 0;
-  auto const & dictionary = m_hierarchy.GetNormalizedNameDictionary();
+  auto const docsCount = static_cast<DocId>(m_hierarchy.GetEntriesCount());
+  DocIdsByTokens docIdsByTokens;
   Tokens tokens;
-  for (DocId docId = 0; docId < static_cast<DocId>(m_docs.size()); ++docId)
+  for (DocId docId = 0; docId < docsCount; ++docId)
   {
-    auto const & doc = m_docs[static_cast<size_t>(docId)];
+    auto const type = m_hierarchy.GetType(docId);
     // The doc is indexed only by its address.
     // todo(@m) Index it by name too.
-    if (doc.m_type == Type::Count)
+    if (type == Type::Count)
       continue;
 
-    if (doc.m_type == Type::Building)
+    if (type == Type::Building)
       continue;
 
-    if (doc.m_type == Type::Street)
+    if (type == Type::Street)
     {
-      AddStreet(docId, doc);
+      AddStreet(docId, docIdsByTokens);
     }
     else
     {
-      for (auto const & name : doc.GetNormalizedMultipleNames(doc.m_type, dictionary))
+      for (auto const name : m_hierarchy.GetNormalizedMultipleNames(docId, type))
       {
-        search::NormalizeAndTokenizeAsUtf8(name, tokens);
-        InsertToIndex(tokens, docId);
+        search::NormalizeAndTokenizeAsUtf8(name.to_string(), tokens);
+        InsertToIndex(tokens, docId, docIdsByTokens);
       }
     }
 
@@ -96,30 +145,62 @@ void Index::AddEntries()
 
   if (numIndexed % kLogBatch != 0)
     LOG(LINFO, ("Indexed", numIndexed, "entries"));
+
+  BuildKeys(move(docIdsByTokens));
+}
+
+void Index::BuildKeys(DocIdsByTokens && docIdsByTokens)
+{
+  vector<DocIdsByTokens::const_iterator> items;
+  items.reserve(docIdsByTokens.size());
+  for (auto it = docIdsByTokens.cbegin(); it != docIdsByTokens.cend(); ++it)
+    items.push_back(it);
+  sort(items.begin(), items.end(), [](auto const & lhs, auto const & rhs) {
+    return lhs->first < rhs->first;
+  });
+
+  vector<uint64_t> keysOffsets{0};
+  vector<char> keysData;
+  vector<uint64_t> docIdsOffsets{0};
+  vector<DocId> docIds;
+  keysOffsets.reserve(items.size() + 1);
+  docIdsOffsets.reserve(items.size() + 1);
+  for (auto const & item : items)
+  {
+    keysData.insert(keysData.end(), item->first.begin(), item->first.end());
+    keysOffsets.push_back(keysData.size());
+    docIds.insert(docIds.end(), item->second.begin(), item->second.end());
+    docIdsOffsets.push_back(docIds.size());
+  }
+  docIdsByTokens.clear();
+
+  m_keysOffsets.steal(keysOffsets);
+  m_keysData.steal(keysData);
+  m_docIdsOffsets.steal(docIdsOffsets);
+  m_docIds.steal(docIds);
 }
 
-void Index::AddStreet(DocId const & docId, Index::Doc const & doc)
+void Index::AddStreet(DocId const & docId, DocIdsByTokens & docIdsByTokens) const
 {
-  CHECK_EQUAL(doc.m_type, Type::Street, ());
+  CHECK_EQUAL(m_hierarchy.GetType(docId), Type::Street, ());
 
   auto isStreetSynonym = [] (string const & s) {
     return search::IsStreetSynonym(strings::MakeUniString(s));
   };
 
-  auto const & dictionary = m_hierarchy.GetNormalizedNameDictionary();
   Tokens tokens;
-  for (auto const & name : doc.GetNormalizedMultipleNames(Type::Street, dictionary))
+  for (auto const name : m_hierarchy.GetNormalizedMultipleNames(docId, Type::Street))
   {
-    search::NormalizeAndTokenizeAsUtf8(name, tokens);
+    search::NormalizeAndTokenizeAsUtf8(name.to_string(), tokens);
 
     if (all_of(begin(tokens), end(tokens), isStreetSynonym))
     {
       if (tokens.size() > 1)
-        InsertToIndex(tokens, docId);
+        InsertToIndex(tokens, docId, docIdsByTokens);
       return;
     }
 
-    InsertToIndex(tokens, docId);
+    InsertToIndex(tokens, docId, docIdsByTokens);
 
     for (size_t i = 0; i < tokens.size(); ++i)
     {
@@ -127,38 +208,40 @@ void Index::AddStreet(DocId const & docId, Index::Doc const & doc)
         continue;
       auto addr = tokens;
       addr.erase(addr.begin() + i);
-      InsertToIndex(addr, docId);
+      InsertToIndex(addr, docId, docIdsByTokens);
     }
   }
 }
 
 void Index::AddHouses(unsigned int loadThreadsCount)
 {
-  atomic<size_t> numIndexed{0};
-  mutex buildingsMutex;
-
-  vector<thread> threads(loadThreadsCount);
-  CHECK_GREATER(threads.size(), 0, ());
+  // (street or locality, building) pairs found in the chunks of docs.
+  using Relations = vector<pair<DocId, DocId>>;
 
+  auto const docsCount = m_hierarchy.GetEntriesCount();
   auto const & dictionary = m_hierarchy.GetNormalizedNameDictionary();
 
-  for (size_t t = 0; t < threads.size(); ++t)
-  {
-    threads[t] = thread([&, t, this]() {
-      size_t const size = m_docs.size() / threads.size();
-      size_t docId = t * size;
-      size_t const docIdEnd = (t + 1 == threads.size() ? m_docs.size() : docId + size);
+  size_t const chunksCount = (docsCount + kHousesChunkSize - 1) / kHousesChunkSize;
+  vector<Relations> chunksRelations(chunksCount);
+  atomic<size_t> nextChunk{0};
+  atomic<size_t> numIndexed{0};
 
-      for (; docId < docIdEnd; ++docId)
+  // Every thread takes the next chunk of docs when it finishes the previous one and writes
+  // to the relations of that chunk only, so no locks are needed.
+  auto const processChunks = [&]() {
+    Tokens relationNameTokens;
+    for (auto chunk = nextChunk++; chunk < chunksCount; chunk = nextChunk++)
+    {
+      auto & relations = chunksRelations[chunk];
+      auto const docIdBegin = static_cast<DocId>(chunk * kHousesChunkSize);
+      auto const docIdEnd = static_cast<DocId>(min(docsCount, (chunk + 1) * kHousesChunkSize));
+      for (auto docId = docIdBegin; docId < docIdEnd; ++docId)
       {
-        auto const & buildingDoc = GetDoc(docId);
-
-        if (buildingDoc.m_type != Type::Building)
+        if (m_hierarchy.GetType(docId) != Type::Building)
           continue;
 
-        auto const & street = buildingDoc.m_normalizedAddress[static_cast<size_t>(Type::Street)];
-        auto const & locality =
-            buildingDoc.m_normalizedAddress[static_cast<size_t>(Type::Locality)];
+        auto const street = m_hierarchy.GetNormalizedAddress(docId, Type::Street);
+        auto const locality = m_hierarchy.GetNormalizedAddress(docId, Type::Locality);
 
         NameDictionary::Position relation = NameDictionary::kUnspecifiedPosition;
         if (street != NameDictionary::kUnspecifiedPosition)
@@ -168,21 +251,16 @@ void Index::AddHouses(unsigned int loadThreadsCount)
         else
           continue;
 
-        auto const & relationMultipleNames = dictionary.Get(relation);
-        auto const & relationName = relationMultipleNames.GetMainName();
-        Tokens relationNameTokens;
-        search::NormalizeAndTokenizeAsUtf8(relationName, relationNameTokens);
+        auto const relationName = dictionary.Get(relation).GetMainName();
+        search::NormalizeAndTokenizeAsUtf8(relationName.to_string(), relationNameTokens);
         CHECK(!relationNameTokens.empty(), ());
 
         bool indexed = false;
         ForEachDocId(relationNameTokens, [&](DocId const & candidate) {
-          auto const & candidateDoc = GetDoc(candidate);
-          if (m_hierarchy.IsParentTo(candidateDoc, buildingDoc))
+          if (m_hierarchy.IsParentTo(candidate, docId))
           {
             indexed = true;
-
-            lock_guard<mutex> lock(buildingsMutex);
-            m_relatedBuildings[candidate].emplace_back(docId);
+            relations.emplace_back(candidate, docId);
           }
         });
 
@@ -193,19 +271,53 @@ void Index::AddHouses(unsigned int loadThreadsCount)
             LOG(LINFO, ("Indexed", processedCount, "houses"));
         }
       }
-    });
-  }
+    }
+  };
+
+  CHECK_GREATER(loadThreadsCount, 0, ());
+  vector<thread> threads;
+  threads.reserve(loadThreadsCount - 1);
+  for (unsigned int t = 1; t < loadThreadsCount; ++t)
+    threads.emplace_back(processChunks);
+  processChunks();
 
   for (auto & t : threads)
     t.join();
 
   if (numIndexed % kLogBatch != 0)
     LOG(LINFO, ("Indexed", numIndexed, "houses"));
+
+  // Groups buildings by streets/localities with a counting sort. Chunks are visited in
+  // the order of docs, so the buildings of every street/locality come out sorted.
+  vector<uint64_t> relatedBuildingsOffsets(docsCount + 1, 0);
+  for (auto const & relations : chunksRelations)
+  {
+    for (auto const & relation : relations)
+      ++relatedBuildingsOffsets[relation.first + 1];
+  }
+  partial_sum(relatedBuildingsOffsets.begin(), relatedBuildingsOffsets.end(),
+              relatedBuildingsOffsets.begin());
+
+  // Offsets of the docs are used as insertion positions and are shifted back after that.
+  vector<DocId> relatedBuildingsIds(relatedBuildingsOffsets.back());
+  for (auto & relations : chunksRelations)
+  {
+    for (auto const & relation : relations)
+      relatedBuildingsIds[relatedBuildingsOffsets[relation.first]++] = relation.second;
+    Relations().swap(relations);
+  }
+  for (size_t docId = docsCount; docId > 0; --docId)
+    relatedBuildingsOffsets[docId] = relatedBuildingsOffsets[docId - 1];
+  relatedBuildingsOffsets[0] = 0;
+
+  m_relatedBuildingsOffsets.steal(relatedBuildingsOffsets);
+  m_relatedBuildings.steal(relatedBuildingsIds);
 }
 
-void Index::InsertToIndex(Tokens const & tokens, DocId docId)
+void Index::InsertToIndex(Tokens const & tokens, DocId docId,
+                          DocIdsByTokens & docIdsByTokens) const
 {
-  auto & ids = m_docIdsByTokens[MakeIndexKey(tokens)];
+  auto & ids = docIdsByTokens[MakeIndexKey(tokens)];
   if (0 == count(ids.begin(), ids.end(), docId))
     ids.emplace_back(docId);
 }
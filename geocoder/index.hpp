@@ -2,16 +2,25 @@
 
 #include "geocoder/hierarchy.hpp"
 
+#include "indexer/search_string_utils.hpp"
+
+#include "base/control_flow.hpp"
+#include "base/dfa_helpers.hpp"
 #include "base/geo_object_id.hpp"
+#include "base/levenshtein_dfa.hpp"
+#include "base/string_utils.hpp"
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <thread>
 #include <unordered_map>
 #include <vector>
 
-#include <boost/serialization/unordered_map.hpp>
-#include <boost/serialization/version.hpp>
+#include <boost/utility/string_view.hpp>
+
+#include "3party/succinct/mappable_vector.hpp"
 
 namespace geocoder
 {
@@ -22,21 +31,27 @@ public:
 
   // Number of the entry in the list of all hierarchy entries
   // that the index was constructed from.
-  using DocId = std::vector<Doc>::size_type;
+  using DocId = Hierarchy::EntryId;
 
   explicit Index(Hierarchy const & hierarchy);
 
   void BuildIndex(unsigned int loadThreadsCount = 1);
 
-  template<class Archive>
-  void serialize(Archive & ar, const unsigned int version)
+  // Maps the index to the memory of the token index file or freezes it there.
+  template <typename Visitor>
+  void map(Visitor & visitor)
   {
-    CHECK_EQUAL(version, kIndexFormatVersion, ());
-    ar & m_docIdsByTokens;
-    ar & m_relatedBuildings;
+    visitor(m_keysOffsets, "keysOffsets");
+    visitor(m_keysData, "keysData");
+    visitor(m_docIdsOffsets, "docIdsOffsets");
+    visitor(m_docIds, "docIds");
+    visitor(m_relatedBuildingsOffsets, "relatedBuildingsOffsets");
+    visitor(m_relatedBuildings, "relatedBuildings");
   }
 
-  Doc const & GetDoc(DocId const id) const;
+  // Assembles all the fields of the doc. The fields that are used in the loops over docs
+  // should be taken from the hierarchy one by one.
+  Doc GetDoc(DocId const id) const;
 
   // Calls |fn| for DocIds of Docs whose names exactly match |tokens| (the order matters).
   //
@@ -46,12 +61,36 @@ public:
   template <typename Fn>
   void ForEachDocId(Tokens const & tokens, Fn && fn) const
   {
-    auto const it = m_docIdsByTokens.find(MakeIndexKey(tokens));
-    if (it == m_docIdsByTokens.end())
+    size_t keyId = 0;
+    if (!FindKey(MakeIndexKey(tokens), keyId))
       return;
 
-    for (DocId const & docId : it->second)
-      fn(docId);
+    for (auto i = m_docIdsOffsets[keyId]; i < m_docIdsOffsets[keyId + 1]; ++i)
+      fn(m_docIds[i]);
+  }
+
+  // Tokens shorter than this number of chars are not matched as prefixes with misprints:
+  // too many keys start with them.
+  static size_t constexpr kMinMisprintPrefixSize = 3;
+  // The lookup with misprints stops after this number of keys or after the keys
+  // with this number of docs.
+  static size_t constexpr kMaxMisprintKeys = 64;
+  static size_t constexpr kMaxMisprintDocs = 1024;
+
+  // Calls |fn| for ids of keys which match |tokens| with misprints, see kMaxMisprintKeys and
+  // kMaxMisprintDocs for the limits. When |isPrefix| is set, |tokens| must consist of a single
+  // token which is treated as an unfinished one. The index keys are walked as a trie with
+  // a Levenshtein automaton, so only keys that are within the allowed number of errors are
+  // visited.
+  template <typename Fn>
+  void ForEachKeyWithMisprints(Tokens const & tokens, bool isPrefix, Fn && fn) const;
+
+  // Calls |fn| for DocIds of Docs of the key |keyId|.
+  template <typename Fn>
+  void ForEachDocIdOfKey(size_t keyId, Fn && fn) const
+  {
+    for (auto i = m_docIdsOffsets[keyId]; i < m_docIdsOffsets[keyId + 1]; ++i)
+      fn(m_docIds[i]);
   }
 
   // Calls |fn| for DocIds of buildings that are located on the
@@ -59,39 +98,125 @@ public:
   template <typename Fn>
   void ForEachRelatedBuilding(DocId const & docId, Fn && fn) const
   {
-    auto const it = m_relatedBuildings.find(docId);
-    if (it == m_relatedBuildings.end())
+    if (docId + 1 >= m_relatedBuildingsOffsets.size())
       return;
 
-    for (DocId const & docId : it->second)
-      fn(docId);
+    for (auto i = m_relatedBuildingsOffsets[docId]; i < m_relatedBuildingsOffsets[docId + 1]; ++i)
+      fn(m_relatedBuildings[i]);
   }
 
 private:
-  void InsertToIndex(Tokens const & tokens, DocId docId);
+  using DocIdsByTokens = std::unordered_map<std::string, std::vector<DocId>>;
+
+  size_t GetKeysCount() const { return m_keysOffsets.size() == 0 ? 0 : m_keysOffsets.size() - 1; }
+  boost::string_view GetKey(size_t keyId) const;
+  // Binary search of |key| in the sorted keys.
+  bool FindKey(std::string const & key, size_t & keyId) const;
+
+  // Returns the first key in [lo, hi) whose first |size| bytes differ from the ones of |lo|.
+  // Keys in [lo, hi) must have the same first |size| - 1 bytes.
+  size_t FindPrefixEnd(size_t lo, size_t hi, size_t size) const;
+
+  // Walks keys in [lo, hi) which share the first |depth| bytes already consumed by |it|
+  // as a trie and calls |fn| for every accepted key. Keys with more than |spacesLeft| spaces
+  // (i.e. with more tokens than the query) are pruned. Returns false when |fn| breaks the walk.
+  template <typename DFAIt, typename Fn>
+  bool WalkKeys(size_t lo, size_t hi, size_t depth, size_t spacesLeft, DFAIt const & it,
+                Fn && fn) const
+  {
+    if (lo < hi && GetKey(lo).size() == depth)
+    {
+      if (it.Accepts() && fn(lo) == base::ControlFlow::Break)
+        return false;
+      ++lo;
+    }
+
+    while (lo < hi)
+    {
+      auto const key = GetKey(lo);
+      auto charIt = key.begin() + depth;
+      strings::UniChar const c = utf8::unchecked::next(charIt);
+      auto const charEnd = static_cast<size_t>(charIt - key.begin());
+      auto const next = FindPrefixEnd(lo, hi, charEnd);
+
+      if (c != ' ' || spacesLeft != 0)
+      {
+        auto childIt = it;
+        childIt.Move(c);
+        if (!childIt.Rejects() &&
+            !WalkKeys(lo, next, charEnd, c == ' ' ? spacesLeft - 1 : spacesLeft, childIt, fn))
+        {
+          return false;
+        }
+      }
+
+      lo = next;
+    }
+    return true;
+  }
+
+  void InsertToIndex(Tokens const & tokens, DocId docId, DocIdsByTokens & docIdsByTokens) const;
 
   // Converts |tokens| to a single UTF-8 string that can be used
-  // as a key in the |m_docIdsByTokens| map.
+  // as a key in the token index.
   static std::string MakeIndexKey(Tokens const & tokens);
 
-  // Adds address information of |m_docs| to the index.
+  // Adds address information of hierarchy entries to the index.
   void AddEntries();
 
-  // Adds the street |e| (which has the id of |docId|) to the index,
+  // Freezes |docIdsByTokens| into the sorted keys arrays.
+  void BuildKeys(DocIdsByTokens && docIdsByTokens);
+
+  // Adds the street which has the id of |docId| to the index,
   // with and without synonyms of the word "street".
-  void AddStreet(DocId const & docId, Doc const & e);
+  void AddStreet(DocId const & docId, DocIdsByTokens & docIdsByTokens) const;
 
   // Fills the |m_relatedBuildings| field.
   void AddHouses(unsigned int loadThreadsCount);
 
-  std::vector<Doc> const & m_docs;
   Hierarchy const & m_hierarchy;
 
-  std::unordered_map<std::string, std::vector<DocId>> m_docIdsByTokens;
-
-  // Lists of houses grouped by the streets/localities they belong to.
-  std::unordered_map<DocId, std::vector<DocId>> m_relatedBuildings;
+  // Sorted token keys: the i-th key is [m_keysOffsets[i], m_keysOffsets[i + 1]) of |m_keysData|
+  // and its docs are [m_docIdsOffsets[i], m_docIdsOffsets[i + 1]) of |m_docIds|.
+  succinct::mapper::mappable_vector<std::uint64_t> m_keysOffsets;
+  succinct::mapper::mappable_vector<char> m_keysData;
+  succinct::mapper::mappable_vector<std::uint64_t> m_docIdsOffsets;
+  succinct::mapper::mappable_vector<DocId> m_docIds;
+
+  // Lists of houses grouped by the streets/localities they belong to:
+  // houses of the doc |docId| are
+  // [m_relatedBuildingsOffsets[docId], m_relatedBuildingsOffsets[docId + 1]).
+  succinct::mapper::mappable_vector<std::uint64_t> m_relatedBuildingsOffsets;
+  succinct::mapper::mappable_vector<DocId> m_relatedBuildings;
 };
-}  // namespace geocoder
 
-BOOST_CLASS_VERSION(geocoder::Index, geocoder::kIndexFormatVersion)
+template <typename Fn>
+void Index::ForEachKeyWithMisprints(Tokens const & tokens, bool isPrefix, Fn && fn) const
+{
+  CHECK(!isPrefix || tokens.size() == 1, (tokens));
+
+  size_t keysCount = 0;
+  size_t docsCount = 0;
+  auto const limitedFn = [&](size_t keyId) {
+    fn(keyId);
+    ++keysCount;
+    docsCount += static_cast<size_t>(m_docIdsOffsets[keyId + 1] - m_docIdsOffsets[keyId]);
+    return keysCount < kMaxMisprintKeys && docsCount < kMaxMisprintDocs
+               ? base::ControlFlow::Continue
+               : base::ControlFlow::Break;
+  };
+
+  auto const key = strings::MakeUniString(MakeIndexKey(tokens));
+  auto const spaces = static_cast<size_t>(std::count(key.begin(), key.end(), ' '));
+  auto const dfa = search::BuildLevenshteinDFA(key);
+  if (isPrefix)
+  {
+    strings::PrefixDFAModifier<strings::LevenshteinDFA> const prefixDfa(dfa);
+    WalkKeys(0 /* lo */, GetKeysCount(), 0 /* depth */, spaces, prefixDfa.Begin(), limitedFn);
+  }
+  else
+  {
+    WalkKeys(0 /* lo */, GetKeysCount(), 0 /* depth */, spaces, dfa.Begin(), limitedFn);
+  }
+}
+}  // namespace geocoder
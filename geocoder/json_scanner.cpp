@@ -0,0 +1,266 @@
+#include "geocoder/json_scanner.hpp"
+
+#include "base/assert.hpp"
+#include "base/string_utils.hpp"
+
+#include <cstring>
+#include <limits>
+
+using namespace std;
+
+namespace geocoder
+{
+namespace
+{
+bool IsWhitespace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+// Returns -1 for non-hex chars.
+int HexValue(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+}  // namespace
+
+JsonScanner::JsonScanner(boost::string_view text)
+  : m_pos{text.data()}, m_end{text.data() + text.size()}
+{
+}
+
+bool JsonScanner::IsObject()
+{
+  SkipWhitespaces();
+  return m_pos != m_end && *m_pos == '{';
+}
+
+bool JsonScanner::ReadNull()
+{
+  SkipWhitespaces();
+  if (m_end - m_pos < 4 || strncmp(m_pos, "null", 4) != 0)
+    return false;
+  m_pos += 4;
+  return true;
+}
+
+void JsonScanner::ReadString(string & value)
+{
+  bool hasEscapes = false;
+  auto const raw = ReadRawString(hasEscapes);
+  if (hasEscapes)
+    Unescape(raw, value);
+  else
+    value.assign(raw.data(), raw.size());
+}
+
+uint64_t JsonScanner::ReadUInt()
+{
+  SkipWhitespaces();
+  if (m_pos == m_end || *m_pos < '0' || *m_pos > '9')
+    MYTHROW(Exception, ("Unsigned integer expected"));
+
+  uint64_t value = 0;
+  for (; m_pos != m_end && *m_pos >= '0' && *m_pos <= '9'; ++m_pos)
+  {
+    auto const digit = static_cast<uint64_t>(*m_pos - '0');
+    if (value > (numeric_limits<uint64_t>::max() - digit) / 10)
+      MYTHROW(Exception, ("Integer overflow"));
+    value = value * 10 + digit;
+  }
+
+  if (m_pos != m_end && (*m_pos == '.' || *m_pos == 'e' || *m_pos == 'E'))
+    MYTHROW(Exception, ("Unsigned integer expected"));
+  return value;
+}
+
+void JsonScanner::SkipValue()
+{
+  SkipWhitespaces();
+  if (m_pos == m_end)
+    MYTHROW(Exception, ("Value expected"));
+
+  switch (*m_pos)
+  {
+  case '{':
+  case '[': SkipContainer(); return;
+  case '"':
+  {
+    bool hasEscapes = false;
+    ReadRawString(hasEscapes);
+    return;
+  }
+  }
+
+  // A number, true, false or null.
+  auto const begin = m_pos;
+  while (m_pos != m_end && *m_pos != ',' && *m_pos != '}' && *m_pos != ']' &&
+         !IsWhitespace(*m_pos))
+  {
+    ++m_pos;
+  }
+  if (m_pos == begin)
+    MYTHROW(Exception, ("Value expected"));
+}
+
+void JsonScanner::Finish()
+{
+  SkipWhitespaces();
+  if (m_pos != m_end)
+    MYTHROW(Exception, ("Unexpected text after the end of json"));
+}
+
+boost::string_view JsonScanner::ReadKey()
+{
+  bool hasEscapes = false;
+  auto key = ReadRawString(hasEscapes);
+  if (hasEscapes)
+  {
+    Unescape(key, m_keyBuffer);
+    key = m_keyBuffer;
+  }
+  Expect(':');
+  return key;
+}
+
+boost::string_view JsonScanner::ReadRawString(bool & hasEscapes)
+{
+  Expect('"');
+
+  hasEscapes = false;
+  auto const begin = m_pos;
+  while (true)
+  {
+    auto const quote =
+        static_cast<char const *>(memchr(m_pos, '"', static_cast<size_t>(m_end - m_pos)));
+    if (!quote)
+      MYTHROW(Exception, ("Unterminated string"));
+
+    // The quote is escaped iff it is preceded by an odd number of backslashes.
+    auto backslash = quote;
+    while (backslash != begin && *(backslash - 1) == '\\')
+      --backslash;
+
+    m_pos = quote + 1;
+    if ((quote - backslash) % 2 == 0)
+      break;
+  }
+
+  boost::string_view const raw{begin, static_cast<size_t>(m_pos - 1 - begin)};
+  hasEscapes = raw.find('\\') != boost::string_view::npos;
+  return raw;
+}
+
+void JsonScanner::Unescape(boost::string_view raw, string & value) const
+{
+  value.clear();
+  value.reserve(raw.size());
+
+  auto const readCodeUnit = [&](size_t pos) {
+    if (pos + 4 > raw.size())
+      MYTHROW(Exception, ("Bad unicode escape"));
+    uint32_t unit = 0;
+    for (size_t i = pos; i < pos + 4; ++i)
+    {
+      auto const v = HexValue(raw[i]);
+      if (v < 0)
+        MYTHROW(Exception, ("Bad unicode escape"));
+      unit = unit * 16 + static_cast<uint32_t>(v);
+    }
+    return unit;
+  };
+
+  for (size_t i = 0; i < raw.size(); ++i)
+  {
+    if (raw[i] != '\\')
+    {
+      value.push_back(raw[i]);
+      continue;
+    }
+
+    if (++i == raw.size())
+      MYTHROW(Exception, ("Bad escape"));
+
+    switch (raw[i])
+    {
+    case '"': value.push_back('"'); break;
+    case '\\': value.push_back('\\'); break;
+    case '/': value.push_back('/'); break;
+    case 'b': value.push_back('\b'); break;
+    case 'f': value.push_back('\f'); break;
+    case 'n': value.push_back('\n'); break;
+    case 'r': value.push_back('\r'); break;
+    case 't': value.push_back('\t'); break;
+    case 'u':
+    {
+      auto codePoint = readCodeUnit(i + 1);
+      i += 4;
+      if (codePoint >= 0xD800 && codePoint <= 0xDBFF)
+      {
+        // A surrogate pair.
+        if (i + 2 >= raw.size() || raw[i + 1] != '\\' || raw[i + 2] != 'u')
+          MYTHROW(Exception, ("Bad surrogate pair"));
+        auto const low = readCodeUnit(i + 3);
+        if (low < 0xDC00 || low > 0xDFFF)
+          MYTHROW(Exception, ("Bad surrogate pair"));
+        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+        i += 6;
+      }
+      utf8::unchecked::append(codePoint, back_inserter(value));
+      break;
+    }
+    default: MYTHROW(Exception, ("Bad escape"));
+    }
+  }
+}
+
+void JsonScanner::SkipContainer()
+{
+  ASSERT(m_pos != m_end && (*m_pos == '{' || *m_pos == '['), ());
+
+  size_t depth = 0;
+  do
+  {
+    auto const c = *m_pos;
+    if (c == '"')
+    {
+      bool hasEscapes = false;
+      ReadRawString(hasEscapes);
+      continue;
+    }
+
+    if (c == '{' || c == '[')
+      ++depth;
+    else if (c == '}' || c == ']')
+      --depth;
+    ++m_pos;
+  } while (depth != 0 && m_pos != m_end);
+
+  if (depth != 0)
+    MYTHROW(Exception, ("Unterminated container"));
+}
+
+void JsonScanner::SkipWhitespaces()
+{
+  while (m_pos != m_end && IsWhitespace(*m_pos))
+    ++m_pos;
+}
+
+bool JsonScanner::TryConsume(char c)
+{
+  SkipWhitespaces();
+  if (m_pos == m_end || *m_pos != c)
+    return false;
+  ++m_pos;
+  return true;
+}
+
+void JsonScanner::Expect(char c)
+{
+  if (!TryConsume(c))
+    MYTHROW(Exception, ("Expected", c));
+}
+}  // namespace geocoder
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "base/exception.hpp"
+
+#include <cstdint>
+#include <string>
+
+#include <boost/utility/string_view.hpp>
+
+namespace geocoder
+{
+// Forward-only reader of a json text. Only the values that are requested by the caller
+// are parsed; all the other values are skipped without building a DOM and are only checked
+// for the balance of brackets and quotes.
+//
+// Usage:
+//   JsonScanner scanner{text};
+//   scanner.ForEachField([&](boost::string_view key) {
+//     if (key == "name")
+//       scanner.ReadString(name);
+//     else
+//       scanner.SkipValue();
+//   });
+//   scanner.Finish();
+//
+// Malformed texts cause JsonScanner::Exception.
+class JsonScanner
+{
+public:
+  DECLARE_EXCEPTION(Exception, RootException);
+
+  explicit JsonScanner(boost::string_view text);
+
+  // Returns whether the next value is an object.
+  bool IsObject();
+
+  // Consumes the next value iff it is null.
+  bool ReadNull();
+
+  // Reads an object calling |fn| for every key. |fn| must consume the value of the key.
+  template <typename Fn>
+  void ForEachField(Fn && fn)
+  {
+    Expect('{');
+    if (TryConsume('}'))
+      return;
+
+    do
+    {
+      fn(ReadKey());
+    } while (TryConsume(','));
+
+    Expect('}');
+  }
+
+  void ReadString(std::string & value);
+  uint64_t ReadUInt();
+  void SkipValue();
+
+  // Checks that there is nothing but whitespaces after the last read value.
+  void Finish();
+
+private:
+  boost::string_view ReadKey();
+  // Returns the raw contents of a string between quotes and whether it contains escapes.
+  boost::string_view ReadRawString(bool & hasEscapes);
+  void Unescape(boost::string_view raw, std::string & value) const;
+  void SkipContainer();
+
+  void SkipWhitespaces();
+  bool TryConsume(char c);
+  void Expect(char c);
+
+  char const * m_pos;
+  char const * m_end;
+  std::string m_keyBuffer;
+};
+}  // namespace geocoder
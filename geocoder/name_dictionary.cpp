@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <functional>
 #include <limits>
+#include <numeric>
 #include <utility>
 
 namespace geocoder
@@ -57,44 +58,184 @@ bool operator!=(MultipleNames const & lhs, MultipleNames const & rhs) noexcept
   return !(lhs == rhs);
 }
 
+// MultipleNamesView -------------------------------------------------------------------------------
+boost::string_view MultipleNamesView::Iterator::dereference() const
+{
+  ASSERT(m_dictionary, ());
+  return m_dictionary->GetString(m_stringIndex);
+}
+
+MultipleNames MultipleNamesView::ToMultipleNames() const
+{
+  MultipleNames names{GetMainName().to_string()};
+  for (auto it = std::next(begin()); it != end(); ++it)
+    names.AddAltName(it->to_string());
+  return names;
+}
+
 // NameDictionary ----------------------------------------------------------------------------------
-MultipleNames const & NameDictionary::Get(Position position) const
+MultipleNamesView NameDictionary::Get(Position position) const
 {
   CHECK_GREATER(position, 0, ());
-  CHECK_LESS_OR_EQUAL(position, m_stock.size(), ());
-  return m_stock[position - 1];
+  CHECK_LESS_OR_EQUAL(position, Size(), ());
+  return {*this, m_namesOffsets[position - 1], m_namesOffsets[position]};
 }
 
-NameDictionary::Position NameDictionary::Add(MultipleNames && names)
+boost::string_view NameDictionary::GetString(size_t stringIndex) const
 {
-  CHECK(!names.GetMainName().empty(), ());
-  CHECK_LESS(m_stock.size(), std::numeric_limits<uint32_t>::max(), ());
-  m_stock.push_back(std::move(names));
-  return static_cast<uint32_t>(m_stock.size());  // index + 1
+  ASSERT_LESS(stringIndex + 1, m_stringsOffsets.size(), ());
+  auto const begin = m_stringsOffsets[stringIndex];
+  auto const end = m_stringsOffsets[stringIndex + 1];
+  return {m_stringsData.data() + begin, static_cast<size_t>(end - begin)};
 }
 
-// NameDictionaryBuilder::Hash ---------------------------------------------------------------------
-size_t NameDictionaryBuilder::Hash::operator()(MultipleNames const & names) const noexcept
+void NameDictionary::Swap(NameDictionary & other)
 {
-  return std::hash<std::string>{}(names.GetMainName());
+  m_namesOffsets.swap(other.m_namesOffsets);
+  m_stringsOffsets.swap(other.m_stringsOffsets);
+  m_stringsData.swap(other.m_stringsData);
+  m_mainNameIds.swap(other.m_mainNameIds);
 }
 
-// NameDictionaryBuilder -----------------------------------------------------------------------------
-NameDictionary::Position NameDictionaryBuilder::Add(MultipleNames && names)
+// NameDictionaryBuilder::Shard --------------------------------------------------------------------
+bool NameDictionaryBuilder::Shard::Equals(size_t localIndex, MultipleNames const & names) const
 {
-  auto indexItem = m_index.find(names);
-  if (indexItem != m_index.end())
-    return indexItem->second;
+  auto const begin = m_namesOffsets[localIndex];
+  auto const end = m_namesOffsets[localIndex + 1];
+  if (end - begin != names.GetNames().size())
+    return false;
+
+  auto stringIndex = begin;
+  for (auto const & name : names)
+  {
+    if (GetString(stringIndex++) != name)
+      return false;
+  }
+  return true;
+}
+
+boost::string_view NameDictionaryBuilder::Shard::GetString(size_t stringIndex) const
+{
+  auto const begin = m_stringsOffsets[stringIndex];
+  auto const end = m_stringsOffsets[stringIndex + 1];
+  return {m_stringsData.data() + begin, static_cast<size_t>(end - begin)};
+}
+
+// NameDictionaryBuilder ---------------------------------------------------------------------------
+NameDictionary::Position NameDictionaryBuilder::Add(MultipleNames const & names)
+{
+  CHECK(!names.GetMainName().empty(), ());
+
+  std::hash<std::string> const hasher;
+  auto const mainNameHash = hasher(names.GetMainName());
+  auto namesHash = mainNameHash;
+  for (auto it = std::next(names.begin()); it != names.end(); ++it)
+    namesHash = namesHash * 31 + hasher(*it);
+
+  auto & shard = m_shards[mainNameHash % kShardsCount];
+  std::lock_guard<std::mutex> lock(shard.m_mutex);
+
+  auto const range = shard.m_index.equal_range(namesHash);
+  for (auto it = range.first; it != range.second; ++it)
+  {
+    if (shard.Equals(it->second, names))
+      return shard.m_positions[it->second];
+  }
+
+  auto const position = m_nextPosition++;
+  CHECK_LESS(position, std::numeric_limits<NameDictionary::Position>::max(), ());
+  auto const p = static_cast<NameDictionary::Position>(position);
+
+  auto const localIndex = static_cast<uint32_t>(shard.m_positions.size());
+  for (auto const & name : names)
+  {
+    shard.m_stringsData.insert(shard.m_stringsData.end(), name.begin(), name.end());
+    shard.m_stringsOffsets.push_back(shard.m_stringsData.size());
+  }
+  CHECK_LESS(shard.m_stringsOffsets.size(), std::numeric_limits<uint32_t>::max(), ());
+  shard.m_namesOffsets.push_back(static_cast<uint32_t>(shard.m_stringsOffsets.size() - 1));
+  shard.m_positions.push_back(p);
+  shard.m_index.emplace(namesHash, localIndex);
+
+  // All names with the same main name are in the same shard, so the first of them
+  // in the shard is the first one in the dictionary.
+  NameDictionary::MainNameId mainNameId = p;
+  auto const mainNameRange = shard.m_mainNameIndex.equal_range(mainNameHash);
+  for (auto it = mainNameRange.first; it != mainNameRange.second; ++it)
+  {
+    if (shard.GetString(shard.m_namesOffsets[it->second]) == names.GetMainName())
+    {
+      mainNameId = shard.m_mainNameIds[it->second];
+      break;
+    }
+  }
+  if (mainNameId == p)
+    shard.m_mainNameIndex.emplace(mainNameHash, localIndex);
+  shard.m_mainNameIds.push_back(mainNameId);
 
-  auto p = m_dictionary.Add(std::move(names));
-  auto indexEmplace = m_index.emplace(m_dictionary.Get(p), p);
-  CHECK(indexEmplace.second, ());
   return p;
 }
 
 NameDictionary NameDictionaryBuilder::Release()
 {
-  m_index.clear();
-  return std::move(m_dictionary);
+  auto const namesCount = static_cast<size_t>(m_nextPosition - 1);
+
+  // Names of the position p are [namesOffsets[p - 1], namesOffsets[p]).
+  std::vector<uint32_t> namesOffsets(namesCount + 1, 0);
+  std::vector<NameDictionary::MainNameId> mainNameIds(namesCount + 1,
+                                                      NameDictionary::kUnspecifiedPosition);
+  for (auto const & shard : m_shards)
+  {
+    for (size_t i = 0; i < shard.m_positions.size(); ++i)
+    {
+      auto const p = shard.m_positions[i];
+      namesOffsets[p] = shard.m_namesOffsets[i + 1] - shard.m_namesOffsets[i];
+      mainNameIds[p] = shard.m_mainNameIds[i];
+    }
+  }
+  CHECK_LESS(std::accumulate(namesOffsets.begin(), namesOffsets.end(), uint64_t{0}),
+             std::numeric_limits<uint32_t>::max(), ());
+  std::partial_sum(namesOffsets.begin(), namesOffsets.end(), namesOffsets.begin());
+
+  std::vector<uint64_t> stringsOffsets(namesOffsets.back() + 1, 0);
+  for (auto const & shard : m_shards)
+  {
+    for (size_t i = 0; i < shard.m_positions.size(); ++i)
+    {
+      auto stringIndex = namesOffsets[shard.m_positions[i] - 1];
+      for (auto j = shard.m_namesOffsets[i]; j < shard.m_namesOffsets[i + 1]; ++j)
+        stringsOffsets[++stringIndex] = shard.m_stringsOffsets[j + 1] - shard.m_stringsOffsets[j];
+    }
+  }
+  std::partial_sum(stringsOffsets.begin(), stringsOffsets.end(), stringsOffsets.begin());
+
+  std::vector<char> stringsData(stringsOffsets.back());
+  for (auto & shard : m_shards)
+  {
+    for (size_t i = 0; i < shard.m_positions.size(); ++i)
+    {
+      auto stringIndex = namesOffsets[shard.m_positions[i] - 1];
+      auto const begin = shard.m_stringsOffsets[shard.m_namesOffsets[i]];
+      auto const end = shard.m_stringsOffsets[shard.m_namesOffsets[i + 1]];
+      std::copy(shard.m_stringsData.begin() + begin, shard.m_stringsData.begin() + end,
+                stringsData.begin() + stringsOffsets[stringIndex]);
+    }
+
+    shard.m_namesOffsets.assign(1, 0);
+    shard.m_stringsOffsets.assign(1, 0);
+    std::vector<char>().swap(shard.m_stringsData);
+    shard.m_positions.clear();
+    shard.m_mainNameIds.clear();
+    shard.m_index.clear();
+    shard.m_mainNameIndex.clear();
+  }
+  m_nextPosition = 1;
+
+  NameDictionary dictionary;
+  dictionary.m_namesOffsets.steal(namesOffsets);
+  dictionary.m_stringsOffsets.steal(stringsOffsets);
+  dictionary.m_stringsData.steal(stringsData);
+  dictionary.m_mainNameIds.steal(mainNameIds);
+  return dictionary;
 }
 }  // namespace geocoder
@@ -4,14 +4,20 @@
 
 #include "base/assert.hpp"
 
+#include <array>
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <iterator>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
-#include <boost/serialization/string.hpp>
-#include <boost/serialization/vector.hpp>
-#include <boost/serialization/version.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/utility/string_view.hpp>
+
+#include "3party/succinct/mappable_vector.hpp"
 
 namespace geocoder
 {
@@ -22,13 +28,6 @@ public:
 
   explicit MultipleNames(std::string const & mainName = {});
 
-  template<class Archive>
-  void serialize(Archive & ar, const unsigned int version)
-  {
-    CHECK_EQUAL(version, kIndexFormatVersion, ());
-    ar & m_names;
-  }
-
   std::string const & GetMainName() const noexcept;
   std::vector<std::string> const & GetNames() const noexcept;
 
@@ -46,35 +45,125 @@ private:
   std::vector<std::string> m_names;
 };
 
+class NameDictionary;
+
+// Non-owning view of the names stored in a NameDictionary. The main name is the first one.
+class MultipleNamesView
+{
+public:
+  class Iterator : public boost::iterator_facade<Iterator, boost::string_view const,
+                                                 boost::random_access_traversal_tag,
+                                                 boost::string_view>
+  {
+  public:
+    Iterator() = default;
+    Iterator(NameDictionary const & dictionary, size_t stringIndex)
+      : m_dictionary{&dictionary}, m_stringIndex{stringIndex}
+    {
+    }
+
+  private:
+    friend class boost::iterator_core_access;
+
+    boost::string_view dereference() const;
+    bool equal(Iterator const & rhs) const { return m_stringIndex == rhs.m_stringIndex; }
+    void increment() { ++m_stringIndex; }
+    void decrement() { --m_stringIndex; }
+    void advance(std::ptrdiff_t n) { m_stringIndex += n; }
+    std::ptrdiff_t distance_to(Iterator const & rhs) const
+    {
+      return static_cast<std::ptrdiff_t>(rhs.m_stringIndex) -
+             static_cast<std::ptrdiff_t>(m_stringIndex);
+    }
+
+    NameDictionary const * m_dictionary = nullptr;
+    size_t m_stringIndex = 0;
+  };
+
+  using const_iterator = Iterator;
+
+  MultipleNamesView(NameDictionary const & dictionary, size_t beginIndex, size_t endIndex)
+    : m_dictionary{dictionary}, m_beginIndex{beginIndex}, m_endIndex{endIndex}
+  {
+    ASSERT_LESS(m_beginIndex, m_endIndex, ());
+  }
+
+  boost::string_view GetMainName() const noexcept { return *begin(); }
+  size_t size() const noexcept { return m_endIndex - m_beginIndex; }
+
+  const_iterator begin() const noexcept { return {m_dictionary, m_beginIndex}; }
+  const_iterator end() const noexcept { return {m_dictionary, m_endIndex}; }
+
+  MultipleNames ToMultipleNames() const;
+
+private:
+  NameDictionary const & m_dictionary;
+  size_t m_beginIndex;
+  size_t m_endIndex;
+};
+
+// Flat storage of normalized names: all strings are kept in one contiguous pool and are
+// addressed through offset tables, so the dictionary can be mapped from a file as is.
 class NameDictionary
 {
 public:
   // Values of Position type: kUnspecifiedPosition or >= 1.
   using Position = std::uint32_t;
+  // Positions of MultipleNames with equal main names have equal main name ids.
+  // The id of kUnspecifiedPosition is kUnspecifiedPosition.
+  using MainNameId = Position;
 
   static constexpr Position kUnspecifiedPosition = 0;
 
   NameDictionary() = default;
-  NameDictionary(NameDictionary &&) = default;
-  NameDictionary & operator=(NameDictionary &&) = default;
+  NameDictionary(NameDictionary && other) { Swap(other); }
+  NameDictionary & operator=(NameDictionary && other)
+  {
+    Swap(other);
+    return *this;
+  }
 
   NameDictionary(NameDictionary const &) = delete;
   NameDictionary & operator=(NameDictionary const &) = delete;
 
-  template<class Archive>
-  void serialize(Archive & ar, const unsigned int version)
+  template <typename Visitor>
+  void map(Visitor & visitor)
+  {
+    visitor(m_namesOffsets, "namesOffsets");
+    visitor(m_stringsOffsets, "stringsOffsets");
+    visitor(m_stringsData, "stringsData");
+    visitor(m_mainNameIds, "mainNameIds");
+  }
+
+  MultipleNamesView Get(Position position) const;
+  MainNameId GetMainNameId(Position position) const
   {
-    CHECK_EQUAL(version, kIndexFormatVersion, ());
-    ar & m_stock;
+    ASSERT_LESS(position, m_mainNameIds.size(), ());
+    return m_mainNameIds[position];
   }
+  // Number of MultipleNames in the dictionary.
+  size_t Size() const { return m_namesOffsets.size() == 0 ? 0 : m_namesOffsets.size() - 1; }
 
-  MultipleNames const & Get(Position position) const;
-  Position Add(MultipleNames && s);
+  boost::string_view GetString(size_t stringIndex) const;
+
+  void Swap(NameDictionary & other);
 
 private:
-  std::vector<MultipleNames> m_stock;
+  friend class NameDictionaryBuilder;
+
+  // Strings of the i-th MultipleNames (position i + 1) are
+  // [m_namesOffsets[i], m_namesOffsets[i + 1]).
+  succinct::mapper::mappable_vector<std::uint32_t> m_namesOffsets;
+  // Characters of the i-th string are [m_stringsOffsets[i], m_stringsOffsets[i + 1]).
+  succinct::mapper::mappable_vector<std::uint64_t> m_stringsOffsets;
+  succinct::mapper::mappable_vector<char> m_stringsData;
+  // Main name ids by positions. The id is the first position with the same main name.
+  succinct::mapper::mappable_vector<MainNameId> m_mainNameIds;
 };
 
+// Thread-safe builder of a NameDictionary. Names are interned into shards chosen by
+// the hash of the main name, so threads that add different names rarely wait for each other,
+// and positions are final as soon as they are returned by Add().
 class NameDictionaryBuilder
 {
 public:
@@ -82,19 +171,33 @@ public:
   NameDictionaryBuilder(NameDictionaryBuilder const &) = delete;
   NameDictionaryBuilder & operator=(NameDictionaryBuilder const &) = delete;
 
-  NameDictionary::Position Add(MultipleNames && s);
+  // The order of positions of names added concurrently depends on the order of calls.
+  NameDictionary::Position Add(MultipleNames const & names);
+  // Lays out the strings of all shards by positions. Must not be called concurrently with Add().
   NameDictionary Release();
 
 private:
-  struct Hash
+  static size_t constexpr kShardsCount = 64;
+
+  // Names are stored in a contiguous pool of strings like in NameDictionary
+  // but are addressed by local indexes of the shard.
+  struct Shard
   {
-    size_t operator()(MultipleNames const & names) const noexcept;
+    bool Equals(size_t localIndex, MultipleNames const & names) const;
+    boost::string_view GetString(size_t stringIndex) const;
+
+    std::mutex m_mutex;
+    std::vector<std::uint32_t> m_namesOffsets{0};
+    std::vector<std::uint64_t> m_stringsOffsets{0};
+    std::vector<char> m_stringsData;
+    std::vector<NameDictionary::Position> m_positions;
+    std::vector<NameDictionary::MainNameId> m_mainNameIds;
+    // Local indexes by the hashes of all names and by the hashes of main names.
+    std::unordered_multimap<size_t, std::uint32_t> m_index;
+    std::unordered_multimap<size_t, std::uint32_t> m_mainNameIndex;
   };
 
-  NameDictionary m_dictionary;
-  std::unordered_map<MultipleNames, NameDictionary::Position, Hash> m_index;
+  std::array<Shard, kShardsCount> m_shards;
+  std::atomic<std::uint64_t> m_nextPosition{1};
 };
 }  // namespace geocoder
-
-BOOST_CLASS_VERSION(geocoder::MultipleNames, geocoder::kIndexFormatVersion)
-BOOST_CLASS_VERSION(geocoder::NameDictionary, geocoder::kIndexFormatVersion)
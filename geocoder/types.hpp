@@ -7,7 +7,7 @@
 
 namespace geocoder
 {
-enum : unsigned int { kIndexFormatVersion = 1 };
+enum : unsigned int { kIndexFormatVersion = 4 };
 
 using Tokens = std::vector<std::string>;
 
@@ -0,0 +1,99 @@
+#include "testing/testing.hpp"
+
+#include "geometry/geometry_tests/large_polygon.hpp"
+#include "geometry/point2d.hpp"
+#include "geometry/region2d.hpp"
+#include "geometry/region2d/prepared_region.hpp"
+
+#include "base/macros.hpp"
+#include "base/math.hpp"
+
+#include <cmath>
+#include <vector>
+
+namespace
+{
+void TestSameAsRegion(std::vector<m2::PointD> const & points)
+{
+  m2::RegionD const region(points);
+  m2::PreparedRegionD const prepared{std::vector<m2::PointD>(points)};
+
+  auto const check = [&](m2::PointD const & pt) {
+    TEST_EQUAL(prepared.Contains(pt), region.Contains(pt), (pt));
+  };
+
+  for (size_t i = 0; i < points.size(); ++i)
+  {
+    auto const & prev = points[i == 0 ? points.size() - 1 : i - 1];
+    check(points[i]);
+    check((prev + points[i]) / 2.0);
+  }
+
+  auto rect = region.GetRect();
+  rect.Scale(1.1);
+  size_t const kSteps = 300;
+  for (size_t i = 0; i <= kSteps; ++i)
+  {
+    for (size_t j = 0; j <= kSteps; ++j)
+    {
+      check({rect.minX() + rect.SizeX() * i / kSteps, rect.minY() + rect.SizeY() * j / kSteps});
+    }
+  }
+}
+}  // namespace
+
+UNIT_TEST(PreparedRegion_Square)
+{
+  TestSameAsRegion({{0.0, 0.0}, {1.0, 0.0}, {1.0, 1.0}, {0.0, 1.0}});
+}
+
+UNIT_TEST(PreparedRegion_LargePolygon)
+{
+  std::vector<m2::PointD> const points(
+      LargePolygon::kLargePolygon,
+      LargePolygon::kLargePolygon + ARRAY_SIZE(LargePolygon::kLargePolygon));
+  TestSameAsRegion(points);
+
+  m2::PreparedRegionD const prepared{std::vector<m2::PointD>(points)};
+  TEST(prepared.Locate(points.front()) == m2::PreparedRegionD::Location::Border, ());
+  TEST(prepared.Locate({0.0, 0.0}) == m2::PreparedRegionD::Location::Outside, ());
+}
+
+UNIT_TEST(PreparedRegion_LocateRect)
+{
+  using Location = m2::PreparedRegionD::Location;
+
+  std::vector<m2::PointD> points;
+  size_t const kPointsCount = 400;
+  for (size_t i = 0; i < kPointsCount; ++i)
+  {
+    auto const angle = 2.0 * math::pi * i / kPointsCount;
+    points.emplace_back(std::cos(angle), std::sin(angle));
+  }
+
+  m2::RegionD const region(points);
+  m2::PreparedRegionD const prepared{std::vector<m2::PointD>(points)};
+
+  TEST(prepared.LocateRect({-0.1, -0.1, 0.1, 0.1}) == Location::Inside, ());
+  TEST(prepared.LocateRect({2.0, 2.0, 3.0, 3.0}) == Location::Outside, ());
+  TEST(prepared.LocateRect({0.9, -0.1, 1.1, 0.1}) == Location::Border, ());
+  TEST(prepared.LocateRect({-0.1, -0.1, 2.0, 0.1}) == Location::Border, ());
+
+  // Rects which are not located as Border have all points on one side.
+  double const kStep = 0.05;
+  for (double x = -1.2; x < 1.2; x += kStep)
+  {
+    for (double y = -1.2; y < 1.2; y += kStep)
+    {
+      auto const location = prepared.LocateRect({x, y, x + kStep, y + kStep});
+      if (location == Location::Border)
+        continue;
+
+      for (auto const & pt : {m2::PointD(x, y), m2::PointD(x + kStep, y + kStep),
+                              m2::PointD(x + kStep / 2, y + kStep / 2)})
+      {
+        TEST_EQUAL(region.Contains(pt), location == Location::Inside, (pt));
+      }
+    }
+  }
+}
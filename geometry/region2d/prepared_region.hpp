@@ -0,0 +1,286 @@
+#pragma once
+
+#include "geometry/point2d.hpp"
+#include "geometry/rect2d.hpp"
+#include "geometry/region2d.hpp"
+
+#include "base/assert.hpp"
+#include "base/math.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace m2
+{
+// Region prepared for fast point location. The rect of the region is split into a grid of
+// cells. The cells which are not touched by edges are marked as inside or outside of
+// the region, so points in them are located in constant time. Points in the other cells are
+// located by the edges of the grid row only. Results are the same as Region::Contains() gives.
+template <typename Point>
+class PreparedRegion
+{
+public:
+  using Coord = typename Point::value_type;
+  using EqualType = typename Region<Point>::Traits::EqualType;
+
+  static_assert(std::is_floating_point<Coord>::value, "");
+
+  enum class Location : uint8_t
+  {
+    Outside,
+    Inside,
+    Border
+  };
+
+  PreparedRegion() = default;
+
+  explicit PreparedRegion(std::vector<Point> && points) : m_points(std::move(points))
+  {
+    for (auto const & point : m_points)
+      m_rect.Add(point);
+
+    if (m_points.empty())
+      return;
+
+    auto const side = static_cast<size_t>(std::sqrt(static_cast<double>(m_points.size())));
+    m_cols = base::clamp(side, size_t{1}, kMaxGridSide);
+    m_rows = m_cols;
+    m_cellWidth = m_rect.SizeX() / m_cols;
+    m_cellHeight = m_rect.SizeY() / m_rows;
+
+    FillRows();
+    FillCells();
+  }
+
+  Rect<Coord> const & GetRect() const { return m_rect; }
+  std::vector<Point> const & Data() const { return m_points; }
+
+  bool Contains(Point const & pt) const { return Locate(pt) != Location::Outside; }
+
+  Location Locate(Point const & pt) const
+  {
+    if (!m_rect.IsPointInside(pt))
+      return Location::Outside;
+
+    auto const row = GetRow(pt.y);
+    auto const cell = static_cast<Location>(m_cells[row * m_cols + GetCol(pt.x)]);
+    if (cell != Location::Border)
+      return cell;
+
+    return LocateByRowEdges(pt, row);
+  }
+
+  // Returns Inside or Outside when all points of the rect are surely inside or outside of
+  // the region, and Border otherwise. Only cells of the grid are checked, so rects
+  // close to the border give Border even if they do not touch it.
+  Location LocateRect(Rect<Coord> const & rect) const
+  {
+    if (!m_rect.IsIntersect(rect))
+      return Location::Outside;
+
+    // Parts of the rect out of the grid are outside of the region.
+    auto result = m_rect.IsRectInside(rect) ? Location::Border : Location::Outside;
+    auto const fromRow = GetRow(rect.minY() - kMargin);
+    auto const toRow = GetRow(rect.maxY() + kMargin);
+    auto const fromCol = GetCol(rect.minX() - kMargin);
+    auto const toCol = GetCol(rect.maxX() + kMargin);
+    for (auto row = fromRow; row <= toRow; ++row)
+    {
+      for (auto col = fromCol; col <= toCol; ++col)
+      {
+        auto const cell = static_cast<Location>(m_cells[row * m_cols + col]);
+        if (cell == Location::Border)
+          return Location::Border;
+
+        if (result == Location::Border)
+          result = cell;
+        else if (result != cell)
+          return Location::Border;
+      }
+    }
+
+    return result;
+  }
+
+private:
+  // Grid of 256 x 256 cells makes rows short enough for regions of hundreds of thousands
+  // of points.
+  static size_t constexpr kMaxGridSide = 256;
+  // Cells closer than the margin to an edge are border cells. The margin is larger than
+  // the precision of EqualType, so points in other cells are never close to edges.
+  static Coord constexpr kMargin = 1e-7;
+
+  size_t GetRow(Coord y) const
+  {
+    return ToIndex(m_cellHeight > 0 ? (y - m_rect.minY()) / m_cellHeight : 0, m_rows);
+  }
+
+  size_t GetCol(Coord x) const
+  {
+    return ToIndex(m_cellWidth > 0 ? (x - m_rect.minX()) / m_cellWidth : 0, m_cols);
+  }
+
+  static size_t ToIndex(Coord value, size_t count)
+  {
+    if (value <= 0)
+      return 0;
+
+    return std::min(static_cast<size_t>(value), count - 1);
+  }
+
+  Point const & GetPrev(uint32_t i) const
+  {
+    return m_points[i == 0 ? m_points.size() - 1 : i - 1];
+  }
+
+  // Edge |i| goes from the previous point to the point |i|.
+  void FillRows()
+  {
+    std::vector<std::pair<uint32_t, uint32_t>> rowEdges;
+    for (uint32_t i = 0; i < m_points.size(); ++i)
+    {
+      auto const & prev = GetPrev(i);
+      auto const & curr = m_points[i];
+      auto const from = GetRow(std::min(prev.y, curr.y) - kMargin);
+      auto const to = GetRow(std::max(prev.y, curr.y) + kMargin);
+      for (auto row = from; row <= to; ++row)
+        rowEdges.emplace_back(static_cast<uint32_t>(row), i);
+    }
+
+    std::sort(rowEdges.begin(), rowEdges.end());
+    m_rowOffsets.assign(m_rows + 1, 0);
+    m_rowEdges.reserve(rowEdges.size());
+    for (auto const & rowEdge : rowEdges)
+    {
+      ++m_rowOffsets[rowEdge.first + 1];
+      m_rowEdges.push_back(rowEdge.second);
+    }
+
+    for (size_t row = 0; row < m_rows; ++row)
+      m_rowOffsets[row + 1] += m_rowOffsets[row];
+  }
+
+  void FillCells()
+  {
+    m_cells.assign(m_rows * m_cols, static_cast<uint8_t>(Location::Outside));
+
+    // Cells touched by bounding boxes of edges are border cells.
+    for (uint32_t i = 0; i < m_points.size(); ++i)
+    {
+      auto const & prev = GetPrev(i);
+      auto const & curr = m_points[i];
+      auto const fromRow = GetRow(std::min(prev.y, curr.y) - kMargin);
+      auto const toRow = GetRow(std::max(prev.y, curr.y) + kMargin);
+      auto const fromCol = GetCol(std::min(prev.x, curr.x) - kMargin);
+      auto const toCol = GetCol(std::max(prev.x, curr.x) + kMargin);
+      for (auto row = fromRow; row <= toRow; ++row)
+      {
+        for (auto col = fromCol; col <= toCol; ++col)
+          m_cells[row * m_cols + col] = static_cast<uint8_t>(Location::Border);
+      }
+    }
+
+    // Other cells are located by parity of crossings of the horizontal line through the centers
+    // of the cells of a row. The centers are far from edges, so the parity is reliable.
+    std::vector<Coord> crossings;
+    for (size_t row = 0; row < m_rows; ++row)
+    {
+      auto const y = m_rect.minY() + (row + 0.5) * m_cellHeight;
+      crossings.clear();
+      for (auto e = m_rowOffsets[row]; e < m_rowOffsets[row + 1]; ++e)
+      {
+        auto const i = m_rowEdges[e];
+        auto const & prev = GetPrev(i);
+        auto const & curr = m_points[i];
+        if ((prev.y > y) == (curr.y > y))
+          continue;
+
+        crossings.push_back(prev.x + (y - prev.y) * (curr.x - prev.x) / (curr.y - prev.y));
+      }
+      std::sort(crossings.begin(), crossings.end());
+
+      size_t crossed = 0;
+      for (size_t col = 0; col < m_cols; ++col)
+      {
+        auto const x = m_rect.minX() + (col + 0.5) * m_cellWidth;
+        while (crossed < crossings.size() && crossings[crossed] < x)
+          ++crossed;
+
+        auto & cell = m_cells[row * m_cols + col];
+        if (cell != static_cast<uint8_t>(Location::Border) && crossed % 2 == 1)
+          cell = static_cast<uint8_t>(Location::Inside);
+      }
+    }
+  }
+
+  // The same algorithm as Region::Contains() has. Only the edges which cross the horizontal
+  // line through the point are counted there, all of them are in the row of the point.
+  Location LocateByRowEdges(Point const & pt, size_t row) const
+  {
+    EqualType const equalF;
+    int rCross = 0; /* number of right edge/ray crossings */
+    int lCross = 0; /* number of left edge/ray crossings */
+
+    for (auto e = m_rowOffsets[row]; e < m_rowOffsets[row + 1]; ++e)
+    {
+      auto const i = m_rowEdges[e];
+      if (equalF.EqualPoints(m_points[i], pt))
+        return Location::Border;
+
+      Point const prev = GetPrev(i) - pt;
+      Point const curr = m_points[i] - pt;
+
+      bool const rCheck = ((curr.y > 0) != (prev.y > 0));
+      bool const lCheck = ((curr.y < 0) != (prev.y < 0));
+
+      if (rCheck || lCheck)
+      {
+        ASSERT_NOT_EQUAL(curr.y, prev.y, ());
+
+        Coord const delta = prev.y - curr.y;
+        Coord const cp = CrossProduct(curr, prev);
+
+        if (!equalF.EqualZeroSquarePrecision(cp))
+        {
+          bool const PrevGreaterCurr = delta > 0.0;
+
+          if (rCheck && ((cp > 0) == PrevGreaterCurr))
+            ++rCross;
+          if (lCheck && ((cp > 0) != PrevGreaterCurr))
+            ++lCross;
+        }
+      }
+    }
+
+    /* q on the edge if left and right cross are not the same parity. */
+    if ((rCross & 1) != (lCross & 1))
+      return Location::Border;
+
+    /* q inside if an odd number of crossings. */
+    return (rCross & 1) ? Location::Inside : Location::Outside;
+  }
+
+  std::vector<Point> m_points;
+  Rect<Coord> m_rect;
+  size_t m_rows = 0;
+  size_t m_cols = 0;
+  Coord m_cellWidth = 0;
+  Coord m_cellHeight = 0;
+  // Edges of the row |r| are m_rowEdges[m_rowOffsets[r], m_rowOffsets[r + 1]).
+  std::vector<uint32_t> m_rowOffsets;
+  std::vector<uint32_t> m_rowEdges;
+  std::vector<uint8_t> m_cells;
+};
+
+template <typename Point>
+size_t constexpr PreparedRegion<Point>::kMaxGridSide;
+
+template <typename Point>
+typename PreparedRegion<Point>::Coord constexpr PreparedRegion<Point>::kMargin;
+
+using PreparedRegionD = PreparedRegion<PointD>;
+}  // namespace m2
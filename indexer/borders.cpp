@@ -98,6 +98,24 @@ bool Borders::Border::IsPointInside(m2::PointD const & point) const
   return true;
 }
 
+Borders::Location Borders::Border::LocateRect(m2::RectD const & rect) const
+{
+  auto const location = m_outer.LocateRect(rect);
+  if (location != Location::Inside)
+    return location;
+
+  for (auto const & inner : m_inners)
+  {
+    auto const innerLocation = inner.LocateRect(rect);
+    if (innerLocation == Location::Inside)
+      return Location::Outside;
+    if (innerLocation == Location::Border)
+      return Location::Border;
+  }
+
+  return Location::Inside;
+}
+
 void Borders::Deserialize(string const & filename)
 {
   BordersVectorReader reader(filename);
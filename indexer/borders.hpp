@@ -1,7 +1,8 @@
 #pragma once
 
 #include "geometry/point2d.hpp"
-#include "geometry/region2d.hpp"
+#include "geometry/rect2d.hpp"
+#include "geometry/region2d/prepared_region.hpp"
 
 #include <cstdint>
 #include <map>
@@ -17,6 +18,7 @@ namespace indexer
 // Kaliningrad region which is part of Russia or Alaska which is part of US.
 // Each outer border may have several inner borders e.g. Vatican and San Marino are
 // located inside Italy but are not parts of it.
+// Borders are stored as m2::PreparedRegion, so most points are located in constant time.
 class Borders
 {
 public:
@@ -32,6 +34,24 @@ public:
     return false;
   }
 
+  // Returns false if the rect is surely inside or surely outside of the region. Otherwise
+  // the border of the region may pass through the rect.
+  bool IsBorderInRect(uint64_t id, m2::RectD const & rect) const
+  {
+    auto const range = m_borders.equal_range(id);
+
+    bool isBorderInRect = false;
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      auto const location = it->second.LocateRect(rect);
+      if (location == Location::Inside)
+        return false;
+      if (location == Location::Border)
+        isBorderInRect = true;
+    }
+    return isBorderInRect;
+  }
+
   // Throws Reader::Exception in case of data reading errors.
   void Deserialize(std::string const & filename);
 
@@ -41,21 +61,24 @@ public:
     vec.ForEach([this](uint64_t id, std::vector<m2::PointD> const & outer,
                        std::vector<std::vector<m2::PointD>> const & inners) {
       auto it = m_borders.insert(std::make_pair(id, Border()));
-      it->second.m_outer = m2::RegionD(outer);
+      it->second.m_outer = m2::PreparedRegionD(std::vector<m2::PointD>(outer));
       for (auto const & inner : inners)
-        it->second.m_inners.push_back(m2::RegionD(inner));
+        it->second.m_inners.emplace_back(std::vector<m2::PointD>(inner));
     });
   }
 
 private:
+  using Location = m2::PreparedRegionD::Location;
+
   struct Border
   {
     Border() = default;
 
     bool IsPointInside(m2::PointD const & point) const;
+    Location LocateRect(m2::RectD const & rect) const;
 
-    m2::RegionD m_outer;
-    std::vector<m2::RegionD> m_inners;
+    m2::PreparedRegionD m_outer;
+    std::vector<m2::PreparedRegionD> m_inners;
   };
 
   std::multimap<uint64_t, Border> m_borders;
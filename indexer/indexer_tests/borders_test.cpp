@@ -3,7 +3,11 @@
 #include "indexer/borders.hpp"
 
 #include "geometry/point2d.hpp"
+#include "geometry/region2d.hpp"
 
+#include "base/math.hpp"
+
+#include <cmath>
 #include <cstdint>
 #include <vector>
 
@@ -117,4 +121,44 @@ UNIT_TEST(BordersTest)
     TEST(!borders.IsPointInside(0, m2::PointD{7, 7}), ());
   }
 }
+
+UNIT_TEST(BordersTest_ManyPoints)
+{
+  auto const makeCircle = [](m2::PointD const & center, double radius, size_t count) {
+    vector<m2::PointD> circle;
+    for (size_t i = 0; i < count; ++i)
+    {
+      auto const angle = 2 * math::pi * i / count;
+      circle.emplace_back(center.x + radius * cos(angle), center.y + radius * sin(angle));
+    }
+    return circle;
+  };
+
+  BordersVector vec;
+  vec.m_borders.resize(1);
+  vec.m_borders[0].m_id = 0;
+  vec.m_borders[0].m_outer = makeCircle({0, 0}, 10, 10000);
+  vec.m_borders[0].m_inners = {makeCircle({3, 3}, 2, 1000)};
+
+  indexer::Borders borders;
+  borders.DeserializeFromVec(vec);
+
+  m2::RegionD const outer(vec.m_borders[0].m_outer);
+  m2::RegionD const inner(vec.m_borders[0].m_inners[0]);
+  for (double x = -11; x <= 11; x += 0.1)
+  {
+    for (double y = -11; y <= 11; y += 0.1)
+    {
+      m2::PointD const point{x, y};
+      TEST_EQUAL(borders.IsPointInside(0, point), outer.Contains(point) && !inner.Contains(point),
+                 (point));
+    }
+  }
+
+  TEST(!borders.IsBorderInRect(0, m2::RectD(-0.1, -0.1, 0.1, 0.1)), ());
+  TEST(!borders.IsBorderInRect(0, m2::RectD(2.9, 2.9, 3.1, 3.1)), ());
+  TEST(!borders.IsBorderInRect(0, m2::RectD(20.0, 20.0, 21.0, 21.0)), ());
+  TEST(borders.IsBorderInRect(0, m2::RectD(9.9, -0.1, 10.1, 0.1)), ());
+  TEST(borders.IsBorderInRect(0, m2::RectD(4.9, 2.9, 5.1, 3.1)), ());
+}
 }  // namespace